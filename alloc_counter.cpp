@@ -0,0 +1,61 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every allocation of the process
+std::atomic<unsigned long> allocations(0);
+
+void * countedAlloc(std::size_t size) noexcept{
+  ++allocations;
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+unsigned long allocationCount() noexcept{
+  return allocations;
+}
+
+void * operator new(std::size_t size){
+  void * p = countedAlloc(size);
+  if(p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](std::size_t size){
+  void * p = countedAlloc(size);
+  if(p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept{
+  return countedAlloc(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept{
+  return countedAlloc(size);
+}
+
+void operator delete(void * p) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept{
+  std::free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept{
+  std::free(p);
+}
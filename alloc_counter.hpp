@@ -0,0 +1,15 @@
+/*! \file alloc_counter.hpp
+Declares the count of heap allocations made by a benchmark process.
+
+Linking alloc_counter.cpp into a program replaces every form of the global
+operator new and delete with ones counting the allocations. They are kept
+in their own translation unit so the compiler does not inline them into
+callers, where it would pair the library's operator new with free.
+ */
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+/// return the number of allocations made through operator new so far
+unsigned long allocationCount() noexcept;
+
+#endif
@@ -1,13 +1,69 @@
 #include "atom.hpp"
+#include "memstats.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <sstream>
 #include <cctype>
+#include <functional>
 #include <cmath>
 #include <limits>
+#include <type_traits>
 
-Atom::Atom(): m_type(NoneKind) {}
+const unsigned TAG_SHIFT = 47;
+const uint64_t TAG_MASK = 0xFull;
+const uint64_t PAYLOAD_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
 
-Atom::Atom(double value){
+// the quiet NaN every NaN Number is stored as
+const uint64_t CANONICAL_NAN = 0x7FF8000000000000ull;
+
+static_assert(sizeof(Atom) == sizeof(uint64_t), "an Atom is a single word");
+
+// the heap bytes a value holds beyond its own size
+inline std::size_t extraBytes(const std::string & s){
+  const char * inside = reinterpret_cast<const char *>(&s);
+  bool local = (s.data() >= inside) && (s.data() < inside + sizeof(s));
+  return local ? 0 : s.capacity() + 1;
+}
+
+inline std::size_t extraBytes(const std::complex<double> &){
+  return 0;
+}
+
+// a heap value shared by copies of an Atom, counted in the memory counters
+template<typename T>
+struct Shared {
+  Shared(const T & v): refs(1), value(v) { countMemory(counter(), bytes()); }
+  ~Shared(){ countMemory(counter(), -bytes()); }
+
+  std::int64_t bytes() const { return sizeof(*this) + extraBytes(value); }
+
+  static MemoryCounter counter(){
+    return std::is_same<T, std::string>::value ? StringBytes : ComplexBytes;
+  }
+
+  std::atomic<std::size_t> refs;
+  T value;
+};
+
+typedef Shared<std::string> SharedString;
+typedef Shared<std::complex<double>> SharedComplex;
+
+inline uint64_t boxBits(unsigned tag, const void * heap){
+  return BOX_PREFIX | (uint64_t(tag) << TAG_SHIFT) |
+    (reinterpret_cast<uintptr_t>(heap) >> 3);
+}
+
+template<typename T>
+inline T * unbox(uint64_t bits){
+  return reinterpret_cast<T *>(static_cast<uintptr_t>((bits & PAYLOAD_MASK) << 3));
+}
+
+Atom::Atom(): m_bits(boxBits(NoneKind, nullptr)) {
+  countMemory(LiveAtoms, 1);
+}
+
+Atom::Atom(double value): Atom(){
 
   setNumber(value);
 }
@@ -45,162 +101,174 @@ Atom::Atom(const std::string & value): Atom() {
 	}
 }
 
-Atom::Atom(std::complex<double> value) {
+Atom::Atom(std::complex<double> value): Atom() {
   setComplex(value);
 }
 
-Atom::Atom(const Atom & x): Atom(){
-  if(x.isNumber()){
-    setNumber(x.numberValue);
-  }
-  else if(x.isSymbol()){
-    setSymbol(x.stringValue);
-  }
-  else if(x.isComplex()){
-    setComplex(x.complexValue);
-  }
-  else if (x.isString()) {
-	setString(x.stringValue);
-  }
+Atom::Atom(const Atom & x) noexcept: m_bits(x.m_bits){
+  countMemory(LiveAtoms, 1);
+  retain();
 }
 
-Atom & Atom::operator=(const Atom & x){
+Atom::Atom(Atom && x) noexcept: m_bits(x.m_bits){
+  countMemory(LiveAtoms, 1);
+  x.m_bits = boxBits(NoneKind, nullptr);
+}
+
+Atom & Atom::operator=(const Atom & x) noexcept{
+
+  // retain first, so assigning an Atom sharing the same value is safe
+  uint64_t bits = x.m_bits;
+  x.retain();
+  release();
+  m_bits = bits;
+  return *this;
+}
+
+Atom & Atom::operator=(Atom && x) noexcept{
 
   if(this != &x){
-    if(x.m_type == NoneKind){
-      m_type = NoneKind;
-    }
-    else if(x.m_type == NumberKind){
-      setNumber(x.numberValue);
-    }
-    else if(x.m_type == SymbolKind){
-      setSymbol(x.stringValue);
-    }
-    else if(x.m_type == ComplexKind){
-      setComplex(x.complexValue);
-    }
-	else if (x.m_type == ListKind) {
-		setList();
-	}
-  else if (x.m_type == LambdaKind){
-    setLambda();
-  }
-  else if (x.m_type == DiscreteKind){
-    setDiscretePlot();
-  }
-  else if (x.m_type == ContinuousKind){
-    setContinuousPlot();
-  }
-	else if (x.m_type == StringKind) {
-		setString(x.stringValue);
-	}
+    release();
+    m_bits = x.m_bits;
+    x.m_bits = boxBits(NoneKind, nullptr);
   }
   return *this;
 }
   
 Atom::~Atom(){
+  countMemory(LiveAtoms, -1);
+  release();
+}
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind || m_type == StringKind){
-    stringValue.~basic_string();
+std::size_t Atom::heapBytes() const noexcept{
+  Type t = type();
+  if((t == SymbolKind) || (t == StringKind)){
+    return unbox<SharedString>(m_bits)->bytes();
+  }
+  if(t == ComplexKind){
+    return unbox<SharedComplex>(m_bits)->bytes();
   }
+  return 0;
 }
 
-bool Atom::isNone() const noexcept{
-  return m_type == NoneKind;
+Atom::Type Atom::type() const noexcept{
+  if((m_bits & BOX_PREFIX) != BOX_PREFIX){
+    return NumberKind;
+  }
+  return static_cast<Type>((m_bits >> TAG_SHIFT) & TAG_MASK);
+}
+
+
+const std::string & Atom::stringValue() const noexcept{
+  return unbox<SharedString>(m_bits)->value;
 }
 
-bool Atom::isNumber() const noexcept{
-  return m_type == NumberKind;
+const std::complex<double> & Atom::complexValue() const noexcept{
+  return unbox<SharedComplex>(m_bits)->value;
+}
+
+void Atom::setBoxed(Type t, const void * heap) noexcept{
+  release();
+  m_bits = boxBits(t, heap);
+}
+
+void Atom::retain() const noexcept{
+  Type t = type();
+  if((t == SymbolKind) || (t == StringKind)){
+    unbox<SharedString>(m_bits)->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  else if(t == ComplexKind){
+    unbox<SharedComplex>(m_bits)->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Atom::release() noexcept{
+  Type t = type();
+  if((t == SymbolKind) || (t == StringKind)){
+    SharedString * str = unbox<SharedString>(m_bits);
+    if(str->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete str;
+  }
+  else if(t == ComplexKind){
+    SharedComplex * c = unbox<SharedComplex>(m_bits);
+    if(c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete c;
+  }
+  m_bits = boxBits(NoneKind, nullptr);
+}
+
+bool Atom::isNone() const noexcept{
+  return type() == NoneKind;
 }
 
 bool Atom::isSymbol() const noexcept{
-  return m_type == SymbolKind;
+  return type() == SymbolKind;
 }  
 
 bool Atom::isComplex() const noexcept{
-  return m_type == ComplexKind;
+  return type() == ComplexKind;
 }
 
 bool Atom::isList() const noexcept {
-	return m_type == ListKind;
+	return type() == ListKind;
 }
 
 bool Atom::isString() const noexcept {
-	return m_type == StringKind;
+	return type() == StringKind;
 }
 
 bool Atom::isLambda() const noexcept {
-  return m_type == LambdaKind;
+  return type() == LambdaKind;
 }
 
 bool Atom::isDiscrete() const noexcept {
-  return m_type == DiscreteKind;
+  return type() == DiscreteKind;
 }
 
 bool Atom::isContinuous() const noexcept {
-  return m_type == ContinuousKind;
+  return type() == ContinuousKind;
 }
 
 void Atom::setNumber(double value){
 
-  m_type = NumberKind;
-  numberValue = value;
+  release();
+  if(std::isnan(value)){
+    m_bits = CANONICAL_NAN;
+  }
+  else{
+    std::memcpy(&m_bits, &value, sizeof(value));
+  }
 }
 
 void Atom::setSymbol(const std::string & value){
-
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
-  }
-    
-  m_type = SymbolKind;
-
-  // copy construct in place
-  new (&stringValue) std::string(value);
+  setBoxed(SymbolKind, new SharedString(value));
 }
 
 void Atom::setComplex(const std::complex<double> value){
-  m_type = ComplexKind;
-  complexValue = value;
+  setBoxed(ComplexKind, new SharedComplex(value));
 }
 
 void Atom::setList() {
-	m_type = ListKind;
+	setBoxed(ListKind);
 }
 
 void Atom::setLambda() {
-	m_type = LambdaKind;
+	setBoxed(LambdaKind);
 }
 
 void Atom::setDiscretePlot() {
-  m_type = DiscreteKind;
+  setBoxed(DiscreteKind);
 }
 
 void Atom::setContinuousPlot() {
-  m_type = ContinuousKind;
+  setBoxed(ContinuousKind);
 }
 
 void Atom::setString(const std::string & value) {
-	// we need to ensure the destructor of the symbol string is called
-	if (m_type == StringKind) {
-		stringValue.~basic_string();
-	}
-
-	m_type = StringKind;
-
-	// copy construct in place
-	new (&stringValue) std::string(value);
+	setBoxed(StringKind, new SharedString(value));
 }
 
-double Atom::asNumber() const noexcept{
+double Atom::complexAsNumber() const noexcept{
   // Convert a complex to a number if the current type is complex
-  if(m_type == ComplexKind){
-    double comtoNumber = complexValue.real();
-    return comtoNumber;
-  }
-  return (m_type == NumberKind) ? numberValue : 0.0;  
+  return (type() == ComplexKind) ? complexValue().real() : 0.0;
 }
 
 
@@ -208,8 +276,8 @@ std::string Atom::asSymbol() const noexcept{
 
   std::string result;
 
-  if(m_type == SymbolKind){
-    result = stringValue;
+  if(type() == SymbolKind){
+    result = stringValue();
   }
 
   return result;
@@ -219,14 +287,14 @@ std::string Atom::asString() const noexcept {
 	std::string result;
   std::ostringstream oss;
 
-	if (m_type == StringKind) {
-		oss << stringValue;
+	if (type() == StringKind) {
+		oss << stringValue();
 	}
-  else if(m_type == NumberKind){
-    oss << numberValue;
+  else if(type() == NumberKind){
+    oss << numberValue();
   }
-  else if(m_type == ComplexKind){
-    oss << complexValue;
+  else if(type() == ComplexKind){
+    oss << complexValue();
   }
   result = oss.str();
 	return result;
@@ -234,26 +302,26 @@ std::string Atom::asString() const noexcept {
 
 std::complex<double> Atom::asComplex() const noexcept{
   // Convert a number to a complex if the current type is number
-  if(m_type == NumberKind){
-    std::complex<double> numToComplex (numberValue,0.0);
+  if(type() == NumberKind){
+    std::complex<double> numToComplex (numberValue(),0.0);
     return numToComplex;
   }
-  return (m_type == ComplexKind) ? complexValue : (0.0);
+  return (type() == ComplexKind) ? complexValue() : (0.0);
 }
 
 bool Atom::operator==(const Atom & right) const noexcept{
   
-  if(m_type != right.m_type) return false;
+  if(type() != right.type()) return false;
 
-  switch(m_type){
+  switch(type()){
   case NoneKind:
-    if(right.m_type != NoneKind) return false;
+    if(right.type() != NoneKind) return false;
     break;
   case NumberKind:
     {
-      if(right.m_type != NumberKind) return false;
-      double dleft = numberValue;
-      double dright = right.numberValue;
+      if(right.type() != NumberKind) return false;
+      double dleft = numberValue();
+      double dright = right.numberValue();
       double diff = fabs(dleft - dright);
       if(std::isnan(diff) ||
 	 (diff > std::numeric_limits<double>::epsilon()*2.0)) return false;
@@ -261,31 +329,35 @@ bool Atom::operator==(const Atom & right) const noexcept{
     break;
   case SymbolKind:
     {
-      if(right.m_type != SymbolKind) return false;
+      if(right.type() != SymbolKind) return false;
 
-      return stringValue == right.stringValue;
+      return stringValue() == right.stringValue();
     }
     break;
   case ComplexKind:
   {
-    if(right.m_type != ComplexKind) return false;
-	std::complex<double> dleft = complexValue;
-	std::complex<double> dright = right.complexValue;
+    if(right.type() != ComplexKind) return false;
+	std::complex<double> dleft = complexValue();
+	std::complex<double> dright = right.complexValue();
 	std::complex<double> diff = (dleft - dright);
 	if (std::isnan(diff.real()) || std::isnan(diff.imag()) || 
     (diff.real() > std::numeric_limits<double>::epsilon()*2.0) || (diff.imag() > std::numeric_limits<double>::epsilon()*2.0)) return false;
   }
   break;
   case ListKind:
+  case LambdaKind:
+  case DiscreteKind:
+  case ContinuousKind:
   {
-	  if (right.m_type != ListKind) return false;
+	  // these kinds carry no value, the tails are compared by Expression
+	  if (right.type() != type()) return false;
   }
   break;
   case StringKind:
   {
-	  if (right.m_type != StringKind) return false;
+	  if (right.type() != StringKind) return false;
 
-	  return stringValue == right.stringValue;
+	  return stringValue() == right.stringValue();
   }
   break;
   default:
@@ -317,3 +389,41 @@ std::ostream & operator<<(std::ostream & out, const Atom & a){
   }
   return out;
 }
+
+bool Atom::identical(const Atom & right) const noexcept{
+
+  // Numbers, and the kinds without a value, are identical when their bits are
+  if(m_bits == right.m_bits) return true;
+  if(type() != right.type()) return false;
+
+  switch(type()){
+  case SymbolKind:
+  case StringKind:
+    return stringValue() == right.stringValue();
+  case ComplexKind:
+    return std::memcmp(&complexValue(), &right.complexValue(), sizeof(std::complex<double>)) == 0;
+  default:
+    return false;
+  }
+}
+
+std::size_t Atom::hash() const noexcept{
+
+  std::size_t h;
+  switch(type()){
+  case SymbolKind:
+  case StringKind:
+    h = std::hash<std::string>()(stringValue());
+    break;
+  case ComplexKind:
+    {
+      uint64_t parts[2];
+      std::memcpy(parts, &complexValue(), sizeof(parts));
+      h = std::hash<uint64_t>()(parts[0]) * 31 + std::hash<uint64_t>()(parts[1]);
+    }
+    break;
+  default:
+    h = std::hash<uint64_t>()(m_bits);
+  }
+  return h * 16 + type();
+}
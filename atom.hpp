@@ -6,12 +6,24 @@ Defines the Atom type and associated functions.
 
 #include "token.hpp"
 #include <complex>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 
+/// the bits of a negative quiet NaN, set in every boxed Atom
+const uint64_t BOX_PREFIX = 0xFFF8000000000000ull;
+
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
 
 This class provides value semantics.
+
+An Atom is a single 64 bit word. A Number is stored as its double, with any
+NaN made the canonical quiet NaN. Every other kind is stored in the space of
+negative quiet NaNs, which no Number then uses: the kind in four bits and a
+payload in the low 47 bits. Symbols, Strings and Complex values are held on
+the heap, shared by copies of the Atom with an atomic reference count, and
+the payload is their address divided by 8.
 */
 class Atom {
 public:
@@ -31,11 +43,17 @@ public:
   /// Construct an Atom directly from a Token
   Atom(const Token & token);
 
-  /// Copy-construct an Atom
-  Atom(const Atom & x);
+  /// Copy-construct an Atom, sharing any heap value
+  Atom(const Atom & x) noexcept;
+
+  /// Move-construct an Atom, leaving x None
+  Atom(Atom && x) noexcept;
 
   /// Assign an Atom
-  Atom & operator=(const Atom & x);
+  Atom & operator=(const Atom & x) noexcept;
+
+  /// Move-assign an Atom
+  Atom & operator=(Atom && x) noexcept;
 
   /// Atom destructor
   ~Atom();
@@ -82,6 +100,16 @@ public:
   /// equality comparison based on type and value
   bool operator==(const Atom & right) const noexcept;
 
+  /// exact equality of type and value, unlike operator== Numbers must
+  /// have the same bits
+  bool identical(const Atom & right) const noexcept;
+
+  /// return a hash of the type and value, equal for identical Atoms
+  std::size_t hash() const noexcept;
+
+  /// return the heap bytes of the value, shared by copies of the Atom
+  std::size_t heapBytes() const noexcept;
+
   void setList();
 
   void setLambda();
@@ -95,19 +123,29 @@ public:
 
 private:
 
-  // internal enum of known types
+  // internal enum of known types, the value is the tag of a boxed kind
   enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind, ListKind, LambdaKind, StringKind, DiscreteKind, ContinuousKind};
 
-  // track the type
-  Type m_type;
+  // the Number or boxed value
+  uint64_t m_bits;
+
+  // the type of the value
+  Type type() const noexcept;
 
-  // values for the known types. Note the use of a union requires care
-  // when setting non POD values (see setSymbol)
-  union {
-    double numberValue;
-    std::string stringValue;
-    std::complex<double> complexValue;
-  };
+  // the values, valid only for the matching types
+  double numberValue() const noexcept;
+  const std::string & stringValue() const noexcept;
+  const std::complex<double> & complexValue() const noexcept;
+
+  // asNumber of an Atom that is not a Number
+  double complexAsNumber() const noexcept;
+
+  // set the type, with the payload for a heap value
+  void setBoxed(Type t, const void * heap = nullptr) noexcept;
+
+  // add or drop a reference to any heap value
+  void retain() const noexcept;
+  void release() noexcept;
 
   // helper to set type and value of Number
   void setNumber(double value);
@@ -125,4 +163,20 @@ bool operator!=(const Atom &left, const Atom & right) noexcept;
 /// output stream rendering
 std::ostream & operator<<(std::ostream & out, const Atom & a);
 
+// the Number accessors are inline, as every arithmetic argument uses them
+
+inline bool Atom::isNumber() const noexcept{
+  return (m_bits & BOX_PREFIX) != BOX_PREFIX;
+}
+
+inline double Atom::numberValue() const noexcept{
+  double value;
+  std::memcpy(&value, &m_bits, sizeof(value));
+  return value;
+}
+
+inline double Atom::asNumber() const noexcept{
+  return isNumber() ? numberValue() : complexAsNumber();
+}
+
 #endif
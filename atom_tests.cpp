@@ -1,5 +1,8 @@
 #include "catch.hpp"
 
+#include <cmath>
+#include <limits>
+
 #include "atom.hpp"
 
 TEST_CASE( "Test constructors", "[atom]" ) {
@@ -231,3 +234,62 @@ TEST_CASE( "test comparison", "[atom]" ) {
 
 
 
+
+TEST_CASE( "Test compact representation", "[atom]" ) {
+
+  REQUIRE(sizeof(Atom) == 8);
+
+  {
+    INFO("NaN and infinite Numbers stay Numbers");
+    double values[] = {std::nan(""), -std::nan(""), std::numeric_limits<double>::infinity(),
+		       -std::numeric_limits<double>::infinity(), -0.0,
+		       std::numeric_limits<double>::denorm_min()};
+    for(double v : values){
+      Atom a(v);
+      REQUIRE(a.isNumber());
+      REQUIRE(!a.isNone());
+      REQUIRE((std::isnan(v) ? std::isnan(a.asNumber()) : (a.asNumber() == v)));
+    }
+  }
+
+  {
+    INFO("Copies share their value");
+    Atom b;
+    {
+      Atom a("\"a string\"");
+      Atom c(std::complex<double>(1, 2));
+      b = a;
+      a = c;
+      REQUIRE(a.isComplex());
+      REQUIRE(a == c);
+    }
+    REQUIRE(b.isString());
+    REQUIRE(b.asString() == "\"a string\"");
+
+    b = b;
+    REQUIRE(b.asString() == "\"a string\"");
+  }
+
+  {
+    INFO("Moves leave None");
+    Atom a("sym");
+    Atom b(std::move(a));
+    REQUIRE(a.isNone());
+    REQUIRE(b.asSymbol() == "sym");
+
+    Atom c(3.0);
+    c = std::move(b);
+    REQUIRE(b.isNone());
+    REQUIRE(c.asSymbol() == "sym");
+  }
+
+  {
+    INFO("Changing kind releases the old value");
+    Atom a("sym");
+    a.setList();
+    REQUIRE(a.isList());
+    REQUIRE(a.asSymbol() == "");
+    a.setString("\"s\"");
+    REQUIRE(a.isString());
+  }
+}
@@ -0,0 +1,230 @@
+#include "compile.hpp"
+
+// system includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define COMPILE_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN64) || defined(_WIN32)
+#include <stdlib.h>
+#endif
+
+// module includes
+#include "scan.hpp"
+#include "serialize.hpp"
+
+const char COMPILED_MAGIC[4] = {'P', 'L', 'S', 'C'};
+
+// the size and modification time identifying a version of the source
+struct SourceStamp {
+  uint64_t size;
+  int64_t mtime; // in nanoseconds, so an edit in the second of compilation shows
+};
+
+bool stampOf(const std::string & filename, SourceStamp & stamp){
+  struct stat info;
+  if(stat(filename.c_str(), &info) != 0) return false;
+  stamp.size = static_cast<uint64_t>(info.st_size);
+  stamp.mtime = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#if defined(__APPLE__)
+  stamp.mtime += info.st_mtimespec.tv_nsec;
+#elif defined(COMPILE_USE_MMAP)
+  stamp.mtime += info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+// return the absolute path of an existing file, so a compiled script finds
+// its source from any working directory
+std::string absolutePath(const std::string & filename){
+#if defined(COMPILE_USE_MMAP)
+  char * path = realpath(filename.c_str(), nullptr);
+#else
+  char * path = _fullpath(nullptr, filename.c_str(), 0);
+#endif
+  if(path == nullptr) return filename;
+  std::string result(path);
+  free(path);
+  return result;
+}
+
+// a read-only view of a whole file, memory mapped where supported
+class MappedFile {
+public:
+
+  MappedFile(const std::string & filename): m_data(nullptr), m_size(0) {
+#if defined(COMPILE_USE_MMAP)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return;
+    struct stat info;
+    if((fstat(fd, &info) == 0) && (info.st_size > 0)){
+      void * p = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p != MAP_FAILED){
+	m_data = static_cast<const char *>(p);
+	m_size = info.st_size;
+      }
+    }
+    close(fd);
+#else
+    std::ifstream ifs(filename, std::ios::binary);
+    m_buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+  }
+
+  ~MappedFile(){
+#if defined(COMPILE_USE_MMAP)
+    if(m_data != nullptr){
+      munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+  }
+
+  const char * data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile & operator=(const MappedFile &);
+
+  const char * m_data;
+  std::size_t m_size;
+#if !defined(COMPILE_USE_MMAP)
+  std::string m_buffer;
+#endif
+};
+
+template<typename T>
+void put(std::string & out, const T & value){
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template<typename T>
+bool get(const char * data, std::size_t size, std::size_t & pos, T & value){
+  if(sizeof(value) > size - pos) return false;
+  std::memcpy(&value, data + pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+bool compileScript(const std::string & source, const std::string & target,
+		   std::string & message){
+
+  SourceStamp stamp;
+  std::ifstream ifs(source, std::ios::binary);
+  if(!ifs || !stampOf(source, stamp)){
+    message = "Could not open file for reading.";
+    return false;
+  }
+  std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+  Expression ast = parseFast(text);
+  if(ast.head().isNone()){
+    message = "Invalid Program. Could not parse.";
+    return false;
+  }
+
+  std::string out(COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+  put(out, COMPILED_VERSION);
+  put(out, stamp.size);
+  put(out, stamp.mtime);
+  std::string path = absolutePath(source);
+  put(out, static_cast<uint32_t>(path.size()));
+  out.append(path);
+  out.append(encodeBindings({{"", ast}}));
+
+  std::ofstream ofs(target, std::ios::binary);
+  ofs.write(out.data(), out.size());
+  if(!ofs){
+    message = "Could not open file for writing.";
+    return false;
+  }
+  return true;
+}
+
+// parse the source file named by a stale or unusable compiled script, and
+// compile it again in place of the script, renaming a new file over it so a
+// process still mapping the old one is unaffected
+bool loadSource(const std::string & source, const std::string & filename,
+		Interpreter & interp, std::string & message){
+  std::ifstream ifs(source);
+  if(!ifs){
+    message = "Compiled script is out of date or invalid and its source is missing.";
+    return false;
+  }
+  if(!interp.parseStream(ifs)){
+    message = "Invalid Program. Could not parse.";
+    return false;
+  }
+  message = "Compiled script is out of date or invalid, using source " + source + ".";
+
+  std::string ignored;
+  std::string rewritten = filename + ".tmp";
+  if(compileScript(source, rewritten, ignored) &&
+     (std::rename(rewritten.c_str(), filename.c_str()) == 0)){
+    message = "Compiled script is out of date or invalid, recompiled it from source " + source + ".";
+  }
+  else{
+    std::remove(rewritten.c_str());
+  }
+  return true;
+}
+
+bool loadCompiledScript(const std::string & filename, Interpreter & interp,
+			std::string & message){
+
+  MappedFile file(filename);
+  const char * data = file.data();
+  std::size_t size = file.size();
+  if(data == nullptr){
+    message = "Could not open file for reading.";
+    return false;
+  }
+
+  // the header, without which the source is unknown; its layout up to the
+  // source path is the same in every version
+  std::size_t pos = 0;
+  char magic[sizeof(COMPILED_MAGIC)];
+  uint32_t version, length;
+  SourceStamp recorded;
+  if(!get(data, size, pos, magic) || (std::memcmp(magic, COMPILED_MAGIC, sizeof(magic)) != 0) ||
+     !get(data, size, pos, version)){
+    message = "Not a compiled script.";
+    return false;
+  }
+  if(!get(data, size, pos, recorded.size) || !get(data, size, pos, recorded.mtime) ||
+     !get(data, size, pos, length) || (length > size - pos)){
+    message = "Compiled script is truncated.";
+    return false;
+  }
+  std::string source(data + pos, length);
+  pos += length;
+
+  // prefer the source when it has changed since compilation, or was
+  // compiled by another version
+  SourceStamp current;
+  if((version != COMPILED_VERSION) ||
+     (stampOf(source, current) &&
+      ((current.size != recorded.size) || (current.mtime != recorded.mtime)))){
+    return loadSource(source, filename, interp, message);
+  }
+
+  if(!interp.parseImage(data + pos, size - pos)){
+    return loadSource(source, filename, interp, message);
+  }
+
+  message.clear();
+  return true;
+}
@@ -0,0 +1,54 @@
+/*! \file compile.hpp
+Defines the precompiled script format (.plsc) and its loader.
+
+A compiled script is the parsed AST of a source file in the binary encoding
+of serialize.hpp, preceded by a header of
+
+- the magic bytes "PLSC" and the compiled format version
+- the size and modification time (to the nanosecond) of the source file
+  when compiled
+- the absolute path of the source file
+
+The header keeps this layout in every version, so a compiled script of any
+version names its source.
+
+Loading maps the file into memory and rebuilds the AST without tokenizing or
+parsing. If the source file has changed since it was compiled, or the script
+is of another version or malformed, the loader falls back to parsing the
+source and compiles it again over the script.
+ */
+#ifndef COMPILE_HPP
+#define COMPILE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "interpreter.hpp"
+
+/// the file extension of compiled scripts
+const std::string COMPILED_EXTENSION = ".plsc";
+
+/// the version of the compiled script header, bumped on any change
+const uint32_t COMPILED_VERSION = 2;
+
+/*! Parse a source file and write it as a compiled script
+  \param source the path of the plotscript source file
+  \param target the path of the compiled script to write
+  \param message set to the reason on failure
+  \return true on success
+ */
+bool compileScript(const std::string & source, const std::string & target,
+		   std::string & message);
+
+/*! Load a compiled script into an interpreter, ready for evaluate()
+  \param filename the path of the compiled script
+  \param interp the interpreter to hold the AST
+  \param message set to the reason on failure, or to a note when the
+         source file was parsed instead of the compiled script (and the
+         script rewritten)
+  \return true if an AST was loaded from either file
+ */
+bool loadCompiledScript(const std::string & filename, Interpreter & interp,
+			std::string & message);
+
+#endif
@@ -0,0 +1,187 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compile.hpp"
+#include "interpreter.hpp"
+
+const std::string COMPILE_SOURCE = "compile_test.pls";
+const std::string COMPILE_TARGET = "compile_test.plsc";
+
+void writeFile(const std::string & filename, const std::string & contents){
+  std::ofstream ofs(filename, std::ios::binary);
+  ofs << contents;
+}
+
+std::string readFile(const std::string & filename){
+  std::ifstream ifs(filename, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+Expression evaluateCompiled(std::string & message){
+  Interpreter interp;
+  REQUIRE(loadCompiledScript(COMPILE_TARGET, interp, message));
+  return interp.evaluate();
+}
+
+TEST_CASE( "Test compiling and loading a script", "[compile]" ) {
+
+  writeFile(COMPILE_SOURCE, "(begin (define a (list 1 2 I \"s\")) (+ (length a) 0.5))");
+
+  std::string message;
+  REQUIRE(compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  REQUIRE(evaluateCompiled(message) == Expression(4.5));
+  REQUIRE(message.empty());
+
+  // the compiled script stands alone when its source is gone
+  std::remove(COMPILE_SOURCE.c_str());
+  REQUIRE(evaluateCompiled(message) == Expression(4.5));
+  REQUIRE(message.empty());
+
+  std::remove(COMPILE_TARGET.c_str());
+}
+
+TEST_CASE( "Test compiled script falls back to changed source", "[compile]" ) {
+
+  writeFile(COMPILE_SOURCE, "(+ 1 2)");
+
+  std::string message;
+  REQUIRE(compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  writeFile(COMPILE_SOURCE, "(+ 1 2 3)");
+  REQUIRE(evaluateCompiled(message) == Expression(6.));
+  REQUIRE(!message.empty());
+
+  // the fallback compiled the changed source over the script
+  REQUIRE(evaluateCompiled(message) == Expression(6.));
+  REQUIRE(message.empty());
+
+  std::remove(COMPILE_SOURCE.c_str());
+  std::remove(COMPILE_TARGET.c_str());
+}
+
+TEST_CASE( "Test compiled script notices an edit within a second", "[compile]" ) {
+
+  // give the two versions modification times in the same second
+  timespec times[2];
+  times[0].tv_sec = times[1].tv_sec = 1500000000;
+  times[0].tv_nsec = times[1].tv_nsec = 100;
+
+  writeFile(COMPILE_SOURCE, "(+ 1 2)");
+  REQUIRE(utimensat(AT_FDCWD, COMPILE_SOURCE.c_str(), times, 0) == 0);
+  std::string message;
+  REQUIRE(compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  writeFile(COMPILE_SOURCE, "(+ 1 5)");
+  times[0].tv_nsec = times[1].tv_nsec = 200;
+  REQUIRE(utimensat(AT_FDCWD, COMPILE_SOURCE.c_str(), times, 0) == 0);
+  REQUIRE(evaluateCompiled(message) == Expression(6.));
+  REQUIRE(!message.empty());
+
+  std::remove(COMPILE_SOURCE.c_str());
+  std::remove(COMPILE_TARGET.c_str());
+}
+
+TEST_CASE( "Test compiled script finds its source from another directory", "[compile]" ) {
+
+  const std::string dir = "compile_test_dir";
+  mkdir(dir.c_str(), 0755);
+  char cwd[4096];
+  REQUIRE(getcwd(cwd, sizeof(cwd)) != nullptr);
+
+  // compile in the directory, by a relative path
+  REQUIRE(chdir(dir.c_str()) == 0);
+  writeFile(COMPILE_SOURCE, "(+ 1 2)");
+  std::string message;
+  bool compiled = compileScript(COMPILE_SOURCE, COMPILE_TARGET, message);
+  REQUIRE(chdir(cwd) == 0);
+  REQUIRE(compiled);
+
+  // a file of the same relative path here is not the source
+  writeFile(COMPILE_SOURCE, "(+ 100 200)");
+  Interpreter interp;
+  REQUIRE(loadCompiledScript(dir + "/" + COMPILE_TARGET, interp, message));
+  REQUIRE(interp.evaluate() == Expression(3.));
+  REQUIRE(message.empty());
+
+  std::remove(COMPILE_SOURCE.c_str());
+  std::remove((dir + "/" + COMPILE_SOURCE).c_str());
+  std::remove((dir + "/" + COMPILE_TARGET).c_str());
+  rmdir(dir.c_str());
+}
+
+TEST_CASE( "Test compiled script falls back to source when corrupt", "[compile]" ) {
+
+  writeFile(COMPILE_SOURCE, "(* 2 3)");
+
+  std::string message;
+  REQUIRE(compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  // damage the encoded AST, leaving the header intact
+  std::string compiled = readFile(COMPILE_TARGET);
+  writeFile(COMPILE_TARGET, compiled.substr(0, compiled.size() - 3));
+
+  REQUIRE(evaluateCompiled(message) == Expression(6.));
+  REQUIRE(!message.empty());
+
+  // the damaged script was compiled again, so stands alone
+  std::remove(COMPILE_SOURCE.c_str());
+  REQUIRE(evaluateCompiled(message) == Expression(6.));
+  REQUIRE(message.empty());
+
+  // damaged with its source gone, it cannot be loaded
+  compiled = readFile(COMPILE_TARGET);
+  writeFile(COMPILE_TARGET, compiled.substr(0, compiled.size() - 3));
+  Interpreter interp;
+  REQUIRE(!loadCompiledScript(COMPILE_TARGET, interp, message));
+
+  std::remove(COMPILE_TARGET.c_str());
+}
+
+TEST_CASE( "Test compiled script of another version falls back to source", "[compile]" ) {
+
+  writeFile(COMPILE_SOURCE, "(+ 1 2)");
+
+  std::string message;
+  REQUIRE(compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  // the version follows the magic bytes
+  std::string compiled = readFile(COMPILE_TARGET);
+  const uint32_t older = COMPILED_VERSION - 1;
+  compiled.replace(4, sizeof(older), reinterpret_cast<const char *>(&older), sizeof(older));
+  writeFile(COMPILE_TARGET, compiled);
+
+  REQUIRE(evaluateCompiled(message) == Expression(3.));
+  REQUIRE(!message.empty());
+
+  // and is rewritten in the current version
+  REQUIRE(evaluateCompiled(message) == Expression(3.));
+  REQUIRE(message.empty());
+
+  std::remove(COMPILE_SOURCE.c_str());
+  std::remove(COMPILE_TARGET.c_str());
+}
+
+TEST_CASE( "Test compile errors", "[compile]" ) {
+
+  std::string message;
+  Interpreter interp;
+
+  REQUIRE(!compileScript("does-not-exist.pls", COMPILE_TARGET, message));
+  REQUIRE(!message.empty());
+
+  writeFile(COMPILE_SOURCE, "(+ 1 2");
+  REQUIRE(!compileScript(COMPILE_SOURCE, COMPILE_TARGET, message));
+
+  // a source file is not a compiled script
+  REQUIRE(!loadCompiledScript(COMPILE_SOURCE, interp, message));
+  REQUIRE(!loadCompiledScript("does-not-exist.plsc", interp, message));
+
+  std::remove(COMPILE_SOURCE.c_str());
+}
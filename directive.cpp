@@ -0,0 +1,180 @@
+#include "directive.hpp"
+
+// system includes
+#include <cstdlib>
+
+// module includes
+#include "memo.hpp"
+#include "memstats.hpp"
+#include "profile.hpp"
+#include "sampler.hpp"
+#include "session.hpp"
+
+// the bindings %mem shows by default
+const std::size_t DEFAULT_MEM_BINDINGS = 10;
+
+// split a directive line into its name and its (trimmed) argument
+void splitDirective(const std::string & line, std::string & name, std::string & arg){
+  const char * space = " \t\r\n";
+
+  std::size_t end = line.find_first_of(space);
+  name = line.substr(0, end);
+
+  arg.clear();
+  if(end != std::string::npos){
+    std::size_t first = line.find_first_not_of(space, end);
+    if(first != std::string::npos){
+      arg = line.substr(first, line.find_last_not_of(space) - first + 1);
+    }
+  }
+}
+
+bool handleDirective(Interpreter & interp, const std::string & line, std::string & reply){
+
+  if(line.empty() || (line[0] != DIRECTIVE_CHAR)) return false;
+
+  std::string name, arg;
+  splitDirective(line, name, arg);
+
+  std::string message;
+  if(name == "%save"){
+    if(arg.empty()){
+      reply = "Error: %save requires a file name.";
+    }
+    else if(!saveSession(interp, arg, message)){
+      reply = "Error: " + message;
+    }
+    else{
+      reply = "Session saved to " + arg + ".";
+    }
+    return true;
+  }
+  if(name == "%load"){
+    if(arg.empty()){
+      reply = "Error: %load requires a file name.";
+    }
+    else if(!loadSession(interp, arg, message)){
+      reply = "Error: " + message;
+    }
+    else{
+      reply = "Session loaded from " + arg + ".";
+    }
+    return true;
+  }
+  if(name == "%memo"){
+    std::string option, value;
+    splitDirective(arg, option, value);
+    if(option.empty()){
+      MemoStats stats = memoStats();
+      reply = "Memo cache: " + std::to_string(stats.entries) + " of " +
+	std::to_string(stats.capacity) + " entries, " + std::to_string(stats.hits) +
+	" hits, " + std::to_string(stats.misses) + " misses, " +
+	std::to_string(stats.evictions) + " evictions.";
+    }
+    else if(option == "clear"){
+      clearMemo();
+      reply = "Memo cache cleared.";
+    }
+    else if(option == "capacity"){
+      char * end = nullptr;
+      unsigned long long capacity = std::strtoull(value.c_str(), &end, 10);
+      if(value.empty() || (value[0] == '-') || (*end != '\0')){
+	reply = "Error: %memo capacity requires a number of entries.";
+      }
+      else{
+	setMemoCapacity(capacity);
+	reply = "Memo capacity set to " + value + ".";
+      }
+    }
+    else{
+      reply = "Error: unknown %memo option " + option + ".";
+    }
+    return true;
+  }
+  if(name == "%mem"){
+    char * end = nullptr;
+    unsigned long long top = std::strtoull(arg.c_str(), &end, 10);
+    if(arg.empty()){
+      reply = formatMemoryStats(interp.retainedSizes(), DEFAULT_MEM_BINDINGS);
+    }
+    else if((arg[0] == '-') || (*end != '\0')){
+      reply = "Error: %mem takes a number of bindings to show.";
+    }
+    else{
+      reply = formatMemoryStats(interp.retainedSizes(), top);
+    }
+    return true;
+  }
+  if(name == "%profile"){
+    if(arg == "on"){
+      setProfiling(true);
+      reply = "Profiling on.";
+    }
+    else if(arg == "off"){
+      setProfiling(false);
+      reply = "Profiling off.";
+    }
+    else if(arg == "report"){
+      reply = formatProfile();
+    }
+    else if(arg == "clear"){
+      clearProfile();
+      reply = "Profile cleared.";
+    }
+    else{
+      reply = "Error: %profile requires on, off, report or clear.";
+    }
+    return true;
+  }
+  if(name == "%sample"){
+    std::string option, value;
+    splitDirective(arg, option, value);
+    if(option == "on"){
+      char * end = nullptr;
+      unsigned long hz = value.empty() ? DEFAULT_SAMPLE_HZ : std::strtoul(value.c_str(), &end, 10);
+      if(!value.empty() && ((value[0] == '-') || (*end != '\0') || (hz == 0) || (hz > 1000000))){
+	reply = "Error: %sample on takes a number of samples per second.";
+      }
+      else if(!startSampling(static_cast<unsigned>(hz))){
+	reply = "Error: could not start the sampling timer.";
+      }
+      else{
+	reply = "Sampling on at " + std::to_string(hz) + " Hz.";
+      }
+    }
+    else if((option == "off") && value.empty()){
+      stopSampling();
+      reply = "Sampling off, " + std::to_string(sampleCount()) + " samples.";
+    }
+    else if((option == "report") && value.empty()){
+      reply = foldedStacks();
+      if(reply.empty()){
+	reply = "No samples.";
+      }
+      else{
+	reply.pop_back();
+      }
+    }
+    else if(option == "dump"){
+      if(value.empty()){
+	reply = "Error: %sample dump requires a file name.";
+      }
+      else if(!writeFoldedStacks(value, message)){
+	reply = "Error: " + message;
+      }
+      else{
+	reply = "Samples written to " + value + ".";
+      }
+    }
+    else if((option == "clear") && value.empty()){
+      clearSamples();
+      reply = "Samples cleared.";
+    }
+    else{
+      reply = "Error: %sample requires on [hz], off, report, dump file or clear.";
+    }
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,45 @@
+/*! \file directive.hpp
+Defines the kernel directives, lines beginning with % that are handled by the
+kernel thread itself rather than parsed as plotscript.
+
+- %save file : write a session snapshot of the kernel's definitions
+- %load file : restore the definitions of a session snapshot
+- %memo : show the counters of the memo cache (see memo.hpp)
+- %memo clear : drop the cached results and zero the counters
+- %memo capacity n : keep at most n cached results
+- %profile on : start profiling evaluation (see profile.hpp)
+- %profile off : stop profiling, keeping the totals
+- %profile report : show the totals
+- %profile clear : zero the totals
+- %sample on [hz] : start sampling plotscript call stacks, hz (default
+  1000) times a second of CPU time (see sampler.hpp)
+- %sample off : stop sampling, keeping the samples
+- %sample report : show the samples as folded stacks
+- %sample dump file : write the folded stacks to a file, for flamegraph tools
+- %sample clear : drop the samples
+- %mem [n] : show the memory counters and the n (default 10) largest
+  bindings (see memstats.hpp)
+
+Directives that control the kernel thread (%start, %stop, %reset, %exit) are
+handled by the front end before a line reaches the kernel.
+ */
+#ifndef DIRECTIVE_HPP
+#define DIRECTIVE_HPP
+
+#include <string>
+
+#include "interpreter.hpp"
+
+/// the first character of every directive
+const char DIRECTIVE_CHAR = '%';
+
+/*! Run a line as a kernel directive if it is one
+  \param interp the kernel's interpreter
+  \param line the input line
+  \param reply set to the message to show for the directive, errors begin
+         with "Error: "
+  \return false if the line is not a kernel directive
+ */
+bool handleDirective(Interpreter & interp, const std::string & line, std::string & reply);
+
+#endif
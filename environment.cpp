@@ -10,35 +10,83 @@
 #include "semantic_error.hpp"
 
 /*********************************************************************** 
-Helper Functions
+Procedure
 **********************************************************************/
 
-// predicate, the number of args is nargs
-bool nargs_equal(const std::vector<Expression> & args, unsigned nargs){
-  return args.size() == nargs;
+Procedure::Procedure(ProcedureFunction function, std::size_t minArgs,
+		     std::size_t maxArgs, const char * arityError) noexcept:
+  m_function(function), m_contextFunction(nullptr), m_vectorFunction(nullptr),
+  m_context(nullptr), m_minArgs(minArgs), m_maxArgs(maxArgs), m_arityError(arityError) {}
+
+Procedure::Procedure(ContextFunction function, VectorFunction vector, const void * context,
+		     std::size_t minArgs, std::size_t maxArgs, const char * arityError) noexcept:
+  m_function(nullptr), m_contextFunction(function), m_vectorFunction(vector),
+  m_context(context), m_minArgs(minArgs), m_maxArgs(maxArgs), m_arityError(arityError) {}
+
+bool Procedure::accepts(std::size_t nargs) const noexcept{
+  return (nargs >= m_minArgs) && (nargs <= m_maxArgs);
+}
+
+void Procedure::checkArity(std::size_t nargs) const{
+  if(!accepts(nargs)){
+    throw SemanticError(m_arityError);
+  }
+}
+
+Expression Procedure::operator()(ArgSpan args) const{
+  checkArity(args.size());
+  if(m_contextFunction != nullptr){
+    return m_contextFunction(m_context, args);
+  }
+  return m_function(args);
+}
+
+bool Procedure::isVectorized() const noexcept{
+  return m_vectorFunction != nullptr;
+}
+
+void Procedure::map(const double * in, double * out, std::size_t n) const{
+  checkArity(1);
+  m_vectorFunction(m_context, in, out, n);
+}
+
+bool Procedure::operator==(const Procedure & other) const noexcept{
+  return (m_function == other.m_function) && (m_contextFunction == other.m_contextFunction) &&
+    (m_context == other.m_context);
 }
 
 /*********************************************************************** 
 Each of the functions below have the signature that corresponds to the
-typedef'd Procedure function pointer.
+typedef'd ProcedureFunction function pointer. The number of arguments has
+been checked against the arity in BUILTIN_PROCEDURES before they are called.
 **********************************************************************/
 
 // the default procedure always returns an expresison of type None
-Expression default_proc(const std::vector<Expression> & args){
+Expression default_proc(ArgSpan args){
   args.size(); // make compiler happy we used this parameter
   return Expression();
 };
 
-Expression add(const std::vector<Expression> & args){
+Expression add(ArgSpan args){
 
-  // check all aruments are numbers or complex, while adding
-  std::complex<double> result (0.0,0.0);
-  for( auto & a :args){
-    if(a.isHeadNumber()){
-      result += a.head().asNumber();      
+  // add in double while the arguments are numbers
+  double sum = 0;
+  auto a = args.begin();
+  for(; (a != args.end()) && a->isHeadNumber(); ++a){
+    sum += a->head().asNumber();
+  }
+  if(a == args.end()){
+    return Expression(sum);
+  }
+
+  // check the remaining aruments are numbers or complex, while adding
+  std::complex<double> result (sum,0.0);
+  for(; a != args.end(); ++a){
+    if(a->isHeadNumber()){
+      result += a->head().asNumber();      
     }
-    else if(a.isHeadComplex()){
-      result += a.head().asComplex();
+    else if(a->isHeadComplex()){
+      result += a->head().asComplex();
     }
     else{
       throw SemanticError("Error in call to add, argument not a number");
@@ -52,140 +100,105 @@ Expression add(const std::vector<Expression> & args){
   return Expression(result);
 };
 
-Expression mul(const std::vector<Expression> & args){
+Expression mul(ArgSpan args){
  
-  // check all aruments are numbers or complex, while multiplying
-  bool complexArgs = false;
-  std::complex<double> result (1.0,0.0);
-  for( auto & a :args){
-    if(a.isHeadNumber()){
-      result *= a.head().asNumber();      
+  // multiply in double while the arguments are numbers
+  double product = 1;
+  auto a = args.begin();
+  for(; (a != args.end()) && a->isHeadNumber(); ++a){
+    product *= a->head().asNumber();
+  }
+  if(a == args.end()){
+    return Expression(product);
+  }
+
+  // check the remaining aruments are numbers or complex, while multiplying,
+  // the result is complex once there is a complex argument
+  std::complex<double> result (product,0.0);
+  for(; a != args.end(); ++a){
+    if(a->isHeadNumber()){
+      result *= a->head().asNumber();      
     }
-    else if(a.isHeadComplex()){
-      complexArgs = true;
-      result *= a.head().asComplex();
+    else if(a->isHeadComplex()){
+      result *= a->head().asComplex();
     }
     else{
       throw SemanticError("Error in call to mul, argument not a number");
     }
   }
-  
-  if(result.imag() == 0 && complexArgs == false) {
-    double newresult = result.real();
-    return Expression(newresult);
-  }
   return Expression(result);
 };
 
-Expression subneg(const std::vector<Expression> & args){
+Expression subneg(ArgSpan args){
 
-  std::complex<double> result (0.0,0.0);
-  bool complexArgs = false;
-  // preconditions
-  if(nargs_equal(args,1)){
+  // one argument is negation
+  if(args.size() == 1){
     if(args[0].isHeadNumber()){
-      result = -args[0].head().asNumber();
+      return Expression(-args[0].head().asNumber());
     }
     else if(args[0].isHeadComplex()){
-      complexArgs = true;
-      result = -args[0].head().asComplex();
-    }
-    else{
-      throw SemanticError("Error in call to negate: invalid argument.");
+      return Expression(-args[0].head().asComplex());
     }
+    throw SemanticError("Error in call to negate: invalid argument.");
   }
-  // if there are 2 arguments proceed with subtraction only if the 2 args are either number or complex
-  else if(nargs_equal(args,2)){
-    if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
-      result = args[0].head().asNumber() - args[1].head().asNumber();
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
-      complexArgs = true;
-      result = args[0].head().asComplex() - args[1].head().asComplex();
-    }
-    else if ( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
-      complexArgs = true;
-      result = args[0].head().asComplex() - args[1].head().asNumber();
-    }
-    else if ( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
-      result = args[0].head().asNumber() - args[1].head().asComplex();
-    }
-    else{      
-      throw SemanticError("Error in call to subtraction: invalid argument.");
-    }
+
+  // with 2 arguments proceed with subtraction only if the 2 args are either number or complex
+  if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
+    return Expression(args[0].head().asNumber() - args[1].head().asNumber());
   }
-  else{
-    throw SemanticError("Error in call to subtraction or negation: invalid number of arguments.");
+  else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
+    return Expression(args[0].head().asComplex() - args[1].head().asComplex());
   }
-  // Returns number if no complex
-  if(result.imag() == 0 && complexArgs == false) {
-    double newresult = result.real();
-    return Expression(newresult);
+  else if ( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
+    return Expression(args[0].head().asComplex() - args[1].head().asNumber());
   }
-  return Expression(result);
+  else if ( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
+    std::complex<double> result = args[0].head().asNumber() - args[1].head().asComplex();
+    // Returns number if no imaginary part
+    if(result.imag() == 0) {
+      return Expression(result.real());
+    }
+    return Expression(result);
+  }
+  throw SemanticError("Error in call to subtraction: invalid argument.");
 };
 
 
-Expression div(const std::vector<Expression> & args){
+Expression div(ArgSpan args){
 
-  std::complex<double> result (1.0,0.0); 
-  bool complexArgs = false;
-  if (nargs_equal(args, 1)) {
-	  if ((args[0].isHeadComplex())) {
-		  complexArgs = true;
-		  result /= args[0].head().asComplex();
-	  }
-	  else if (args[0].isHeadNumber()) {
-		  result = 1 / args[0].head().asNumber();
-	  }
-	  else {
-		  throw SemanticError("Error in call to division: invalid argument.");
-	  }
-  }
-  // check all arguments are number or complex while dividing
-  else if(nargs_equal(args, 2)) {
-	  result = std::pow(args[0].head().asComplex(),2);
-	  for (auto & a : args) {
-		  if (a.isHeadNumber()) {
-			  result /= a.head().asNumber();
-		  }
-		  else if (a.isHeadComplex()) {
-			  complexArgs = true;
-			  result /= a.head().asComplex();
-		  }
-		  else {
-			  throw SemanticError("Error in call to division: invalid argument.");
-		  }
-	  }
-  }
-  else {
-	  throw SemanticError("Error in call to division: invalid number of arguments.");
+  for (auto & a : args) {
+    if (!a.isHeadNumber() && !a.isHeadComplex()) {
+      throw SemanticError("Error in call to division: invalid argument.");
+    }
   }
-  // Returns number if no complex
-  if(result.imag() == 0 && complexArgs == false) {
-    double newresult = result.real();
-    return Expression(newresult);
+
+  // one argument is the reciprocal
+  if (args.size() == 1) {
+    if (args[0].isHeadNumber()) {
+      return Expression(1 / args[0].head().asNumber());
+    }
+    return Expression(1.0 / args[0].head().asComplex());
   }
-  return Expression(result);
+
+  // the quotient is complex if either argument is
+  if (args[0].isHeadNumber() && args[1].isHeadNumber()) {
+    return Expression(args[0].head().asNumber() / args[1].head().asNumber());
+  }
+  return Expression(args[0].head().asComplex() / args[1].head().asComplex());
 };
 
-Expression sqrt(const std::vector<Expression> & args){
+Expression sqrt(ArgSpan args){
   std::complex<double> result (0.0,0.0);
   // check if argument is number, negative number, or complex when multiplying
-  if(nargs_equal(args,1)){
-    if(args[0].isHeadNumber() && args[0].head().asNumber() >= 0){
-      result = std::sqrt(args[0].head().asNumber());
-    }
-    else if(args[0].isHeadNumber() && args[0].head().asNumber() < 0){
-      std::complex<double> negativeNumber (args[0].head().asNumber(),0.0);
-      result = std::sqrt(negativeNumber);
-    }
-    else if(args[0].isHeadComplex()){
-      result = std::sqrt(args[0].head().asComplex());
-    }
+  if(args[0].isHeadNumber() && args[0].head().asNumber() >= 0){
+    result = std::sqrt(args[0].head().asNumber());
   }
-  else{
-    throw SemanticError("Error in call to square root: argument cannot be negative.");
+  else if(args[0].isHeadNumber() && args[0].head().asNumber() < 0){
+    std::complex<double> negativeNumber (args[0].head().asNumber(),0.0);
+    result = std::sqrt(negativeNumber);
+  }
+  else if(args[0].isHeadComplex()){
+    result = std::sqrt(args[0].head().asComplex());
   }
   // Returns number if no complex
   if(result.imag() == 0) {
@@ -195,32 +208,27 @@ Expression sqrt(const std::vector<Expression> & args){
   return Expression(result);
 };
 
-Expression pow(const std::vector<Expression> & args){
+Expression pow(ArgSpan args){
   std::complex<double> result (0.0,0.0);
   bool complexArgs = false;
   // check if number or complex when exponentiating
-  if(nargs_equal(args,2)){
-    if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
-      result = std::pow(args[0].head().asNumber(),args[1].head().asNumber());
-    }
-    else if( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
-      complexArgs = true;
-      result = std::pow(args[0].head().asNumber(),args[1].head().asComplex());
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
-      complexArgs = true;
-      result = std::pow(args[0].head().asComplex(),args[1].head().asNumber());
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
-      complexArgs = true;
-      result = std::pow(args[0].head().asComplex(),args[1].head().asComplex());
-    }
-    else{      
-      throw SemanticError("Error in call to power: invalid argument.");
-    }
+  if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
+    result = std::pow(args[0].head().asNumber(),args[1].head().asNumber());
   }
-  else{
-    throw SemanticError("Error in call to power: invalid number of arguments.");
+  else if( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
+    complexArgs = true;
+    result = std::pow(args[0].head().asNumber(),args[1].head().asComplex());
+  }
+  else if( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
+    complexArgs = true;
+    result = std::pow(args[0].head().asComplex(),args[1].head().asNumber());
+  }
+  else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
+    complexArgs = true;
+    result = std::pow(args[0].head().asComplex(),args[1].head().asComplex());
+  }
+  else{      
+    throw SemanticError("Error in call to power: invalid argument.");
   }
   // Returns number if no complex
   if(result.imag() == 0 && complexArgs == false) {
@@ -230,284 +238,209 @@ Expression pow(const std::vector<Expression> & args){
   return Expression(result);
 };
 
-Expression ln(const std::vector<Expression> & args){
+Expression ln(ArgSpan args){
   double result = 0;
   // check if argument is a positive number when doing ln
-  if(nargs_equal(args,1)){
-    if( args[0].head().asNumber() > 0){
-      if( (args[0].isHeadNumber()) ){
-        result = std::log(args[0].head().asNumber());
-      }
-      /*else{      
-        throw SemanticError("Error in call to ln: invalid argument.");
-      }*/
-    }
-    else{
-      throw SemanticError("Error in call to ln: negative numbers are not allowed.");
+  if( args[0].head().asNumber() > 0){
+    if( (args[0].isHeadNumber()) ){
+      result = std::log(args[0].head().asNumber());
     }
   }
   else{
-    throw SemanticError("Error in call to ln: invalid number of arguments.");
+    throw SemanticError("Error in call to ln: negative numbers are not allowed.");
   }
   return Expression(result);
 };
 
-Expression sin(const std::vector<Expression> & args){
-  double result = 0;
+Expression sin(ArgSpan args){
   // check if argument is a number when doing sin
-  if(nargs_equal(args,1)){
-      if( (args[0].isHeadNumber()) ){
-        result = std::sin(args[0].head().asNumber());
-      }
-      else{      
-        throw SemanticError("Error in call to sin: invalid argument.");
-      }
-  }
-  else{
-    throw SemanticError("Error in call to sin: invalid number of arguments.");
+  if( !(args[0].isHeadNumber()) ){
+    throw SemanticError("Error in call to sin: invalid argument.");
   }
-  return Expression(result);
+  return Expression(std::sin(args[0].head().asNumber()));
 };
 
-Expression cos(const std::vector<Expression> & args){
-  double result = 0;
+Expression cos(ArgSpan args){
   // check if argument is a number when doing cos
-  if(nargs_equal(args,1)){
-      if( (args[0].isHeadNumber()) ){
-        result = std::cos(args[0].head().asNumber());
-      }
-      else{      
-        throw SemanticError("Error in call to cos: invalid argument.");
-      }
-  }
-  else{
-    throw SemanticError("Error in call to cos: invalid number of arguments.");
+  if( !(args[0].isHeadNumber()) ){
+    throw SemanticError("Error in call to cos: invalid argument.");
   }
-  return Expression(result);
+  return Expression(std::cos(args[0].head().asNumber()));
 };
 
-Expression tan(const std::vector<Expression> & args){
-  double result = 0;
+Expression tan(ArgSpan args){
   // check if argument is a number when doing tan
-  if(nargs_equal(args,1)){
-      if( (args[0].isHeadNumber()) ){
-        result = std::tan(args[0].head().asNumber());
-      }
-      else{      
-        throw SemanticError("Error in call to tan: invalid argument.");
-      }
+  if( !(args[0].isHeadNumber()) ){
+    throw SemanticError("Error in call to tan: invalid argument.");
   }
-  else{
-    throw SemanticError("Error in call to tan: invalid number of arguments.");
-  }
-  return Expression(result);
+  return Expression(std::tan(args[0].head().asNumber()));
 };
 
 // Returns real part of complex as a number, error if argument not complex
-Expression real(const std::vector<Expression> & args){
-  if(nargs_equal(args,1)){
-    if( (args[0].isHeadComplex()) ){
-      double result = args[0].head().asComplex().real();
-      return Expression(result);
-    }
-    else{
-      throw SemanticError("Error in call to real: invalid argument");
-    }
-  }
-  else{
-    throw SemanticError("Error in call to real: invalid number of arguments.");
+Expression real(ArgSpan args){
+  if( !(args[0].isHeadComplex()) ){
+    throw SemanticError("Error in call to real: invalid argument");
   }
+  return Expression(args[0].head().asComplex().real());
 };
 
 // Returns imag part of complex as a number, error if argument not complex
-Expression imag(const std::vector<Expression> & args){
-  if(nargs_equal(args,1)){
-    if( (args[0].isHeadComplex()) ){
-      double result = args[0].head().asComplex().imag();
-      return Expression(result);
-    }
-    else{
-      throw SemanticError("Error in call to imag: invalid argument");
-    }
-  }
-  else{
-    throw SemanticError("Error in call to imag: invalid number of arguments.");
+Expression imag(ArgSpan args){
+  if( !(args[0].isHeadComplex()) ){
+    throw SemanticError("Error in call to imag: invalid argument");
   }
+  return Expression(args[0].head().asComplex().imag());
 };
 
 // Returns magnitude(absolute value) of complex as a number, error if argument not complex
-Expression mag(const std::vector<Expression> & args){
-  if(nargs_equal(args,1)){
-    if( (args[0].isHeadComplex()) ){
-      double result = std::abs(args[0].head().asComplex());
-      return Expression(result);
-    }
-    else{
-      throw SemanticError("Error in call to mag: invalid argument");
-    }
-  }
-  else{
-    throw SemanticError("Error in call to mag: invalid number of arguments.");
+Expression mag(ArgSpan args){
+  if( !(args[0].isHeadComplex()) ){
+    throw SemanticError("Error in call to mag: invalid argument");
   }
+  return Expression(std::abs(args[0].head().asComplex()));
 };
 
 // Returns arg(phase angle) of complex as a number, error if argument not complex
-Expression arg(const std::vector<Expression> & args){
-  if(nargs_equal(args,1)){
-    if( (args[0].isHeadComplex()) ){
-      double result = std::arg(args[0].head().asComplex());
-      return Expression(result);
-    }
-    else{
-      throw SemanticError("Error in call to arg: invalid argument");
-    }
-  }
-  else{
-    throw SemanticError("Error in call to arg: invalid number of arguments.");
+Expression arg(ArgSpan args){
+  if( !(args[0].isHeadComplex()) ){
+    throw SemanticError("Error in call to arg: invalid argument");
   }
+  return Expression(std::arg(args[0].head().asComplex()));
 };
 
 // Returns conjugate of complex as a number, error if argument not complex
-Expression conj(const std::vector<Expression> & args){
-  if(nargs_equal(args,1)){
-    if( (args[0].isHeadComplex()) ){
-      std::complex<double> result (args[0].head().asComplex());
-      result = std::conj(result);
-      return Expression(result);
-    }
-    else{
-      throw SemanticError("Error in call to conj: invalid argument");
-    }
-  }
-  else{
-    throw SemanticError("Error in call to conj: invalid number of arguments.");
+Expression conj(ArgSpan args){
+  if( !(args[0].isHeadComplex()) ){
+    throw SemanticError("Error in call to conj: invalid argument");
   }
+  return Expression(std::conj(args[0].head().asComplex()));
 };
 
 // Returns list as a vector of expressions
-Expression list(const std::vector<Expression> & args) {
-	std::vector<Expression> result = args;
-	return Expression(result);
+Expression list(ArgSpan args) {
+	return Expression(std::vector<Expression>(args.begin(), args.end()));
 };
 
 // Returns the first entry in a list
-Expression first(const std::vector<Expression> & args) {
-	std::vector<Expression> result = args;
-	if (nargs_equal(args, 1) && (result[0].isHeadNumber() || result[0].isHeadComplex() || result[0].isHeadSymbol())) {
+Expression first(ArgSpan args) {
+	if (args[0].isHeadNumber() || args[0].isHeadComplex() || args[0].isHeadSymbol()) {
 		throw SemanticError("Error in call to first: argument is not a list.");
 	}
-	if (nargs_equal(args, 1)) {
-		if (args[0].tailConstBegin() == args[0].tailConstEnd()) {
-			throw SemanticError("Error in call to first: arugment to empty list.");
-		}
-		else {
-			return Expression(*result[0].tailConstBegin());
-		}
-	}
-	else {
-		throw SemanticError("Error in call to first: invalid number of arguments.");
+	if (args[0].tailConstBegin() == args[0].tailConstEnd()) {
+		throw SemanticError("Error in call to first: arugment to empty list.");
 	}
-	
+	return *args[0].tailConstBegin();
 }
 
 // Returns all entries after the first in the list
-Expression rest(const std::vector<Expression> & args) {
-	std::vector<Expression> result;
-	if (nargs_equal(args, 1) && (!args[0].isHeadList())) {
+Expression rest(ArgSpan args) {
+	if (!args[0].isHeadList()) {
 		throw SemanticError("Error in call to rest: argument is not a list.");
 	}
-	if (nargs_equal(args, 1) ) {
-		if (args[0].tailConstBegin() == args[0].tailConstEnd()) {
-			throw SemanticError("Error in call to rest: arugment to empty list.");
-		}
-		else {
-			for (auto e = (args[0].tailConstBegin() + 1); e != args[0].tailConstEnd(); e++) {
-				result.push_back(Expression(*e));
-			}
-		}
-	}
-	else {
-		throw SemanticError("Error in call to rest: invalid number of arguments.");
+	if (args[0].tailConstBegin() == args[0].tailConstEnd()) {
+		throw SemanticError("Error in call to rest: arugment to empty list.");
 	}
-	return Expression(result);
+	return Expression(std::vector<Expression>(args[0].tailConstBegin() + 1, args[0].tailConstEnd()));
 }
 
 // Returns the length of the list
-Expression length(const std::vector<Expression> & args) {
-	std::vector<Expression> result;
-	int count = 0;
-	if (nargs_equal(args, 1) && (args[0].isHeadList())) {
-		for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); e++) {
-			count++;
-		}
-	}
-	else {
+Expression length(ArgSpan args) {
+	if (!args[0].isHeadList()) {
 		throw SemanticError("Error in call to length: argument is not a list.");
 	}
-	return Expression(count);
+	return Expression(static_cast<double>(args[0].tailConstEnd() - args[0].tailConstBegin()));
 }
 
 // Adds an expression to the end of the list
-Expression append(const std::vector<Expression> & args) {
-	std::vector<Expression> result;
-	if ((nargs_equal(args, 2)) && (args[0].isHeadList()) && (!args[1].isHeadList())) {
-		for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); e++) {
-			result.push_back(Expression(*e));
-		}
-		result.push_back(Expression(args[1]));
-	}
-	else if ((!nargs_equal(args, 2))) {
-		throw SemanticError("Error in call to append: invalid number of arguments, must be binary.");
-	}
-	else {
+Expression append(ArgSpan args) {
+	if (!args[0].isHeadList() || args[1].isHeadList()) {
 		throw SemanticError("Error in call to append: first argument is not a list.");
 	}
+	std::vector<Expression> result(args[0].tailConstBegin(), args[0].tailConstEnd());
+	result.push_back(args[1]);
 	return Expression(result);
 }
 
 // Joins two lists together
-Expression join(const std::vector<Expression> & args) {
-	std::vector<Expression> result;
-	if ((nargs_equal(args, 2)) && (args[0].isHeadList()) && (args[1].isHeadList())) {
-		for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); e++) {
-			result.push_back(Expression(*e));
-		}
-		for (auto f = (args[1].tailConstBegin()); f != args[1].tailConstEnd(); f++) {
-			result.push_back(Expression(*f));
-		}
-	}
-	else if ((!nargs_equal(args, 2))) {
-		throw SemanticError("Error in call to join: invalid number of arguments, must be binary.");
-	}
-	else {
+Expression join(ArgSpan args) {
+	if (!args[0].isHeadList() || !args[1].isHeadList()) {
 		throw SemanticError("Error in call to join: first argument is not a list.");
 	}
+	std::vector<Expression> result(args[0].tailConstBegin(), args[0].tailConstEnd());
+	result.insert(result.end(), args[1].tailConstBegin(), args[1].tailConstEnd());
 	return Expression(result);
 }
 
 // Creates a list with passed parameter of start,end, and increment
-Expression range(const std::vector<Expression> & args) {
-	std::vector<Expression> result;
-	if ((nargs_equal(args, 3)) && (args[0].isHeadNumber()) && (args[1].isHeadNumber()) && (args[2].isHeadNumber())) {
-		if ((args[0].head().asNumber()) >= (args[1].head().asNumber())) {
-			throw SemanticError("Error in call to range: first argument must be less then second argument.");
-		}
-		if ((args[2].head().asNumber()) <= 0) {
-			throw SemanticError("Error in call to range: third argument must be strictly positive.");
-		}
-		for (double i = args[0].head().asNumber(); i <= args[1].head().asNumber(); i = i + args[2].head().asNumber()) {
-			result.push_back(Expression(i));
-		}
+Expression range(ArgSpan args) {
+	if ((!args[0].isHeadNumber()) || (!args[1].isHeadNumber()) || (!args[2].isHeadNumber())) {
+		throw SemanticError("Error in call to range: all arguments must be numbers.");
 	}
-	else if ((!nargs_equal(args, 3))) {
-		throw SemanticError("Error in call to range: invalid number of arguments, must be ternary.");
+	if ((args[0].head().asNumber()) >= (args[1].head().asNumber())) {
+		throw SemanticError("Error in call to range: first argument must be less then second argument.");
 	}
-	else if ((!args[0].isHeadNumber()) || (!args[1].isHeadNumber()) || (!args[2].isHeadNumber())) {
-		throw SemanticError("Error in call to range: all arguments must be numbers.");
+	if ((args[2].head().asNumber()) <= 0) {
+		throw SemanticError("Error in call to range: third argument must be strictly positive.");
+	}
+	std::vector<Expression> result;
+	for (double i = args[0].head().asNumber(); i <= args[1].head().asNumber(); i = i + args[2].head().asNumber()) {
+		result.push_back(Expression(i));
 	}
 	return Expression(result);
 }
 
+// Creates a point, a list of any two expressions as the make-point lambda built
+Expression make_point(ArgSpan args) {
+	return makePoint(args[0], args[1]);
+}
+
+// Creates a line, a list of any two expressions as the make-line lambda built
+Expression make_line(ArgSpan args) {
+	return makeLine(args[0], args[1]);
+}
+
+// Creates text from any expression as the make-text lambda did
+Expression make_text(ArgSpan args) {
+	return makeText(args[0]);
+}
+
+// a built-in procedure, the arguments it accepts and the error for any other number
+struct BuiltinDescriptor {
+  const char * name;
+  ProcedureFunction function;
+  std::size_t minArgs;
+  std::size_t maxArgs;
+  const char * arityError;
+};
+
+const BuiltinDescriptor BUILTIN_PROCEDURES[] = {
+  {"+", add, 0, ANY_ARITY, nullptr},
+  {"-", subneg, 1, 2, "Error in call to subtraction or negation: invalid number of arguments."},
+  {"*", mul, 0, ANY_ARITY, nullptr},
+  {"/", div, 1, 2, "Error in call to division: invalid number of arguments."},
+  {"sqrt", sqrt, 1, 1, "Error in call to square root: argument cannot be negative."},
+  {"^", pow, 2, 2, "Error in call to power: invalid number of arguments."},
+  {"ln", ln, 1, 1, "Error in call to ln: invalid number of arguments."},
+  {"sin", sin, 1, 1, "Error in call to sin: invalid number of arguments."},
+  {"cos", cos, 1, 1, "Error in call to cos: invalid number of arguments."},
+  {"tan", tan, 1, 1, "Error in call to tan: invalid number of arguments."},
+  {"real", real, 1, 1, "Error in call to real: invalid number of arguments."},
+  {"imag", imag, 1, 1, "Error in call to imag: invalid number of arguments."},
+  {"mag", mag, 1, 1, "Error in call to mag: invalid number of arguments."},
+  {"arg", arg, 1, 1, "Error in call to arg: invalid number of arguments."},
+  {"conj", conj, 1, 1, "Error in call to conj: invalid number of arguments."},
+  {"list", list, 0, ANY_ARITY, nullptr},
+  {"first", first, 1, 1, "Error in call to first: invalid number of arguments."},
+  {"rest", rest, 1, 1, "Error in call to rest: invalid number of arguments."},
+  {"length", length, 1, 1, "Error in call to length: argument is not a list."},
+  {"append", append, 2, 2, "Error in call to append: invalid number of arguments, must be binary."},
+  {"join", join, 2, 2, "Error in call to join: invalid number of arguments, must be binary."},
+  {"range", range, 3, 3, "Error in call to range: invalid number of arguments, must be ternary."},
+  {"make-point", make_point, 2, 2, "Error: during apply : Error in call to procedure : invalid number of arguments."},
+  {"make-line", make_line, 2, 2, "Error: during apply : Error in call to procedure : invalid number of arguments."},
+  {"make-text", make_text, 1, 1, "Error: during apply : Error in call to procedure : invalid number of arguments."},
+};
+
 // A Helper function used in environment to help solve shadowing when using lambda
 void Environment::findProc(const std::string & str, Environment & env) {
 	if (env.envmap.find(str) != env.envmap.end()) {
@@ -526,12 +459,19 @@ Environment::Environment(){
 //copy construtor for Environment
 Environment::Environment(const Environment & a) {
 	envmap = a.envmap;
+	m_scope = a.m_scope;
+}
+
+Environment::Environment(const Environment & a, bool scope) {
+	envmap = a.envmap;
+	m_scope = scope;
 }
 
 Environment & Environment::operator=(const Environment & a) {
 	// prevent self-assignment
 	if (this != &a) {
 		envmap = a.envmap;
+		m_scope = a.m_scope;
 	}
 
 	return *this;
@@ -557,13 +497,23 @@ Expression Environment::get_exp(const Atom & sym) const{
   if(sym.isSymbol()){
     auto result = envmap.find(sym.asSymbol());
     if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
+      exp = *result->second.exp;
     }
   }
 
   return exp;
 }
 
+ExpressionHandle Environment::get_handle(const Atom & sym) const{
+  if(sym.isSymbol()){
+    auto result = envmap.find(sym.asSymbol());
+    if((result != envmap.end()) && (result->second.type == ExpressionType)){
+      return result->second.exp;
+    }
+  }
+  return ExpressionHandle();
+}
+
 void Environment::add_exp(const Atom & sym, const Expression & exp){
 
   if(!sym.isSymbol()){
@@ -575,7 +525,10 @@ void Environment::add_exp(const Atom & sym, const Expression & exp){
     envmap.erase(sym.asSymbol());
   }
 
-  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp)); 
+  // a call scope is dropped with the call, so hashing its values and
+  // taking the table's lock would cost more than sharing saves
+  ExpressionHandle handle = m_scope ? std::make_shared<const Expression>(exp) : internExpression(exp);
+  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, handle));
 }
 
 bool Environment::is_proc(const Atom & sym) const{
@@ -596,89 +549,79 @@ Procedure Environment::get_proc(const Atom & sym) const{
     }
   }
 
-  return default_proc;
+  return Procedure(default_proc);
 }
 
-/*
-Reset the environment to the default state. First remove all entries and
-then re-add the default ones.
- */
-void Environment::reset(){
-
-  envmap.clear();
-
-  // Built-In value of I
-  envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
-
-  // Built-In value of e
-  envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
-  
-  // Built-In value of pi
-  envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
-
-  // Procedure: add;
-  envmap.emplace("+", EnvResult(ProcedureType, add)); 
-
-  // Procedure: subneg;
-  envmap.emplace("-", EnvResult(ProcedureType, subneg)); 
+const Procedure * Environment::find_proc(const Atom & sym) const{
 
-  // Procedure: mul;
-  envmap.emplace("*", EnvResult(ProcedureType, mul)); 
-
-  // Procedure: div;
-  envmap.emplace("/", EnvResult(ProcedureType, div)); 
-
-  // Procedure: sqrt;
-  envmap.emplace("sqrt", EnvResult(ProcedureType, sqrt));
-
-  // Procedure: pow;
-  envmap.emplace("^", EnvResult(ProcedureType, pow));
+  if(sym.isSymbol()){
+    auto result = envmap.find(sym.asSymbol());
+    if((result != envmap.end()) && (result->second.type == ProcedureType)){
+      return &result->second.proc;
+    }
+  }
 
-  // Procedure: ln;
-  envmap.emplace("ln", EnvResult(ProcedureType, ln));
+  return nullptr;
+}
 
-  // Procedure: sin;
-  envmap.emplace("sin", EnvResult(ProcedureType, sin));
+void Environment::add_proc(const Atom & sym, const Procedure & proc){
 
-  // Procedure: cos;
-  envmap.emplace("cos", EnvResult(ProcedureType, cos));
+  if(!sym.isSymbol()){
+    throw SemanticError("Attempt to add non-symbol to environment");
+  }
 
-  // Procedure: tan;
-  envmap.emplace("tan", EnvResult(ProcedureType, tan));
+  envmap.erase(sym.asSymbol());
+  envmap.emplace(sym.asSymbol(), EnvResult(ProcedureType, proc));
+}
 
-  // Procedure: real;
-  envmap.emplace("real", EnvResult(ProcedureType, real));
+RetainedSizes Environment::retainedSizes() const{
 
-  // Procedure: imag;
-  envmap.emplace("imag", EnvResult(ProcedureType, imag));
+  RetainedSizes result;
+  for(auto & entry : envmap){
+    if(entry.second.type == ExpressionType){
+      result.emplace_back(entry.first, entry.second.exp->retainedBytes());
+    }
+  }
+  return result;
+}
 
-  // Procedure: mag;
-  envmap.emplace("mag", EnvResult(ProcedureType, mag));
+BindingList Environment::definitions() const{
 
-  // Procedure: arg;
-  envmap.emplace("arg", EnvResult(ProcedureType, arg));
+  Environment defaults;
+  BindingList result;
 
-  // Procedure: imag;
-  envmap.emplace("conj", EnvResult(ProcedureType, conj));
+  for(auto & entry : envmap){
+    if(entry.second.type != ExpressionType) continue;
 
-  // Procedure: list;
-  envmap.emplace("list", EnvResult(ProcedureType, list));
+    auto builtin = defaults.envmap.find(entry.first);
+    if((builtin == defaults.envmap.end()) || (builtin->second.type != ExpressionType)){
+      result.emplace_back(entry.first, *entry.second.exp);
+    }
+  }
 
-  // Procedure: first;
-  envmap.emplace("first", EnvResult(ProcedureType, first));
+  return result;
+}
 
-  // Procedure: rest;
-  envmap.emplace("rest", EnvResult(ProcedureType, rest));
+/*
+Reset the environment to the default state. First remove all entries and
+then re-add the default ones.
+ */
+void Environment::reset(){
 
-  // Procedure: length;
-  envmap.emplace("length", EnvResult(ProcedureType, length));
+  envmap.clear();
 
-  // Procedure: append;
-  envmap.emplace("append", EnvResult(ProcedureType, append));
+  // Built-In value of I
+  envmap.emplace("I", EnvResult(ExpressionType, internExpression(Expression(I))));
 
-  // Procedure: join;
-  envmap.emplace("join", EnvResult(ProcedureType, join));
+  // Built-In value of e
+  envmap.emplace("e", EnvResult(ExpressionType, internExpression(Expression(EXP))));
+  
+  // Built-In value of pi
+  envmap.emplace("pi", EnvResult(ExpressionType, internExpression(Expression(PI))));
 
-  // Procedure: range;
-  envmap.emplace("range", EnvResult(ProcedureType, range));
+  // Built-In procedures
+  for(auto & b : BUILTIN_PROCEDURES){
+    envmap.emplace(b.name, EnvResult(ProcedureType,
+				     Procedure(b.function, b.minArgs, b.maxArgs, b.arityError)));
+  }
 }
\ No newline at end of file
@@ -11,17 +11,157 @@ needed.
 #define ENVIRONMENT_HPP
 
 // system includes
+#include <cstddef>
 #include <map>
+#include <vector>
 
 // module includes
 #include "atom.hpp"
 #include "expression.hpp"
+#include "intern.hpp"
+#include "memstats.hpp"
 
-/*! \typedef Procedure
-\brief A Procedure is a C++ function pointer taking a vector of 
-       Expressions as arguments and returning an Expression.
+/*! \class ArgSpan
+\brief The arguments of a procedure call, a view of consecutive Expressions
+owned by the caller (during evaluation, the evaluator's argument stack).
+
+A vector of Expressions converts to an ArgSpan of its elements.
+*/
+class ArgSpan {
+public:
+
+  /// construct an empty span
+  ArgSpan() noexcept: m_first(nullptr), m_size(0) {}
+
+  /// construct a span of size Expressions starting at first
+  ArgSpan(const Expression * first, std::size_t size) noexcept: m_first(first), m_size(size) {}
+
+  /// construct a span of the elements of a vector
+  ArgSpan(const std::vector<Expression> & args) noexcept: m_first(args.data()), m_size(args.size()) {}
+
+  /// return the number of arguments
+  std::size_t size() const noexcept { return m_size; }
+
+  /// return true if there are no arguments
+  bool empty() const noexcept { return m_size == 0; }
+
+  /// return the argument at index
+  const Expression & operator[](std::size_t index) const noexcept { return m_first[index]; }
+
+  /// return a pointer to the first argument
+  const Expression * begin() const noexcept { return m_first; }
+
+  /// return a pointer past the last argument
+  const Expression * end() const noexcept { return m_first + m_size; }
+
+private:
+  const Expression * m_first;
+  std::size_t m_size;
+};
+
+/*! \typedef ProcedureFunction
+\brief A ProcedureFunction is a C++ function pointer taking the arguments
+       of a call and returning an Expression.
+*/
+typedef Expression (*ProcedureFunction)(ArgSpan args);
+
+/*! \typedef ContextFunction
+\brief A ContextFunction is a procedure function that also takes the context
+       pointer it was registered with, e.g. by a native extension.
+*/
+typedef Expression (*ContextFunction)(const void * context, ArgSpan args);
+
+/*! \typedef VectorFunction
+\brief A VectorFunction maps a unary procedure over n Numbers at once,
+       writing out[i] for each in[i], and throws SemanticError on failure.
+*/
+typedef void (*VectorFunction)(const void * context, const double * in,
+			       double * out, std::size_t n);
+
+/// the maximum arity of a procedure taking any number of arguments
+const std::size_t ANY_ARITY = static_cast<std::size_t>(-1);
+
+/*! \class Procedure
+\brief A built-in procedure: its function and its arity descriptor, the
+range of argument counts it accepts and the error raised for any other.
+
+Calling a Procedure checks the arity before the function is called; the
+evaluator checks it before evaluating the operands of a call.
+
+A procedure may instead have a ContextFunction called with a context
+pointer, and a VectorFunction the map special form uses when all the items
+of the list are Numbers.
+*/
+class Procedure {
+public:
+
+  /*! Construct a procedure
+    \param function the function called
+    \param minArgs the fewest arguments accepted
+    \param maxArgs the most arguments accepted, or ANY_ARITY
+    \param arityError the message of the SemanticError raised for any other
+           number of arguments
+   */
+  Procedure(ProcedureFunction function = nullptr, std::size_t minArgs = 0,
+	    std::size_t maxArgs = ANY_ARITY, const char * arityError = nullptr) noexcept;
+
+  /*! Construct a procedure with a context
+    \param function the function called with the context
+    \param vector the vectorized variant, or nullptr
+    \param context the context pointer, which must outlive the procedure
+    \param minArgs the fewest arguments accepted
+    \param maxArgs the most arguments accepted, or ANY_ARITY
+    \param arityError the message of the SemanticError raised for any other
+           number of arguments
+   */
+  Procedure(ContextFunction function, VectorFunction vector, const void * context,
+	    std::size_t minArgs, std::size_t maxArgs, const char * arityError) noexcept;
+
+  /// return true if the procedure accepts nargs arguments
+  bool accepts(std::size_t nargs) const noexcept;
+
+  /*! Check the procedure accepts nargs arguments
+    \throws SemanticError with the arity error if it does not
+   */
+  void checkArity(std::size_t nargs) const;
+
+  /*! Call the procedure
+    \throws SemanticError if it does not accept the number of arguments, or
+    the function raises an error
+   */
+  Expression operator()(ArgSpan args) const;
+
+  /// return true if the procedure has a vectorized variant
+  bool isVectorized() const noexcept;
+
+  /*! Call the vectorized variant on n Numbers
+    \throws SemanticError if the procedure does not accept one argument, or
+    the variant raises an error
+   */
+  void map(const double * in, double * out, std::size_t n) const;
+
+  /// procedures are equal if they call the same function with the same context
+  bool operator==(const Procedure & other) const noexcept;
+
+private:
+  ProcedureFunction m_function;
+  ContextFunction m_contextFunction;
+  VectorFunction m_vectorFunction;
+  const void * m_context;
+  std::size_t m_minArgs;
+  std::size_t m_maxArgs;
+  const char * m_arityError;
+};
+
+/*! \typedef Binding
+\brief A symbol name together with the Expression it maps to.
 */
-typedef Expression (*Procedure)(const std::vector<Expression> & args);
+typedef std::pair<std::string, Expression> Binding;
+
+/*! \typedef BindingList
+\brief A sequence of Bindings, e.g. the user definitions of an environment.
+*/
+typedef std::vector<Binding> BindingList;
 
 /*! \class Environment
 \brief A class representing the interpreter environment.
@@ -46,6 +186,13 @@ public:
   // construct an environment with a copy constructor
   Environment(const Environment & a);
 
+  /*! Construct the scope of a lambda call, a copy of a whose add_exp does
+    not intern values, as the scope lives only for the call
+    \param a the environment of the call
+    \param scope true for a call scope
+   */
+  Environment(const Environment & a, bool scope);
+
   //consturct an environment with an assignment operator
   Environment & operator=(const Environment & a);
 
@@ -68,7 +215,18 @@ public:
   */
   Expression get_exp(const Atom &sym) const;
 
-  /*! Add a mapping from sym argument to the exp argument within the environment.
+  /*! Get the shared handle of the Expression the symbol maps to, without
+    copying the value
+    \param sym the symbol to lookup
+    \return the handle, or nullptr if the symbol does not map to an
+    expression
+  */
+  ExpressionHandle get_handle(const Atom &sym) const;
+
+  /*! Add a mapping from sym argument to the exp argument within the
+    environment. Outside a call scope the value is interned (see
+    intern.hpp), so identical values share one copy; in any case copying
+    the environment does not copy it.
     \param sym the symbol to add
     \param exp the expression the symbol should map to
    */
@@ -89,6 +247,31 @@ public:
   */
   Procedure get_proc(const Atom &sym) const;
 
+  /*! Find the Procedure the argument symbol maps to
+    \param sym the symbol to lookup
+    \return a pointer to the procedure, valid while the mapping is, or
+    nullptr if the symbol does not map to a procedure
+  */
+  const Procedure * find_proc(const Atom &sym) const;
+
+  /*! Add a mapping from sym to a procedure, replacing any previous mapping
+    \param sym the symbol to add
+    \param proc the procedure the symbol should map to
+   */
+  void add_proc(const Atom &sym, const Procedure &proc);
+
+  /*! Collect the symbols that have been bound to an expression beyond the
+    built-in definitions.
+    \return the (symbol, expression) pairs in symbol order
+   */
+  BindingList definitions() const;
+
+  /*! Measure the values bound to symbols, including the built-in ones,
+    without copying them (see Expression::retainedBytes)
+    \return the (symbol, bytes) pairs in symbol order
+   */
+  RetainedSizes retainedSizes() const;
+
   /*! Reset the environment to its default state. */
   void reset();
 
@@ -101,17 +284,20 @@ private:
 
   struct EnvResult {
     EnvResultType type;
-    Expression exp; // used when type is ExpressionType
+    ExpressionHandle exp; // used when type is ExpressionType
     Procedure proc; // used when type is ProcedureType
 
     // constructors for use in container emplace
     EnvResult(){};
-    EnvResult(EnvResultType t, Expression e) : type(t), exp(e){};
+    EnvResult(EnvResultType t, ExpressionHandle e) : type(t), exp(e){};
     EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
   };
 
   // the environment map
   std::map<std::string, EnvResult> envmap;
+
+  // true for the scope of a lambda call, whose values are not interned
+  bool m_scope = false;
 };
 
 #endif
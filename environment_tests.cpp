@@ -4,6 +4,7 @@
 #include "semantic_error.hpp"
 
 #include <cmath>
+#include <string>
 
 TEST_CASE( "Test default constructor", "[environment]" ) {
 
@@ -73,6 +74,40 @@ TEST_CASE( "Test get built-in procedure", "[environment]" ) {
   REQUIRE(padd(args) == Expression(3.0));
 }
 
+TEST_CASE( "Test procedure arity descriptors", "[environment]" ) {
+  Environment env;
+
+  REQUIRE(env.find_proc(Atom("op")) == nullptr);
+  REQUIRE(env.find_proc(Atom("pi")) == nullptr);
+  const Procedure * pfirst = env.find_proc(Atom("first"));
+  REQUIRE(pfirst != nullptr);
+  REQUIRE(*pfirst == env.get_proc(Atom("first")));
+
+  REQUIRE(!pfirst->accepts(0));
+  REQUIRE(pfirst->accepts(1));
+  REQUIRE(!pfirst->accepts(2));
+  REQUIRE(env.get_proc(Atom("+")).accepts(0));
+  REQUIRE(env.get_proc(Atom("-")).accepts(2));
+  REQUIRE(!env.get_proc(Atom("-")).accepts(3));
+
+  try{
+    pfirst->checkArity(2);
+    FAIL("expected a SemanticError");
+  }
+  catch(const SemanticError & error){
+    REQUIRE(std::string(error.what()) == "Error in call to first: invalid number of arguments.");
+  }
+
+  // a span of part of an argument stack
+  std::vector<Expression> stack = {Expression(1.0), Expression(2.0), Expression(3.0)};
+  ArgSpan span(stack.data() + 1, 2);
+  REQUIRE(span.size() == 2);
+  REQUIRE(span[0] == Expression(2.0));
+  REQUIRE(env.get_proc(Atom("+"))(span) == Expression(5.0));
+  REQUIRE_THROWS_AS(env.get_proc(Atom("^"))(ArgSpan(stack.data(), 3)), SemanticError);
+  REQUIRE(env.get_proc(Atom("list"))(ArgSpan()) == Expression(std::vector<Expression>()));
+}
+
 TEST_CASE( "Test add procedure", "[environment]" ) {
   Environment env;
   std::vector<Expression> args;
@@ -215,6 +250,41 @@ TEST_CASE("Test div procedure", "[environment]") {
 	REQUIRE_THROWS_AS(pdiv(args), SemanticError);
 }
 
+TEST_CASE("Test arithmetic real and complex paths", "[environment]") {
+	Environment env;
+	Procedure padd = env.get_proc(Atom("+"));
+	Procedure pmul = env.get_proc(Atom("*"));
+	Procedure psub = env.get_proc(Atom("-"));
+	Procedure pdiv = env.get_proc(Atom("/"));
+	Expression I = env.get_exp(Atom("I"));
+	Expression minusI(std::complex<double>(0.0, -1.0));
+
+	INFO("all numbers stay numbers")
+	std::vector<Expression> reals = { Expression(0.0), Expression(5.0) };
+	REQUIRE(padd(reals).isHeadNumber());
+	REQUIRE(pmul(reals).isHeadNumber());
+	REQUIRE(psub(reals).isHeadNumber());
+	REQUIRE(pdiv(reals) == Expression(0.0));
+	REQUIRE(pdiv(reals).isHeadNumber());
+
+	INFO("a complex argument part way through promotes the result")
+	std::vector<Expression> mixed = { Expression(2.0), Expression(3.0), I, Expression(4.0) };
+	REQUIRE(padd(mixed) == Expression(std::complex<double>(9.0, 1.0)));
+	REQUIRE(pmul(mixed) == Expression(std::complex<double>(0.0, 24.0)));
+
+	INFO("a sum with no imaginary part is a number, a product with a complex argument is not")
+	std::vector<Expression> cancel = { Expression(1.0), I, minusI };
+	REQUIRE(padd(cancel).isHeadNumber());
+	REQUIRE(pmul(cancel).isHeadComplex());
+	REQUIRE(pmul(cancel) == Expression(std::complex<double>(1.0, 0.0)));
+
+	INFO("an invalid argument after numbers")
+	std::vector<Expression> invalid = { Expression(1.0), Expression(Atom("hi")) };
+	REQUIRE_THROWS_AS(padd(invalid), SemanticError);
+	REQUIRE_THROWS_AS(pmul(invalid), SemanticError);
+	REQUIRE_THROWS_AS(pdiv(invalid), SemanticError);
+}
+
 TEST_CASE("Test sqrt procedure", "[environment]") {
 	Environment env;
 	Procedure psqrt = env.get_proc(Atom("sqrt"));
@@ -1,36 +1,187 @@
 #include "expression.hpp"
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <sstream>
 #include <list>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 #include "environment.hpp"
+#include "extension.hpp"
+#include "memo.hpp"
+#include "memstats.hpp"
+#include "profile.hpp"
+#include "sampler.hpp"
+#include "scratch.hpp"
 #include "semantic_error.hpp"
+#include "trace.hpp"
 
 sig_atomic_t global_status_flag = 0;
 
-Expression::Expression(){}
+// the interned property names, the graphics keys first so their ids are
+// the constants in expression.hpp
+class PropertyKeyTable {
+public:
+
+  PropertyKeyTable(){
+    for(auto name : {"\"object-name\"", "\"size\"", "\"thickness\"", "\"position\"",
+	  "\"text-scale\"", "\"text-rotation\""}){
+      intern(name);
+    }
+  }
+
+  PropertyKey intern(const std::string & name){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(name);
+    if(it != ids.end()) return it->second;
+
+    PropertyKey key = static_cast<PropertyKey>(names.size());
+    names.push_back(name);
+    ids.emplace(name, key);
+    return key;
+  }
+
+  // names are never removed, and a deque does not move them when growing
+  const std::string & name(PropertyKey key){
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.at(key);
+  }
+
+private:
+  std::mutex mutex;
+  std::deque<std::string> names;
+  std::unordered_map<std::string, PropertyKey> ids;
+};
+
+PropertyKeyTable & propertyKeys(){
+  static PropertyKeyTable table;
+  return table;
+}
+
+PropertyKey internPropertyKey(const std::string & name){
+  return propertyKeys().intern(name);
+}
+
+const std::string & propertyKeyName(PropertyKey key){
+  return propertyKeys().name(key);
+}
+
+// the object-name values of the graphics primitives
+const Atom POINT_NAME("\"point\"");
+const Atom LINE_NAME("\"line\"");
+const Atom TEXT_NAME("\"text\"");
+
+enum GraphicKind : uint8_t { NoGraphic, PointGraphic, LineGraphic, TextGraphic };
+
+// the graphics properties held as plain values
+struct Graphic {
+  GraphicKind kind; // from the object-name property
+  uint8_t fields; // bit (1 << key) is set if the field for key holds its property
+  double size;
+  double thickness;
+  double x, y; // the position of a text
+  double scale;
+  double rotation;
+};
+
+// the other properties, their storage counted in PropertyBytes
+typedef std::vector<Expression::Property,
+		    CountedAllocator<Expression::Property, PropertyBytes>> PropertyList;
+
+struct Expression::PropertyBlock {
+  PropertyBlock(){ countMemory(PropertyBytes, sizeof(PropertyBlock)); }
+  ~PropertyBlock(){ countMemory(PropertyBytes, -static_cast<std::int64_t>(sizeof(PropertyBlock))); }
+
+  Graphic graphic = {NoGraphic, 0, 0, 0, 0, 0, 0, 0};
+  PropertyList others;
+};
+
+// return the field holding the numeric graphics property key, or nullptr
+double * numericField(Graphic & g, PropertyKey key){
+  switch(key){
+  case SIZE_KEY: return &g.size;
+  case THICKNESS_KEY: return &g.thickness;
+  case TEXT_SCALE_KEY: return &g.scale;
+  case TEXT_ROTATION_KEY: return &g.rotation;
+  default: return nullptr;
+  }
+}
+
+double numericValue(const Graphic & g, PropertyKey key){
+  return *numericField(const_cast<Graphic &>(g), key);
+}
+
+uint8_t fieldBit(PropertyKey key){
+  return (key <= TEXT_ROTATION_KEY) ? static_cast<uint8_t>(1u << key) : 0;
+}
+
+Expression::Expression(){
+  countMemory(LiveExpressions, 1);
+}
 
 Expression::Expression(const Atom & a){
+  countMemory(LiveExpressions, 1);
   m_head = a;
 }
 
-// recursive copy
-Expression::Expression(const Expression & a){
-  m_head = a.m_head;
-  propertymap = a.propertymap;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
+// iterative deep copy, so the depth of the copied tree is not limited by
+// the native stack
+Expression::Expression(const Expression & a): m_head(a.m_head){
+  countMemory(LiveExpressions, 1);
+
+  if(a.m_tail.empty() && !a.m_properties){
+    return;
   }
+
+  // (source, destination) pairs still to be copied, each destination
+  // already has its head set
+  std::vector<std::pair<const Expression *, Expression *>> pending = {{&a, this}};
+  while(!pending.empty()){
+    const Expression & from = *pending.back().first;
+    Expression & to = *pending.back().second;
+    pending.pop_back();
+
+    to.m_tail.resize(from.m_tail.size());
+    for(std::size_t i = 0; i < from.m_tail.size(); ++i){
+      to.m_tail[i].m_head = from.m_tail[i].m_head;
+      pending.emplace_back(&from.m_tail[i], &to.m_tail[i]);
+    }
+    if(from.m_properties){
+      to.m_properties.reset(new PropertyBlock());
+      to.m_properties->graphic = from.m_properties->graphic;
+
+      // reserved, so the destinations do not move
+      PropertyList & others = to.m_properties->others;
+      others.reserve(from.m_properties->others.size());
+      for(auto & p : from.m_properties->others){
+	others.emplace_back(p.first, Expression(p.second.m_head));
+	pending.emplace_back(&p.second, &others.back().second);
+      }
+    }
+  }
+}
+
+Expression::Expression(Expression && a) noexcept:
+  m_head(std::move(a.m_head)), m_tail(std::move(a.m_tail)), m_properties(std::move(a.m_properties)){
+  countMemory(LiveExpressions, 1);
+  a.m_tail.clear();
 }
 
 // List Constructor for Expression Object
 Expression::Expression(const std::vector<Expression> & list) {
+	countMemory(LiveExpressions, 1);
 	m_head.setList();
-	m_tail = list;
+	m_tail.assign(list.begin(), list.end());
 }
 
 // Lambda Constructor for Expression object
 Expression::Expression(const std::vector<Expression> & args, const Atom & a) {
+	countMemory(LiveExpressions, 1);
 	m_head = a;
 	for (auto e : args) {
 		m_tail.push_back(e);
@@ -41,19 +192,91 @@ Expression::Expression(const std::vector<Expression> & args, const Atom & a) {
 // Assignment operator for Expression
 Expression & Expression::operator=(const Expression & a){
 
-  // prevent self-assignment
+  // prevent self-assignment, a may also be part of this tree
   if(this != &a){
-    m_head = a.m_head;
-    propertymap = a.propertymap;
-    m_tail.clear();
-    for(auto e : a.m_tail){
-      m_tail.push_back(e);
-    } 
+    Expression copy(a);
+    *this = std::move(copy);
   }
   
   return *this;
 }
 
+Expression & Expression::operator=(Expression && a) noexcept{
+
+  if(this != &a){
+    // the previous contents are destroyed with a
+    std::swap(m_head, a.m_head);
+    m_tail.swap(a.m_tail);
+    m_properties.swap(a.m_properties);
+  }
+
+  return *this;
+}
+
+// iterative destruction, so the depth of the destroyed tree is not limited
+// by the native stack
+Expression::~Expression(){
+  countMemory(LiveExpressions, -1);
+
+  // with no grandchildren the implicit destruction only recurses once
+  bool shallow = !m_properties || m_properties->others.empty();
+  for(auto it = m_tail.begin(); shallow && (it != m_tail.end()); ++it){
+    shallow = !it->isNested();
+  }
+  if(shallow){
+    return;
+  }
+
+  std::vector<Expression> pending = acquireScratch();
+  release(pending);
+  while(!pending.empty()){
+    Expression e(std::move(pending.back()));
+    pending.pop_back();
+    e.release(pending);
+  }
+  recycleScratch(pending);
+}
+
+void Expression::release(std::vector<Expression> & pending) noexcept{
+  for(auto & e : m_tail){
+    if(e.isNested()){
+      pending.push_back(std::move(e));
+    }
+  }
+  m_tail.clear();
+  if(m_properties){
+    for(auto & p : m_properties->others){
+      pending.push_back(std::move(p.second));
+    }
+    m_properties.reset();
+  }
+}
+
+std::size_t Expression::retainedBytes() const{
+  std::size_t bytes = sizeof(Expression);
+
+  std::vector<const Expression *> pending = {this};
+  while(!pending.empty()){
+    const Expression & e = *pending.back();
+    pending.pop_back();
+
+    bytes += e.m_head.heapBytes() + e.m_tail.capacity()*sizeof(Expression);
+    for(auto & t : e.m_tail){
+      pending.push_back(&t);
+    }
+    if(e.m_properties){
+      bytes += sizeof(PropertyBlock) + e.m_properties->others.capacity()*sizeof(Property);
+      for(auto & p : e.m_properties->others){
+	pending.push_back(&p.second);
+      }
+    }
+  }
+  return bytes;
+}
+
+bool Expression::isNested() const noexcept{
+  return !m_tail.empty() || (m_properties && !m_properties->others.empty());
+}
 
 Atom & Expression::head(){
   return m_head;
@@ -63,10 +286,6 @@ const Atom & Expression::head() const{
   return m_head;
 }
 
-bool Expression::isHeadNumber() const noexcept{
-  return m_head.isNumber();
-}
-
 bool Expression::isHeadSymbol() const noexcept{
   return m_head.isSymbol();
 }  
@@ -88,6 +307,10 @@ void Expression::append(const Atom & a){
   m_tail.emplace_back(a);
 }
 
+void Expression::append(Expression && e){
+  m_tail.push_back(std::move(e));
+}
+
 
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
@@ -107,305 +330,235 @@ Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
   return m_tail.cend();
 }
 
-// Apply function used for simple and lambda kind which calls eval on the expression
-Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env){
-  // need to create a new environment to use for the 1st one
-	if (env.is_exp(op)) {
-		args[0].head();
-		uint64_t index = 0;
-		Environment newEnv = env;
-		Expression newExp = newEnv.get_exp(op);
-		Expression newArgs = *newExp.tailConstBegin();
-		std::vector<Expression> vec = {  };
-		for (auto f = (newArgs.tailConstBegin()); f != newArgs.tailConstEnd(); f++) {
-			index++;
-		}
-		if (args.size() != index) {
-			throw SemanticError("Error: during apply : Error in call to procedure : invalid number of arguments.");
-		}
-		index = 0;
-		for (auto e = (newArgs.tailConstBegin()); e != newArgs.tailConstEnd(); e++) {
-			std::string str = (*e).head().asSymbol();
-			newEnv.findProc(str, newEnv);
-			newEnv.add_exp(Atom(str), args[index]);
-			index++;
-		}
-		return (newExp.tail()->eval(newEnv));
-	}
-  // head must be a symbol
-  if(!op.isSymbol()){
-    throw SemanticError("Error during evaluation: procedure name not symbol");
-  }
-  
-  // must map to a proc
-  if(!env.is_proc(op)){
-    throw SemanticError("Error during evaluation: symbol does not name a procedure");
-  }
-
-  // map from symbol to proc
-  Procedure proc = env.get_proc(op);
-  
-  // call proc with args
-  return proc(args);
+Expression::IteratorType Expression::tailBegin() noexcept{
+  return m_tail.begin();
 }
 
-// Adds apply functionality for a list 
-Expression Expression::handle_apply(Environment & env) {
-	// tail must have size 2 or error
-	if (m_tail.size() != 2) {
-		throw SemanticError("Error during evaluation: invalid number of arguments to apply");
-	}
-	std::vector<Expression> vec = {};
-	Expression exp = m_tail[1].eval(env);
-
-	if (!exp.isHeadList()) {
-		throw SemanticError("Error during evaluation: second argument must be a list");
-	}
-	if (env.is_exp(m_tail[0].head())) {
-		for (auto e = (exp.tailConstBegin()); e != exp.tailConstEnd(); e++) {
-			vec.push_back(*e);
-		}
-		return apply(m_tail[0].head(), vec, env);
-	}
-	int index = 0;
-	for (auto e = (m_tail[0].tailConstBegin()); e != m_tail[0].tailConstEnd(); e++) {
-		index++;
-	}
-	if (!env.is_proc(m_tail[0].head()) || index != 0) {
+Expression::IteratorType Expression::tailEnd() noexcept{
+  return m_tail.end();
+}
 
-		throw SemanticError("Error during evaluation: first argument must be a procedure");
-	}
-	for (auto e = (exp.tailConstBegin()); e != exp.tailConstEnd(); e++) {
-		vec.push_back(*e);
-	}
-	return apply(m_tail[0].head(), vec, env);
-	
+void Expression::setProperty(const std::string & key, Expression value){
+  setProperty(internPropertyKey(key), std::move(value));
 }
 
-// Adds a property functionality
-Expression Expression::set_property(Environment & env){
-// tail[0] must be string
-  std::string key = m_tail[0].head().asString();
-  Expression value = m_tail[1].eval(env);
-  Expression exp = m_tail[2].eval(env);
-  if(!m_tail[0].isHeadString()){
-    throw SemanticError("Error during evaluation: first argument to property not a string");
+void Expression::setProperty(PropertyKey key, Expression value){
+  if(!m_properties){
+    m_properties.reset(new PropertyBlock());
   }
-  if(m_tail.size() != 3){
-    throw SemanticError("Error during evaluation: invalid number of arguments to property");
+  Graphic & g = m_properties->graphic;
+  PropertyList & others = m_properties->others;
+
+  // true if e is a leaf without properties
+  auto plain = [](const Expression & e){
+    return e.m_tail.empty() && !e.m_properties;
+  };
+  bool field = false;
+
+  g.fields &= ~fieldBit(key);
+  if(key == OBJECT_NAME_KEY){
+    g.kind = NoGraphic;
+    if(plain(value) && (value.m_head == POINT_NAME)) g.kind = PointGraphic;
+    else if(plain(value) && (value.m_head == LINE_NAME)) g.kind = LineGraphic;
+    else if(plain(value) && (value.m_head == TEXT_NAME)) g.kind = TextGraphic;
+    field = (g.kind != NoGraphic);
+  }
+  else if(key == POSITION_KEY){
+    // a point as made by makePoint
+    const PropertyBlock * p = value.m_properties.get();
+    field = (p != nullptr) && (p->graphic.kind == PointGraphic) &&
+      (p->graphic.fields == (fieldBit(OBJECT_NAME_KEY) | fieldBit(SIZE_KEY))) && (p->graphic.size == 0) &&
+      p->others.empty() && value.m_head.isList() && (value.m_tail.size() == 2) &&
+      plain(value.m_tail[0]) && value.m_tail[0].isHeadNumber() &&
+      plain(value.m_tail[1]) && value.m_tail[1].isHeadNumber();
+    if(field){
+      g.x = value.m_tail[0].m_head.asNumber();
+      g.y = value.m_tail[1].m_head.asNumber();
+    }
+  }
+  else if(double * number = numericField(g, key)){
+    field = plain(value) && value.m_head.isNumber();
+    if(field){
+      *number = value.m_head.asNumber();
+    }
   }
-  //m_tail[2].eval(env).propertymap[m_tail[0].head().asString()] = m_tail[1].eval(env);
-  exp.propertymap[key] = value;
-  return exp;
-  //return m_tail[2].eval(env);
-}
 
-// Adds a property functionality
-Expression Expression::get_property(Environment & env){
-  std::string key = m_tail[0].head().asString();
-  Expression exp = m_tail[1].eval(env);
-  if(!m_tail[0].isHeadString()){
-    throw SemanticError("Error during evaluation: first argument to property not a string");
+  if(field){
+    g.fields |= fieldBit(key);
+    for(auto it = others.begin(); it != others.end(); ++it){
+      if(it->first == key){
+	others.erase(it);
+	break;
+      }
+    }
+    return;
   }
-  if(m_tail.size() != 2){
-    throw SemanticError("Error during evaluation: invalid number of arguments to property");
+
+  for(auto & p : others){
+    if(p.first == key){
+      p.second = std::move(value);
+      return;
+    }
   }
-  return exp.propertymap[key];
-  // if(m_tail[0] == Expression()){
-  //   return Expression(none);
-  // }
+  others.emplace_back(key, std::move(value));
 }
 
-// Adds a discrete plot function
-Expression Expression::discrete_plot(Environment & env){
-  Expression data = m_tail[0].eval(env);
-  Expression options = m_tail[1].eval(env);
-
-  if(!data.isHeadList() || !options.isHeadList()){
-    throw SemanticError("Error during evaluation: first or second argument ");
+Expression Expression::getProperty(PropertyKey key) const{
+  if(!m_properties){
+    return Expression();
   }
+  const Graphic & g = m_properties->graphic;
 
-  double xMin = 10000;
-  double xMax = -10000;
-  double yMin = 10000;
-  double yMax = -10000;
+  if((key == OBJECT_NAME_KEY) && (g.kind != NoGraphic)){
+    return Expression((g.kind == PointGraphic) ? POINT_NAME :
+		      (g.kind == LineGraphic) ? LINE_NAME : TEXT_NAME);
+  }
+  if(g.fields & fieldBit(key)){
+    if(key == POSITION_KEY){
+      return makePoint(g.x, g.y);
+    }
+    return Expression(numericValue(g, key));
+  }
+  for(auto & p : m_properties->others){
+    if(p.first == key) return p.second;
+  }
+  return Expression();
+}
 
-  for(auto e = (data.tailConstBegin()); e != data.tailConstEnd(); e++){
-    std::vector<Expression> tail = (*e).makeTail();
-    xMin = std::min(tail[0].head().asNumber(),xMin);
-    xMax = std::max(tail[0].head().asNumber(),xMax);
-    yMin = std::min(tail[1].head().asNumber(),yMin);
-    yMax = std::max(tail[1].head().asNumber(),yMax);
+std::vector<Expression::Property> Expression::properties() const{
+  std::vector<Property> result;
+  if(!m_properties){
+    return result;
   }
 
-  double xScale = N/(xMax-xMin);
-  double yScale = N/(yMax-yMin);
+  const Graphic & g = m_properties->graphic;
+  for(PropertyKey key = OBJECT_NAME_KEY; key <= TEXT_ROTATION_KEY; ++key){
+    if((key == OBJECT_NAME_KEY) ? (g.kind != NoGraphic) : (g.fields & fieldBit(key))){
+      result.emplace_back(key, getProperty(key));
+    }
+  }
+  result.insert(result.end(), m_properties->others.begin(), m_properties->others.end());
+  return result;
+}
 
-  double scaledXMin = xMin*xScale;
-  double scaledXMax = xMax*xScale;
-  double scaledYMin = yMin*yScale;
-  scaledYMin*=-1;
-  double scaledYMax = yMax*yScale;
-  scaledYMax*=-1;
-  //double scaledXMid = (scaledXMax+scaledXMin)/2;
-  //double scaledYMid = (scaledYMax+scaledYMin)/2;
+Expression makePoint(double x, double y){
+  return makePoint(Expression(x), Expression(y));
+}
 
-  double pointx = 0;
-  double pointy = 0;
+Expression makePoint(const Expression & x, const Expression & y){
+  Expression point(std::vector<Expression>{x, y});
+  point.setProperty(OBJECT_NAME_KEY, Expression(POINT_NAME));
+  point.setProperty(SIZE_KEY, Expression(0.));
+  return point;
+}
 
-  std::vector<Expression> list = {};
-  std::vector<Expression> finalList = {};
+Expression makeLine(const Expression & from, const Expression & to){
+  Expression line(std::vector<Expression>{from, to});
+  line.setProperty(OBJECT_NAME_KEY, Expression(LINE_NAME));
+  line.setProperty(THICKNESS_KEY, Expression(1.));
+  return line;
+}
 
-  Atom headPoint = Atom("make-point");
-  Atom headLine = Atom("make-line");
+Expression makeText(const Expression & text){
+  Expression result(text);
+  result.setProperty(OBJECT_NAME_KEY, Expression(TEXT_NAME));
+  result.setProperty(POSITION_KEY, makePoint(0, 0));
+  result.setProperty(TEXT_SCALE_KEY, Expression(1.));
+  result.setProperty(TEXT_ROTATION_KEY, Expression(0.));
+  return result;
+}
 
-  // std::cout << "XMax: " << xMax << std::endl;
-  // std::cout << "XMin: " << xMin << std::endl;
-  // std::cout << "YMax: " << yMax << std::endl;
-  // std::cout << "YMin: " << yMin << std::endl;
-  
+// Append the frame of a plot to out: the axes through the origin when they
+// are in view, the four edges, the bound labels and the option values.
+void plotFrame(double xMin, double xMax, double yMin, double yMax, double xScale,
+	       double yScale, const Expression & options, std::vector<Expression> & out){
 
-  for(auto &newExp : data.m_tail){
-    pointx = newExp.m_tail[0].head().asNumber();
-    pointy = newExp.m_tail[1].head().asNumber();
-    pointx = pointx * xScale;
-    pointy = pointy * yScale;
-    pointy *= -1;
-    list.emplace_back(Expression(pointx));
-    list.emplace_back(Expression(pointy));
-    Expression newPoint = Expression(list,headPoint);
-    list.clear();
-    list.emplace_back(Expression(pointx));
-    if(yMin > 0){
-      list.emplace_back(Expression(-1*yMax));
-    }
-    else{
-      list.emplace_back(Expression(0));
-    }
-    Expression newIntercept = Expression(list,headPoint);
-    list.clear();
-    list.emplace_back(newPoint);
-    list.emplace_back(newIntercept);
-    Expression newStem = Expression(list,headLine);
-    list.clear();
-    finalList.emplace_back(newPoint.eval(env));
-    finalList.emplace_back(newStem.eval(env));
-  }
+  double scaledXMin = xMin*xScale;
+  double scaledXMax = xMax*xScale;
+  double scaledYMin = -(yMin*yScale);
+  double scaledYMax = -(yMax*yScale);
 
   //Middle Vertical Line
-  list.clear();
   if(0 > scaledXMin && 0 < scaledXMax){
-  Expression topMidXPoint = Expression(0);
-  Expression topMidYPoint = Expression(scaledYMin);
-  list.emplace_back(topMidXPoint);
-  list.emplace_back(topMidYPoint);
-  Expression tempTopMid = Expression(list, headPoint);
-  list.clear();
-  Expression bottomMidXPoint = Expression(0);
-  Expression bottomMidYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomMidXPoint);
-  list.emplace_back(bottomMidYPoint);
-  Expression tempBottomMid = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempTopMid);
-  list.emplace_back(tempBottomMid);
-  Expression tempMidVerticalLine = Expression(list, headLine);
-  Expression midVerticalLine = tempMidVerticalLine.eval(env);
-  finalList.emplace_back(midVerticalLine);
+    out.emplace_back(makeLine(makePoint(0, scaledYMin), makePoint(0, scaledYMax)));
   }
 
   //Middle Horizontal Line
-  list.clear();
   if(0 < scaledYMin && 0 > scaledYMax){
-  Expression leftMidXPoint = Expression(scaledXMin);
-  Expression leftMidYPoint = Expression(0);
-  list.emplace_back(leftMidXPoint);
-  list.emplace_back(leftMidYPoint);
-  Expression tempLeftMid = Expression(list, headPoint);
-  list.clear();
-  Expression rightMidXPoint = Expression(scaledXMax);
-  Expression rightMidYPoint = Expression(0);
-  list.emplace_back(rightMidXPoint);
-  list.emplace_back(rightMidYPoint);
-  Expression tempRightMid = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempLeftMid);
-  list.emplace_back(tempRightMid);
-  Expression tempMidHorizontalLine = Expression(list, headLine);
-  Expression midHorizontalLine = tempMidHorizontalLine.eval(env);
-  finalList.emplace_back(midHorizontalLine);
+    out.emplace_back(makeLine(makePoint(scaledXMin, 0), makePoint(scaledXMax, 0)));
   }
 
+  Expression bottomLeft = makePoint(scaledXMin, scaledYMax);
+  Expression bottomRight = makePoint(scaledXMax, scaledYMax);
+  Expression topLeft = makePoint(scaledXMin, scaledYMin);
+  Expression topRight = makePoint(scaledXMax, scaledYMin);
+
   //Bottom Horizontal Line
-  list.clear();
-  Expression bottomRightXPoint = Expression(scaledXMax);
-  Expression bottomRightYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomRightXPoint);
-  list.emplace_back(bottomRightYPoint);
-  Expression tempBottomRight = Expression(list, headPoint);
-  list.clear();
-  Expression bottomLeftXPoint = Expression(scaledXMin);
-  Expression bottomLeftYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomLeftXPoint);
-  list.emplace_back(bottomLeftYPoint);
-  Expression tempBottomLeft = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempBottomLeft);
-  list.emplace_back(tempBottomRight);
-  Expression tempBottomHorizontalLine = Expression(list, headLine);
-  Expression bottomHorizontalLine = tempBottomHorizontalLine.eval(env);
-  finalList.emplace_back(bottomHorizontalLine);
+  out.emplace_back(makeLine(bottomLeft, bottomRight));
 
-//Top Vertical Line
-  list.clear();
-  Expression topLeftXPoint = Expression(scaledXMin);
-  Expression topLeftYPoint = Expression(scaledYMin);
-  list.emplace_back(topLeftXPoint);
-  list.emplace_back(topLeftYPoint);
-  Expression tempTopLeft = Expression(list, headPoint);
-  list.clear();
-  Expression topRightXPoint = Expression(scaledXMax);
-  Expression topRightYPoint = Expression(scaledYMin);
-  list.emplace_back(topRightXPoint);
-  list.emplace_back(topRightYPoint);
-  Expression tempTopRight = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempTopLeft);
-  list.emplace_back(tempTopRight);
-  Expression tempTopHorizontalLine = Expression(list, headLine);
-  Expression topHorizontalLine = tempTopHorizontalLine.eval(env);
-  finalList.emplace_back(topHorizontalLine);
+  //Top Vertical Line
+  out.emplace_back(makeLine(topLeft, topRight));
 
   //Left Vertical Line
-  list.clear();
-  list.emplace_back(tempBottomLeft);
-  list.emplace_back(tempTopLeft);
-  Expression tempLeftVerticalLine = Expression(list, headLine);
-  Expression leftVerticalLine = tempLeftVerticalLine.eval(env);
-  finalList.emplace_back(leftVerticalLine);
+  out.emplace_back(makeLine(bottomLeft, topLeft));
 
   //Right Vertical Line
-  list.clear();
-  list.emplace_back(tempBottomRight);
-  list.emplace_back(tempTopRight);
-  Expression tempRightVerticalLine = Expression(list, headLine);
-  Expression rightVerticalLine = tempRightVerticalLine.eval(env);
-  finalList.emplace_back(rightVerticalLine);
+  out.emplace_back(makeLine(bottomRight, topRight));
 
   std::string stringXMin = "\"" + Atom(xMin).asString() + "\"";
   std::string stringXMax = "\"" + Atom(xMax).asString() + "\"";
   std::string stringYMin = "\"" + Atom(yMin).asString() + "\"";
   std::string stringYMax = "\"" + Atom(yMax).asString() + "\"";
 
-  finalList.emplace_back(Expression(Atom(stringXMin)));
-  finalList.emplace_back(Expression(Atom(stringXMax)));
-  finalList.emplace_back(Expression(Atom(stringYMin)));
-  finalList.emplace_back(Expression(Atom(stringYMax)));
+  out.emplace_back(Expression(Atom(stringXMin)));
+  out.emplace_back(Expression(Atom(stringXMax)));
+  out.emplace_back(Expression(Atom(stringYMin)));
+  out.emplace_back(Expression(Atom(stringYMax)));
 
   for(auto g = (options.tailConstBegin()); g != options.tailConstEnd(); g++){
-    finalList.emplace_back((*g).m_tail[1]);
+    out.emplace_back(*((*g).tailConstBegin() + 1));
+  }
+}
+
+// Adds a discrete plot function
+Expression Expression::discrete_plot(Environment & env) const{
+  TraceSpan span("discrete-plot", "plot");
+  Expression data = m_tail[0].eval(env);
+  Expression options = m_tail[1].eval(env);
+
+  if(!data.isHeadList() || !options.isHeadList()){
+    throw SemanticError("Error during evaluation: first or second argument ");
+  }
+
+  double xMin = 10000;
+  double xMax = -10000;
+  double yMin = 10000;
+  double yMax = -10000;
+
+  for(auto & p : data.m_tail){
+    xMin = std::min(p.m_tail[0].head().asNumber(),xMin);
+    xMax = std::max(p.m_tail[0].head().asNumber(),xMax);
+    yMin = std::min(p.m_tail[1].head().asNumber(),yMin);
+    yMax = std::max(p.m_tail[1].head().asNumber(),yMax);
+  }
+
+  double xScale = N/(xMax-xMin);
+  double yScale = N/(yMax-yMin);
+
+  std::vector<Expression> finalList = {};
+
+  // each data point, with a stem to the axis
+  for(auto & p : data.m_tail){
+    double pointx = p.m_tail[0].head().asNumber() * xScale;
+    double pointy = -(p.m_tail[1].head().asNumber() * yScale);
+    Expression point = makePoint(pointx, pointy);
+    Expression intercept = makePoint(pointx, (yMin > 0) ? -1*yMax : 0);
+    finalList.emplace_back(point);
+    finalList.emplace_back(makeLine(point, intercept));
   }
 
+  plotFrame(xMin, xMax, yMin, yMax, xScale, yScale, options, finalList);
+
   /*Expression finallist = Expression(finalList);
   finallist.head().setDiscretePlot();
   return finallist;*/
@@ -413,7 +566,8 @@ Expression Expression::discrete_plot(Environment & env){
 }
 
 // Adds a continuous plot function
-Expression Expression::continuous_plot(Environment & env){
+Expression Expression::continuous_plot(Environment & env) const{
+  TraceSpan span("continuous-plot", "plot");
   Expression func = m_tail[0].eval(env);
   Expression bounds = m_tail[1].eval(env);
   Expression options;
@@ -438,250 +592,44 @@ Expression Expression::continuous_plot(Environment & env){
   double yMin = yBounds.m_tail[0].head().asNumber();
   double yMax = yBounds.m_tail[1].head().asNumber();
 
-  // std::cout << "XMin: " << xMin << std::endl;
-  // std::cout << "XMax: " << xMax << std::endl;
-  // std::cout << "yMin: " << yMin << std::endl;
-  // std::cout << "yMax: " << yMax << std::endl;
-
   double xScale = N/(xMax-xMin);
   double yScale = N/(yMax-yMin);
 
-  double scaledXMin = xMin*xScale;
-  double scaledXMax = xMax*xScale;
-  double scaledYMin = yMin*yScale;
-  scaledYMin*=-1;
-  double scaledYMax = yMax*yScale;
-  scaledYMax*=-1;
-  //double scaledXMid = (scaledXMax+scaledXMin)/2;
-  //double scaledYMid = (scaledYMax+scaledYMin)/2;
-
   std::vector<Expression> finalList = {};
   std::vector<Expression> XVector = {};
 
-  Atom headPoint = Atom("make-point");
-  Atom headLine = Atom("make-line");
-
   double stepSize = (xMax-xMin)/50;
 
   for(double i = xMin; i <= xMax+stepSize; i+=stepSize){
     XVector.emplace_back(Expression(i));
   }
-  list.clear();
   list.emplace_back(m_tail[0]);
   list.emplace_back(Expression(XVector,Atom("list")));
   Expression yVals = Expression(list,Atom("map")).eval(env);
   list.clear();
-  Expression xVals = Expression(XVector,Atom("list")).eval(env);
-
-  double pointx = 0;
-  double pointy = 0;
-  double prevPointx = 0;
-  double prevPointy = 0;
-  int count = 1;
-
-  // int XCount = 0;
-  // for(auto s = (xVals.tailConstBegin()); s != xVals.tailConstEnd(); s++){
-  //   std::cout << "XVals: " << (*s).head().asNumber() << std::endl;
-  //   XCount++;
-  // }
-
-  // int YCount = 0;
-  // for(auto t = (yVals.tailConstBegin()); t != yVals.tailConstEnd(); t++){
-  //   std::cout << "YVals: " << (*t).head().asNumber() << std::endl;
-  //   YCount++;
-  // }
-  // std::cout << "XCount: " << XCount << std::endl;
-  // std::cout << "YCount: " << YCount << std::endl;
-
-
-  for(auto _ : yVals.m_tail){
-    list.clear();
-    pointx = xVals.m_tail[count].head().asNumber();
-    pointy = yVals.m_tail[count].head().asNumber();
-    //std::cout << "Current (X,Y): " << "(" << pointx << "," << pointy << ")" << std::endl;
-    prevPointx = xVals.m_tail[count-1].head().asNumber();
-    prevPointy = yVals.m_tail[count-1].head().asNumber();
-    //std::cout << "Previous (X,Y): " << "(" << prevPointx << "," << prevPointy << ")" << std::endl;
-    //std::cout << "Count: " << count << std::endl;
-    list.emplace_back(Expression(prevPointx*xScale));
-    list.emplace_back(Expression(prevPointy*yScale*-1));
-    Expression prevPoint = Expression(list,headPoint);
-    list.clear();
-    list.emplace_back(Expression(pointx*xScale));
-    list.emplace_back(Expression(pointy*yScale*-1));
-    Expression newPoint = Expression(list,headPoint);
-    list.clear();
-    list.emplace_back(prevPoint);
-    list.emplace_back(newPoint);
-    Expression newLine = Expression(list,headLine);
-    list.clear();
-    // finalList.emplace_back(newPoint.eval(env));
-    finalList.emplace_back(newLine.eval(env));
+
+  // one segment between each pair of consecutive samples
+  std::size_t count = 1;
+  for(std::size_t n = 0; n < yVals.m_tail.size(); ++n){
+    double pointx = XVector[count].head().asNumber();
+    double pointy = yVals.m_tail[count].head().asNumber();
+    double prevPointx = XVector[count-1].head().asNumber();
+    double prevPointy = yVals.m_tail[count-1].head().asNumber();
+    finalList.emplace_back(makeLine(makePoint(prevPointx*xScale, prevPointy*yScale*-1),
+				    makePoint(pointx*xScale, pointy*yScale*-1)));
     if(count < 50){
       count++;
     }
   }
 
-  //Middle Vertical Line
-  list.clear();
-  if(0 > scaledXMin && 0 < scaledXMax){
-  Expression topMidXPoint = Expression(0);
-  Expression topMidYPoint = Expression(scaledYMin);
-  list.emplace_back(topMidXPoint);
-  list.emplace_back(topMidYPoint);
-  Expression tempTopMid = Expression(list, headPoint);
-  list.clear();
-  Expression bottomMidXPoint = Expression(0);
-  Expression bottomMidYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomMidXPoint);
-  list.emplace_back(bottomMidYPoint);
-  Expression tempBottomMid = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempTopMid);
-  list.emplace_back(tempBottomMid);
-  Expression tempMidVerticalLine = Expression(list, headLine);
-  Expression midVerticalLine = tempMidVerticalLine.eval(env);
-  finalList.emplace_back(midVerticalLine);
-  }
-
-  //Middle Horizontal Line
-  list.clear();
-  if(0 < scaledYMin && 0 > scaledYMax){
-  Expression leftMidXPoint = Expression(scaledXMin);
-  Expression leftMidYPoint = Expression(0);
-  list.emplace_back(leftMidXPoint);
-  list.emplace_back(leftMidYPoint);
-  Expression tempLeftMid = Expression(list, headPoint);
-  list.clear();
-  Expression rightMidXPoint = Expression(scaledXMax);
-  Expression rightMidYPoint = Expression(0);
-  list.emplace_back(rightMidXPoint);
-  list.emplace_back(rightMidYPoint);
-  Expression tempRightMid = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempLeftMid);
-  list.emplace_back(tempRightMid);
-  Expression tempMidHorizontalLine = Expression(list, headLine);
-  Expression midHorizontalLine = tempMidHorizontalLine.eval(env);
-  finalList.emplace_back(midHorizontalLine);
-  }
-
-  //Bottom Horizontal Line
-  list.clear();
-  Expression bottomRightXPoint = Expression(scaledXMax);
-  Expression bottomRightYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomRightXPoint);
-  list.emplace_back(bottomRightYPoint);
-  Expression tempBottomRight = Expression(list, headPoint);
-  list.clear();
-  Expression bottomLeftXPoint = Expression(scaledXMin);
-  Expression bottomLeftYPoint = Expression(scaledYMax);
-  list.emplace_back(bottomLeftXPoint);
-  list.emplace_back(bottomLeftYPoint);
-  Expression tempBottomLeft = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempBottomLeft);
-  list.emplace_back(tempBottomRight);
-  Expression tempBottomHorizontalLine = Expression(list, headLine);
-  Expression bottomHorizontalLine = tempBottomHorizontalLine.eval(env);
-  finalList.emplace_back(bottomHorizontalLine);
-
-//Top Vertical Line
-  list.clear();
-  Expression topLeftXPoint = Expression(scaledXMin);
-  Expression topLeftYPoint = Expression(scaledYMin);
-  list.emplace_back(topLeftXPoint);
-  list.emplace_back(topLeftYPoint);
-  Expression tempTopLeft = Expression(list, headPoint);
-  list.clear();
-  Expression topRightXPoint = Expression(scaledXMax);
-  Expression topRightYPoint = Expression(scaledYMin);
-  list.emplace_back(topRightXPoint);
-  list.emplace_back(topRightYPoint);
-  Expression tempTopRight = Expression(list, headPoint);
-  list.clear();
-  list.emplace_back(tempTopLeft);
-  list.emplace_back(tempTopRight);
-  Expression tempTopHorizontalLine = Expression(list, headLine);
-  Expression topHorizontalLine = tempTopHorizontalLine.eval(env);
-  finalList.emplace_back(topHorizontalLine);
-
-  //Left Vertical Line
-  list.clear();
-  list.emplace_back(tempBottomLeft);
-  list.emplace_back(tempTopLeft);
-  Expression tempLeftVerticalLine = Expression(list, headLine);
-  Expression leftVerticalLine = tempLeftVerticalLine.eval(env);
-  finalList.emplace_back(leftVerticalLine);
-
-  //Right Vertical Line
-  list.clear();
-  list.emplace_back(tempBottomRight);
-  list.emplace_back(tempTopRight);
-  Expression tempRightVerticalLine = Expression(list, headLine);
-  Expression rightVerticalLine = tempRightVerticalLine.eval(env);
-  finalList.emplace_back(rightVerticalLine);
-
-  std::string stringXMin = "\"" + Atom(xMin).asString() + "\"";
-  std::string stringXMax = "\"" + Atom(xMax).asString() + "\"";
-  std::string stringYMin = "\"" + Atom(yMin).asString() + "\"";
-  std::string stringYMax = "\"" + Atom(yMax).asString() + "\"";
-
-  finalList.emplace_back(Expression(Atom(stringXMin)));
-  finalList.emplace_back(Expression(Atom(stringXMax)));
-  finalList.emplace_back(Expression(Atom(stringYMin)));
-  finalList.emplace_back(Expression(Atom(stringYMax)));
-
-  for(auto g = (options.tailConstBegin()); g != options.tailConstEnd(); g++){
-    finalList.emplace_back((*g).m_tail[1]);
-  }
+  plotFrame(xMin, xMax, yMin, yMax, xScale, yScale, options, finalList);
 
   Expression finallist = Expression(finalList);
   finallist.head().setContinuousPlot();
-  //std::cout << "size of vector: " << finalList.size() << std::endl;
   return finallist;
 }
 
-// Adds map functionality for a list
-Expression Expression::handle_map(Environment & env) {
-	std::vector<Expression> vec = {};
-	std::vector<Expression> vec2 = {};
-	Expression exp = m_tail[1].eval(env);
-
-	if (!exp.isHeadList()) {
-		throw SemanticError("Error during evaluation: second argument must be a list");
-	}
-	// tail must have size 3 or error
-	if (m_tail.size() != 2) {
-    //std::cout << "M_Tail Size: " << m_tail.size() << std::endl;
-		throw SemanticError("Error during evaluation: invalid number of arguments to map");
-	}
-	if (env.is_exp(m_tail[0].head())) {
-		for (auto e = (exp.tailConstBegin()); e != exp.tailConstEnd(); e++) {
-			vec2.push_back(*e);
-			Expression newexp = apply(m_tail[0].head(), vec2, env);
-			vec2.clear();
-			vec.push_back(newexp);
-		}
-		return Expression(vec);
-	}
-	int index = 0;
-	for (auto e = (m_tail[0].tailConstBegin()); e != m_tail[0].tailConstEnd(); e++) {
-		index++;
-	}
-	if (!env.is_proc(m_tail[0].head()) || index != 0) {
-		throw SemanticError("Error during evaluation: first argument must be a procedure");
-	}
-	for (auto e = (exp.tailConstBegin()); e != exp.tailConstEnd(); e++) {
-		vec2.push_back(*e);
-		Expression newexp = apply(m_tail[0].head(), vec2, env);
-		vec2.clear();
-		vec.push_back(newexp);
-	}
-	return Expression(vec);
-}
-
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const{
     if(head.isSymbol()){ // if symbol is in env return value
       if(env.is_exp(head)){
 	return env.get_exp(head);
@@ -704,58 +652,7 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }
 
-Expression Expression::handle_begin(Environment & env){
-  
-  if(m_tail.size() == 0){
-    throw SemanticError("Error during evaluation: zero arguments to begin");
-  }
-
-  // evaluate each arg from tail, return the last
-  Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
-    result = it->eval(env);
-  }
-  
-  return result;
-}
-
-
-Expression Expression::handle_define(Environment & env){
-
-  // tail must have size 3 or error
-  if(m_tail.size() != 2){
-    throw SemanticError("Error during evaluation: invalid number of arguments to define");
-  }
-  
-  // tail[0] must be symbol
-  if(!m_tail[0].isHeadSymbol()){
-    throw SemanticError("Error during evaluation: first argument to define not symbol");
-  }
-
-  // but tail[0] must not be a special-form or procedure
-  std::string s = m_tail[0].head().asSymbol();
-  if((s == "define") || (s == "begin") || (s == "e") || (s == "pi") || (s == "I")){
-    throw SemanticError("Error during evaluation: attempt to redefine a special-form");
-  }
-  
-  if(env.is_proc(m_head)){
-    throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
-  }
-	
-  // eval tail[1]
-  Expression result = m_tail[1].eval(env);
-
-  //if(env.is_exp(m_head)){
-  //  throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
-  //}
-    
-  //and add to env
-  env.add_exp(m_tail[0].head(), result);
-  
-  return result;
-}
-
-Expression Expression::handle_lambda(Environment & env) {
+Expression Expression::handle_lambda(Environment & env) const{
 	// tail must have size 3 or error
 	if (m_tail.size() != 2) {
 		throw SemanticError("Error during evaluation: invalid number of arguments to define");
@@ -791,117 +688,629 @@ Expression Expression::handle_lambda(Environment & env) {
 	return new_result;
 }
 
-// this is a simple recursive version. the iterative version is more
-// difficult with the ast data structure used (no parent pointer).
-// this limits the practical depth of our AST
-Expression Expression::eval(Environment & env){
-  if(global_status_flag > 0){
-    // std::cout << "Error: interpreter kernel not running" << std::endl;
-     throw SemanticError("Error: interpreter kernel not running");
-     //return Expression(Atom("Error: interpreter kernel not running"));
+// the limit is shared by all threads, the depth is counted per thread
+std::atomic<std::size_t> evalDepthLimit(DEFAULT_EVAL_DEPTH_LIMIT);
+thread_local std::size_t evalDepth = 0;
+
+void setEvalDepthLimit(std::size_t limit) noexcept{
+  evalDepthLimit = limit;
+}
+
+std::size_t getEvalDepthLimit() noexcept{
+  return evalDepthLimit;
+}
+
+// the cancel flag of the evaluations of this thread, if any
+thread_local const std::atomic<bool> * evalCancel = nullptr;
+
+void setEvalCancelFlag(const std::atomic<bool> * flag) noexcept{
+  evalCancel = flag;
+}
+
+bool isSpecialForm(const std::string & name){
+  static const std::set<std::string> forms = {
+    "begin", "define", "lambda", "map", "apply", "set-property", "get-property",
+    "discrete-plot", "continuous-plot", "memoize", "load-extension", "memory-stats"};
+  return forms.count(name) != 0;
+}
+
+// the kinds of pending evaluation held on the explicit stack
+enum FrameKind { CallFrame, BeginFrame, DefineFrame, SetPropertyFrame,
+		 GetPropertyFrame, ApplyFrame, MapFrame, BodyFrame, MemoizeFrame };
+
+// an expression whose operands are being evaluated
+struct EvalFrame {
+  EvalFrame(FrameKind k, const Expression * e, Environment * en, std::size_t first, std::size_t b):
+    kind(k), exp(e), env(en), next(first), base(b), profiled(false), traced(false), sampled(false) {}
+
+  FrameKind kind;
+  const Expression * exp; // the expression being evaluated
+  Environment * env; // the environment to evaluate it in
+  std::size_t next; // tail index of the next operand to evaluate
+  std::size_t base; // index of the first operand value on the argument stack
+  std::unique_ptr<Environment> scope; // the environment of a lambda call
+  ExpressionHandle lambda; // the lambda of a call, keeping its body alive
+  std::unique_ptr<MemoKey> memo; // the key of a memoized lambda call
+  bool profiled; // a lambda call timed by the profiler
+  bool traced; // a lambda call recorded as a trace span
+  bool sampled; // a lambda call entered on the shadow stack
+};
+
+// restores the depth count of the frames left on the stack by an exception
+struct DepthGuard {
+  DepthGuard(const std::vector<EvalFrame> & s): stack(s) {}
+  ~DepthGuard(){
+    evalDepth -= stack.size();
+    // the lambda calls an exception leaves end here
+    for(auto f = stack.rbegin(); f != stack.rend(); ++f){
+      if(f->profiled) exitProfile();
+      if(f->traced) exitTrace();
+      if(f->sampled) popShadowFrame();
+    }
   }
-  if(m_tail.empty()){
-	if (m_head.isSymbol() && m_head.asSymbol() == "list") {
-		  return Expression(m_tail);
-	}
-    return handle_lookup(m_head, env);
+  const std::vector<EvalFrame> & stack;
+};
+
+// the values of the operands of the pending frames, each frame's above
+// those of the frames below it, drawn from the scratch pool
+struct ArgumentStack {
+  ArgumentStack(): values(acquireScratch()) {}
+  ~ArgumentStack(){ recycleScratch(values); }
+
+  // the values from index base to the top
+  ArgSpan from(std::size_t base) const noexcept{
+    return ArgSpan(values.data() + base, values.size() - base);
   }
-  // handle lambda special-form
-  if (m_head.isSymbol() && m_head.asSymbol() == "lambda") {
-	  return handle_lambda(env);
+
+  // drop the values from index base to the top
+  void popTo(std::size_t base){
+    values.erase(values.begin() + base, values.end());
   }
-  // handle map special-form
-  if (m_head.isSymbol() && m_head.asSymbol() == "map") {
-	  return handle_map(env);
+
+  std::vector<Expression> values;
+};
+
+// call the built-in procedure named op
+Expression callProcedure(const Atom & op, ArgSpan args, const Environment & env){
+  // head must be a symbol
+  if(!op.isSymbol()){
+    throw SemanticError("Error during evaluation: procedure name not symbol");
   }
-  // handle apply special-form
-  if (m_head.isSymbol() && m_head.asSymbol() == "apply") {
-	  return handle_apply(env);
+  
+  // must map to a proc
+  const Procedure * proc = env.find_proc(op);
+  if(proc == nullptr){
+    throw SemanticError("Error during evaluation: symbol does not name a procedure");
   }
-  // handle map special-form
-  if (m_head.isSymbol() && m_head.asSymbol() == "map") {
-	  return handle_map(env);
+
+  // call proc with args
+  if(instrumented()){
+    ShadowCall shadow(op);
+    if(profiling()){
+      ProfileCall call(op);
+      return (*proc)(args);
+    }
+    return (*proc)(args);
   }
-  // handle begin special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "begin"){
-    return handle_begin(env);
+  return (*proc)(args);
+}
+
+// Turn frame into the evaluation of the body of the lambda named op, with
+// its parameters bound to args in a copy of env. Returns false with the
+// value in result instead if the lambda is memoized and the call cached.
+// The caller drops the frame's operands once entered.
+bool enterLambda(EvalFrame & frame, const Atom & op, ArgSpan args,
+		 const Environment & env, Expression & result){
+
+  ExpressionHandle lambda = env.get_handle(op);
+  if(!lambda || !lambda->head().isLambda()){
+    throw SemanticError("Error during evaluation: symbol does not name a procedure");
   }
-  // handle define special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "define"){
-    return handle_define(env);
+
+  const Expression & params = *lambda->tailConstBegin();
+  if(args.size() != static_cast<std::size_t>(params.tailConstEnd() - params.tailConstBegin())){
+    throw SemanticError("Error: during apply : Error in call to procedure : invalid number of arguments.");
   }
-  // handle set_property special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "set-property"){
-    return set_property(env);
+
+  std::unique_ptr<MemoKey> memo;
+  if(!lambda->getProperty(memoizedKey()).head().isNone()){
+    memo.reset(new MemoKey(makeMemoKey(lambda, args, env)));
+    if(lookupMemo(*memo, result)){
+      return false;
+    }
   }
-  // handle get_property special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "get-property"){
-    return get_property(env);
+
+  std::unique_ptr<Environment> scope(new Environment(env, true));
+  std::size_t index = 0;
+  for(auto e = params.tailConstBegin(); e != params.tailConstEnd(); ++e){
+    std::string str = e->head().asSymbol();
+    scope->findProc(str, *scope);
+    scope->add_exp(Atom(str), args[index++]);
   }
-  // discrete plot special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "discrete-plot"){
-    return discrete_plot(env);
+
+  if(instrumented()){
+    if(profiling()){
+      enterProfile(op, true);
+      frame.profiled = true;
+    }
+    if(tracing()){
+      enterTrace(op.asSymbol(), "lambda");
+      frame.traced = true;
+    }
+    if(sampling()){
+      pushShadowFrame(op);
+      frame.sampled = true;
+    }
   }
-  // continuous plot special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "continuous-plot"){
-    return continuous_plot(env);
+
+  frame.exp = &*(lambda->tailConstEnd() - 1);
+  frame.lambda = std::move(lambda);
+  frame.scope = std::move(scope);
+  frame.memo = std::move(memo);
+  frame.kind = BodyFrame;
+  frame.env = frame.scope.get();
+  return true;
+}
+
+// Evaluation keeps its pending work on an explicit stack of frames rather
+// than recursing, so the depth of the AST (and of lambda calls) is limited
+// by getEvalDepthLimit() rather than the native stack. The operand values
+// of all frames share one argument stack, and built-ins are called with a
+// span of it. The plot special forms still call eval on their operands
+// and the map of their function.
+Expression Expression::eval(Environment & env) const{
+
+  std::vector<EvalFrame> stack;
+  DepthGuard guard(stack);
+  ArgumentStack args;
+  Expression result;
+
+  auto push = [&](FrameKind kind, const Expression * e, Environment * en, std::size_t first){
+    if(evalDepth >= evalDepthLimit){
+      throw SemanticError("Error during evaluation: maximum evaluation depth exceeded");
+    }
+    stack.emplace_back(kind, e, en, first, args.values.size());
+    ++evalDepth;
+  };
+
+  // Start evaluating e in en. Returns true with the value in result if no
+  // operands need evaluating, otherwise pushes a frame for e.
+  auto start = [&](const Expression & e, Environment & en) -> bool {
+    if(global_status_flag > 0){
+      throw SemanticError("Error: interpreter kernel not running");
+    }
+    if((evalCancel != nullptr) && evalCancel->load(std::memory_order_relaxed)){
+      throw SemanticError("Error during evaluation: evaluation cancelled");
+    }
+
+    const TailType & tail = e.m_tail;
+    if(tail.empty()){
+      if(e.m_head.isSymbol() && e.m_head.asSymbol() == "list"){
+	result = Expression(std::vector<Expression>());
+      }
+      else if(e.m_head.isSymbol() && e.m_head.asSymbol() == "memory-stats"){
+	result = memoryStats(en);
+      }
+      else{
+	result = e.handle_lookup(e.m_head, en);
+      }
+      return true;
+    }
+
+    std::string name = e.m_head.asSymbol();
+    // handle lambda special-form
+    if(name == "lambda"){
+      result = e.handle_lambda(en);
+      return true;
+    }
+    // handle map and apply special-forms
+    else if((name == "map") || (name == "apply")){
+      if(tail.size() != 2){
+	throw SemanticError("Error during evaluation: invalid number of arguments to " + name);
+      }
+      push((name == "map") ? MapFrame : ApplyFrame, &e, &en, 1);
+    }
+    // handle memory-stats special-form, which takes no arguments
+    else if(name == "memory-stats"){
+      throw SemanticError("Error during evaluation: invalid number of arguments to memory-stats");
+    }
+    // handle load-extension special-form, the path is not evaluated
+    else if(name == "load-extension"){
+      if((tail.size() != 1) || !tail[0].isHeadString() || !tail[0].m_tail.empty()){
+	throw SemanticError("Error during evaluation: argument to load-extension not a path string");
+      }
+      std::string path = tail[0].m_head.asString();
+      result = loadExtension(path.substr(1, path.size() - 2), en);
+      return true;
+    }
+    // handle memoize special-form
+    else if(name == "memoize"){
+      if(tail.size() != 1){
+	throw SemanticError("Error during evaluation: invalid number of arguments to memoize");
+      }
+      push(MemoizeFrame, &e, &en, 0);
+    }
+    // handle begin special-form
+    else if(name == "begin"){
+      push(BeginFrame, &e, &en, 0);
+    }
+    // handle define special-form
+    else if(name == "define"){
+      if(tail.size() != 2){
+	throw SemanticError("Error during evaluation: invalid number of arguments to define");
+      }
+      if(!tail[0].isHeadSymbol()){
+	throw SemanticError("Error during evaluation: first argument to define not symbol");
+      }
+      // but tail[0] must not be a special-form or procedure
+      std::string s = tail[0].head().asSymbol();
+      if((s == "define") || (s == "begin") || (s == "e") || (s == "pi") || (s == "I")){
+	throw SemanticError("Error during evaluation: attempt to redefine a special-form");
+      }
+      if(en.is_proc(e.m_head)){
+	throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
+      }
+      push(DefineFrame, &e, &en, 1);
+    }
+    // handle set-property and get-property special-forms
+    else if((name == "set-property") || (name == "get-property")){
+      if(!tail[0].isHeadString()){
+	throw SemanticError("Error during evaluation: first argument to property not a string");
+      }
+      if(tail.size() != ((name == "set-property") ? 3u : 2u)){
+	throw SemanticError("Error during evaluation: invalid number of arguments to property");
+      }
+      push((name == "set-property") ? SetPropertyFrame : GetPropertyFrame, &e, &en, 1);
+    }
+    // discrete plot special-form
+    else if(name == "discrete-plot"){
+      result = e.discrete_plot(en);
+      return true;
+    }
+    // continuous plot special-form
+    else if(name == "continuous-plot"){
+      result = e.continuous_plot(en);
+      return true;
+    }
+    // else attempt to treat as procedure, a built-in's arity is checked
+    // before its operands are evaluated
+    else{
+      const Procedure * proc = en.find_proc(e.m_head);
+      if(proc != nullptr){
+	proc->checkArity(tail.size());
+      }
+      push(CallFrame, &e, &en, 0);
+    }
+    return false;
+  };
+
+  // count a growth of the argument stack against the call taking the value,
+  // if profiling was on when this evaluation started, read once rather than
+  // per operand
+  const bool countGrowth = profiling();
+  auto profileGrowth = [&](const EvalFrame & f){
+    if(countGrowth && (f.kind == CallFrame) && (args.values.size() == args.values.capacity())){
+      countArgumentAlloc(f.exp->m_head, f.env->is_exp(f.exp->m_head));
+    }
+  };
+
+  if(start(*this, env)){
+    return result;
   }
-  // else attempt to treat as procedure
-  else{ 
-    std::vector<Expression> results;
-    for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
-      results.push_back(it->eval(env));
+
+  while(true){
+    EvalFrame & f = stack.back();
+    const TailType & tail = f.exp->m_tail;
+
+    // evaluate the next operand, if any
+    bool more = (f.kind == BodyFrame) ? (args.values.size() == f.base) : (f.next < tail.size());
+    if(more){
+      const Expression & operand = (f.kind == BodyFrame) ? *f.exp : tail[f.next++];
+      if(f.kind == BeginFrame){
+	args.popTo(f.base); // only the last value is kept
+      }
+      if(start(operand, *f.env)){
+	profileGrowth(f);
+	args.values.push_back(std::move(result));
+      }
+      continue;
+    }
+
+    // all operands are evaluated, complete the frame
+    Expression * operands = args.values.data() + f.base;
+    if(f.kind == CallFrame){
+      if(f.env->is_exp(f.exp->m_head)){
+	if(enterLambda(f, f.exp->m_head, args.from(f.base), *f.env, result)){
+	  args.popTo(f.base);
+	  continue;
+	}
+      }
+      else{
+	result = callProcedure(f.exp->m_head, args.from(f.base), *f.env);
+      }
+    }
+    else if((f.kind == BeginFrame) || (f.kind == BodyFrame)){
+      result = std::move(args.values.back());
+      if(f.profiled){
+	exitProfile();
+      }
+      if(f.traced){
+	exitTrace();
+      }
+      if(f.sampled){
+	popShadowFrame();
+      }
+      if(f.memo){
+	storeMemo(std::move(*f.memo), result);
+      }
+    }
+    else if(f.kind == MemoizeFrame){
+      if(!operands[0].head().isLambda()){
+	throw SemanticError("Error during evaluation: argument to memoize not a lambda");
+      }
+      result = memoize(operands[0]);
+    }
+    else if(f.kind == DefineFrame){
+      f.env->add_exp(tail[0].head(), operands[0]);
+      result = std::move(operands[0]);
+    }
+    else if(f.kind == SetPropertyFrame){
+      result = std::move(operands[1]);
+      result.setProperty(internPropertyKey(tail[0].head().asString()), std::move(operands[0]));
+    }
+    else if(f.kind == GetPropertyFrame){
+      result = operands[0].getProperty(internPropertyKey(tail[0].head().asString()));
+    }
+    else{ // ApplyFrame or MapFrame, operands[0] is the list
+      if(!operands[0].isHeadList()){
+	throw SemanticError("Error during evaluation: second argument must be a list");
+      }
+
+      const Atom & op = tail[0].head();
+      bool lambda = f.env->is_exp(op);
+      if(!lambda && (!f.env->is_proc(op) || !tail[0].m_tail.empty())){
+	throw SemanticError("Error during evaluation: first argument must be a procedure");
+      }
+
+      const TailType & list = operands[0].m_tail;
+      if(f.kind == ApplyFrame){
+	// the items of the list are the arguments
+	ArgSpan items(list.data(), list.size());
+	if(!lambda){
+	  result = callProcedure(op, items, *f.env);
+	}
+	else if(enterLambda(f, op, items, *f.env, result)){
+	  args.popTo(f.base);
+	  continue;
+	}
+      }
+      else if(lambda){
+	// operands[1...] are the values of the items mapped so far
+	std::size_t done = args.values.size() - f.base - 1;
+	if(done < list.size()){
+	  Expression item(list[done]);
+	  Environment * en = f.env;
+	  push(BodyFrame, nullptr, en, 0);
+	  args.values.push_back(std::move(item));
+	  bool entered = enterLambda(stack.back(), op, ArgSpan(&args.values.back(), 1), *en, result);
+	  args.values.pop_back();
+	  if(!entered){
+	    // cached, so the value is in result
+	    stack.pop_back();
+	    --evalDepth;
+	    args.values.push_back(std::move(result));
+	  }
+	  continue;
+	}
+	result = Expression(std::vector<Expression>(std::make_move_iterator(operands + 1),
+						    std::make_move_iterator(args.values.data() + args.values.size())));
+      }
+      else{
+	std::vector<Expression> values;
+	values.reserve(list.size());
+	const Procedure * proc = f.env->find_proc(op);
+	bool numbers = proc->isVectorized() && !list.empty() &&
+	  std::all_of(list.begin(), list.end(), [](const Expression & e){
+	      return e.isHeadNumber() && e.m_tail.empty();
+	    });
+	if(numbers){
+	  // one call of the vectorized variant
+	  std::vector<double> in(list.size()), out(list.size());
+	  for(std::size_t i = 0; i < list.size(); ++i){
+	    in[i] = list[i].m_head.asNumber();
+	  }
+	  if(profiling()){
+	    ProfileCall call(op);
+	    proc->map(in.data(), out.data(), in.size());
+	  }
+	  else{
+	    proc->map(in.data(), out.data(), in.size());
+	  }
+	  for(double v : out){
+	    values.emplace_back(v);
+	  }
+	}
+	else{
+	  for(auto & e : list){
+	    values.push_back(callProcedure(op, ArgSpan(&e, 1), *f.env));
+	  }
+	}
+	result = Expression(values);
+      }
+    }
+
+    // hand the value to the frame below
+    args.popTo(stack.back().base);
+    stack.pop_back();
+    --evalDepth;
+    if(stack.empty()){
+      return result;
     }
-    return apply(m_head, results, env);
+    profileGrowth(stack.back());
+    args.values.push_back(std::move(result));
   }
 }
 
-
+// Printing walks the tree with an explicit stack of the expressions whose
+// tails are being printed.
 std::ostream & operator<<(std::ostream & out, const Expression & exp){
-  Environment env;
-  if(!exp.isHeadList() && exp.head().isNone()){
-    out << "NONE";
-  }
-  else{
-      if(!exp.isHeadComplex()) out << "(";
-    out << exp.head();
+  static const Environment builtins;
 
-    if (exp.isHeadSymbol() && env.is_proc(exp.head())) {
-      out << " ";
+  std::vector<std::pair<const Expression *, Expression::ConstIteratorType>> stack;
+  const Expression * e = &exp;
+  while(e != nullptr){
+    if(!e->isHeadList() && e->head().isNone()){
+      out << "NONE";
     }
+    else{
+      if(!e->isHeadComplex()) out << "(";
+      out << e->head();
+
+      if (e->isHeadSymbol() && builtins.is_proc(e->head())) {
+	out << " ";
+      }
 
-    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
-      auto it = e + 1;
-      if (it == exp.tailConstEnd()) {
-        out << *e;
+      if(e->tailConstBegin() != e->tailConstEnd()){
+	stack.emplace_back(e, e->tailConstBegin());
       }
-      else {
-        out << *e << " ";
+      else if(!e->isHeadComplex()){
+	out << ")";
       }
     }
 
-    if (!exp.isHeadComplex()) {
-	  out << ")";
+    // move on to the next tail expression, closing finished ones
+    e = nullptr;
+    while((e == nullptr) && !stack.empty()){
+      auto & top = stack.back();
+      if(top.second != top.first->tailConstEnd()){
+	if(top.second != top.first->tailConstBegin()) out << " ";
+	e = &*(top.second++);
+      }
+      else{
+	if(!top.first->isHeadComplex()) out << ")";
+	stack.pop_back();
+      }
     }
   }
   return out;
 }
 
 bool Expression::operator==(const Expression & exp) const noexcept{
-  
-  bool result = (m_head == exp.m_head);
 
-  result = result && (m_tail.size() == exp.m_tail.size());
+  if(this == &exp){
+    return true;
+  }
+  if(!(m_head == exp.m_head) || (m_tail.size() != exp.m_tail.size())){
+    return false;
+  }
+  if(m_tail.empty()){
+    return true;
+  }
+
+  std::vector<std::pair<const Expression *, const Expression *>> pending = {{this, &exp}};
+  while(!pending.empty()){
+    const Expression & left = *pending.back().first;
+    const Expression & right = *pending.back().second;
+    pending.pop_back();
+
+    if(!(left.m_head == right.m_head) || (left.m_tail.size() != right.m_tail.size())){
+      return false;
+    }
+    for(std::size_t i = 0; i < left.m_tail.size(); ++i){
+      pending.emplace_back(&left.m_tail[i], &right.m_tail[i]);
+    }
+  }
 
-  if(result){
-    for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
-	++lefte, ++righte){
-      result = result && (*lefte == *righte);
+  return true;
+}
+
+// the graphics fields hold the same properties
+bool sameGraphic(const Graphic & a, const Graphic & b){
+  if((a.kind != b.kind) || (a.fields != b.fields)) return false;
+  for(PropertyKey key = SIZE_KEY; key <= TEXT_ROTATION_KEY; ++key){
+    if(!(a.fields & fieldBit(key))) continue;
+    if(key == POSITION_KEY){
+      if((a.x != b.x) || (a.y != b.y)) return false;
+    }
+    else if(numericValue(a, key) != numericValue(b, key)){
+      return false;
     }
   }
+  return true;
+}
 
-  return result;
+bool Expression::identical(const Expression & exp) const noexcept{
+
+  std::vector<std::pair<const Expression *, const Expression *>> pending = {{this, &exp}};
+  while(!pending.empty()){
+    const Expression & left = *pending.back().first;
+    const Expression & right = *pending.back().second;
+    pending.pop_back();
+
+    if(&left == &right) continue;
+    if(!left.m_head.identical(right.m_head) || (left.m_tail.size() != right.m_tail.size()) ||
+       (!left.m_properties != !right.m_properties)){
+      return false;
+    }
+    for(std::size_t i = 0; i < left.m_tail.size(); ++i){
+      pending.emplace_back(&left.m_tail[i], &right.m_tail[i]);
+    }
+
+    if(left.m_properties){
+      const PropertyBlock & a = *left.m_properties;
+      const PropertyBlock & b = *right.m_properties;
+      if(!sameGraphic(a.graphic, b.graphic) || (a.others.size() != b.others.size())){
+	return false;
+      }
+      for(std::size_t i = 0; i < a.others.size(); ++i){
+	if(a.others[i].first != b.others[i].first) return false;
+	pending.emplace_back(&a.others[i].second, &b.others[i].second);
+      }
+    }
+  }
+
+  return true;
+}
+
+// combine a value into a running hash
+inline void mix(std::size_t & h, std::size_t value){
+  h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+}
+
+std::size_t Expression::hash() const noexcept{
+
+  std::size_t h = 0;
+  std::vector<const Expression *> pending = {this};
+  while(!pending.empty()){
+    const Expression & e = *pending.back();
+    pending.pop_back();
+
+    mix(h, e.m_head.hash());
+    mix(h, e.m_tail.size());
+    for(auto it = e.m_tail.rbegin(); it != e.m_tail.rend(); ++it){
+      pending.push_back(&*it);
+    }
+
+    if(e.m_properties){
+      const Graphic & g = e.m_properties->graphic;
+      mix(h, (std::size_t(g.kind) << 8) | g.fields);
+      for(PropertyKey key = SIZE_KEY; key <= TEXT_ROTATION_KEY; ++key){
+	if(!(g.fields & fieldBit(key))) continue;
+	if(key == POSITION_KEY){
+	  mix(h, std::hash<double>()(g.x));
+	  mix(h, std::hash<double>()(g.y));
+	}
+	else{
+	  mix(h, std::hash<double>()(numericValue(g, key)));
+	}
+      }
+      for(auto & p : e.m_properties->others){
+	mix(h, p.first);
+	pending.push_back(&p.second);
+      }
+    }
+  }
+  return h;
 }
 
 bool operator!=(const Expression & left, const Expression & right) noexcept{
@@ -910,32 +1319,35 @@ bool operator!=(const Expression & left, const Expression & right) noexcept{
 }
 
 std::string Expression::makeString() const noexcept{
-    Environment env;
-    std::string newString;
-    // static bool listStartChecked = false;
-    // static bool listEndChecked = false;
-    if(!this->isHeadList() && this->head().isNone()){
-        newString+="NONE";
-    }
-    else{
-      if(!this->isHeadComplex() && !this->isHeadList()){
-          newString+="(";
-      }
-      newString+=this->head().asString();
+  std::string newString;
 
-      for(auto e = this->tailConstBegin(); e != this->tailConstEnd(); ++e){
-        newString+=(*e).makeString();
-      }
+  // expressions still to render, and the closing parens still owed
+  std::vector<const Expression *> pending = {this};
+  while(!pending.empty()){
+    const Expression * e = pending.back();
+    pending.pop_back();
 
-      if (!this->isHeadComplex() && !this->isHeadList()) {
+    if(e == nullptr){
       newString+=")";
+    }
+    else if(!e->isHeadList() && e->head().isNone()){
+      newString+="NONE";
+    }
+    else{
+      bool parens = !e->isHeadComplex() && !e->isHeadList();
+      if(parens){
+	newString+="(";
+	pending.push_back(nullptr);
       }
+      newString+=e->head().asString();
 
+      for(auto it = e->m_tail.rbegin(); it != e->m_tail.rend(); ++it){
+	pending.push_back(&*it);
+      }
+    }
   }
-  //std::cout << newString << std::endl;
   return newString;
 }
-
 std::vector<Expression> Expression::makeTail() const noexcept{
   std::vector<Expression> vec;
   for(auto e = this->tailConstBegin(); e != this->tailConstEnd(); ++e){
@@ -946,36 +1358,15 @@ std::vector<Expression> Expression::makeTail() const noexcept{
 }
 
 bool Expression::isPoint() const noexcept{
-  bool point = false;
-  Expression pointExp(Atom("\"point\""));
-  if(propertymap.find("\"object-name\"") != propertymap.end()){
-    if(propertymap.at("\"object-name\"") == pointExp){
-      point = true;
-    }
-  }
-  return point;
+  return m_properties && (m_properties->graphic.kind == PointGraphic);
 }
 
 bool Expression::isLine() const noexcept{
-  bool line = false;
-  Expression lineExp(Atom("\"line\""));
-  if(propertymap.find("\"object-name\"") != propertymap.end()){
-    if(propertymap.at("\"object-name\"") == lineExp){
-      line = true;
-    }
-  }
-  return line;
+  return m_properties && (m_properties->graphic.kind == LineGraphic);
 }
 
 bool Expression::isText() const noexcept{
-  bool text = false;
-  Expression textExp(Atom("\"text\""));
-  if(propertymap.find("\"object-name\"") != propertymap.end()){
-    if(propertymap.at("\"object-name\"") == textExp){
-      text = true;
-    }
-  }
-  return text;
+  return m_properties && (m_properties->graphic.kind == TextGraphic);
 }
 
 // bool Expression::isDiscrete() const noexcept{
@@ -990,23 +1381,41 @@ bool Expression::isText() const noexcept{
 // }
 
 double Expression::getSize() const noexcept{
-  return propertymap.at("\"size\"").head().asNumber();
+  return (m_properties && (m_properties->graphic.fields & fieldBit(SIZE_KEY))) ?
+    m_properties->graphic.size : 0.0;
 }
 
 double Expression::getThickness() const noexcept{
-  return propertymap.at("\"thickness\"").head().asNumber();
+  return (m_properties && (m_properties->graphic.fields & fieldBit(THICKNESS_KEY))) ?
+    m_properties->graphic.thickness : 0.0;
 }
 
 Expression Expression::getPosition() const noexcept{
-  return propertymap.at("\"position\"");
+  return getProperty(POSITION_KEY);
 }
 
 double Expression::getTextScale() const noexcept{
-  return propertymap.at("\"text-scale\"").head().asNumber();
+  return (m_properties && (m_properties->graphic.fields & fieldBit(TEXT_SCALE_KEY))) ?
+    m_properties->graphic.scale : 0.0;
 }
   
 double Expression::getTextRotation() const noexcept{
-  return propertymap.at("\"text-rotation\"").head().asNumber();
+  return (m_properties && (m_properties->graphic.fields & fieldBit(TEXT_ROTATION_KEY))) ?
+    m_properties->graphic.rotation : 0.0;
 }
 
+double Expression::getX() const noexcept{
+  if(isText()){
+    return (m_properties->graphic.fields & fieldBit(POSITION_KEY)) ?
+      m_properties->graphic.x : getPosition().getX();
+  }
+  return m_tail.empty() ? 0.0 : m_tail[0].m_head.asNumber();
+}
 
+double Expression::getY() const noexcept{
+  if(isText()){
+    return (m_properties->graphic.fields & fieldBit(POSITION_KEY)) ?
+      m_properties->graphic.y : getPosition().getY();
+  }
+  return (m_tail.size() < 2) ? 0.0 : m_tail[1].m_head.asNumber();
+}
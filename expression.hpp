@@ -5,14 +5,18 @@ Defines the Expression type and assiciated functions.
 #define EXPRESSION_HPP
 
 // system includes
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <algorithm> 
 #include <csignal>
+#include <cstdint>
 #include <cstdlib>
 #include "token.hpp"
 #include "atom.hpp"
+#include "small_block.hpp"
 
 const double N = 20.0;
 const double A = 3.0;
@@ -23,6 +27,52 @@ const double P = 0.5;
 
 extern sig_atomic_t global_status_flag;
 
+/// the default limit on the nesting depth of evaluation
+const std::size_t DEFAULT_EVAL_DEPTH_LIMIT = 100000;
+
+/*! Set the limit on the nesting depth of evaluation, beyond which eval
+  throws a SemanticError rather than growing without bound
+  \param limit the maximum number of nested pending evaluations per thread
+ */
+void setEvalDepthLimit(std::size_t limit) noexcept;
+
+/// return the limit on the nesting depth of evaluation
+std::size_t getEvalDepthLimit() noexcept;
+
+/*! Make evaluation on the calling thread check a flag as it starts each
+  expression, throwing a SemanticError once the flag is set (e.g. by a
+  timeout on another thread). A built-in procedure already called runs to
+  completion first.
+  \param flag the flag to check, or nullptr to check none
+ */
+void setEvalCancelFlag(const std::atomic<bool> * flag) noexcept;
+
+/// return true if name is a special form, which is not looked up in the
+/// environment when it heads a call
+bool isSpecialForm(const std::string & name);
+
+/*! \typedef PropertyKey
+\brief The interned id of a property name (the quoted string used as key).
+*/
+typedef uint32_t PropertyKey;
+
+/// the keys used by the graphics primitives, interned before any other
+const PropertyKey OBJECT_NAME_KEY = 0;
+const PropertyKey SIZE_KEY = 1;
+const PropertyKey THICKNESS_KEY = 2;
+const PropertyKey POSITION_KEY = 3;
+const PropertyKey TEXT_SCALE_KEY = 4;
+const PropertyKey TEXT_ROTATION_KEY = 5;
+
+/*! Intern a property name, shared by all threads
+  \param name the property name, e.g. "\"size\""
+  \return the same key for every call with an equal name
+ */
+PropertyKey internPropertyKey(const std::string & name);
+
+/// return the name of an interned property key
+const std::string & propertyKeyName(PropertyKey key);
+
 // forward declare Environment
 class Environment;
 
@@ -35,7 +85,15 @@ list of expressions called the tail.
 class Expression {
 public:
 
-  typedef std::vector<Expression>::const_iterator ConstIteratorType;
+  /// the tail list, its storage drawn from the small block pool
+  typedef std::vector<Expression, SmallBlockAllocator<Expression>> TailType;
+
+  typedef TailType::const_iterator ConstIteratorType;
+
+  typedef TailType::iterator IteratorType;
+
+  /// a property of an expression, its interned key and value
+  typedef std::pair<PropertyKey, Expression> Property;
 
   /// Default construct and Expression, whose type in NoneType
   Expression();
@@ -45,9 +103,12 @@ public:
   */
   Expression(const Atom & a);
 
-  /// deep-copy construct an expression (recursive)
+  /// deep-copy construct an expression (iterative)
   Expression(const Expression & a);
 
+  /// move construct an expression, leaving a with an empty tail
+  Expression(Expression && a) noexcept;
+
   // List Constructor
   Expression(const std::vector<Expression> & list);
 
@@ -57,9 +118,15 @@ public:
   // Discrete-Plot Constructor
   Expression(const std::vector<Expression> & args, std::string & str);
 
-  /// deep-copy assign an expression  (recursive)
+  /// deep-copy assign an expression (iterative)
   Expression & operator=(const Expression & a);
 
+  /// move assign an expression
+  Expression & operator=(Expression && a) noexcept;
+
+  /// destroy an expression (iterative)
+  ~Expression();
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -69,6 +136,9 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
+  /// append an Expression to the tail, moving its tree rather than copying it
+  void append(Expression && e);
+
   /// return a pointer to the last expression in the tail, or nullptr
   Expression * tail();
 
@@ -78,6 +148,31 @@ public:
   /// return a const-iterator to the tail end
   ConstIteratorType tailConstEnd() const noexcept;
 
+  /// return an iterator to the beginning of tail, for rewriting in place
+  IteratorType tailBegin() noexcept;
+
+  /// return an iterator to the tail end
+  IteratorType tailEnd() noexcept;
+
+  /// return the (key, value) properties, the graphics properties first in
+  /// key order, then the others in the order they were first set
+  std::vector<Property> properties() const;
+
+  /// add or replace the property named key
+  void setProperty(const std::string & key, Expression value);
+
+  /*! Add or replace the property with interned key. The graphics
+    properties with values of the expected kind (an object-name of "point",
+    "line" or "text", a numeric size, thickness, text-scale or
+    text-rotation, a position made by makePoint) are held as plain fields.
+    \param key the interned property name
+    \param value the property value
+   */
+  void setProperty(PropertyKey key, Expression value);
+
+  /// return the property with interned key, or a None Expression if it is not set
+  Expression getProperty(PropertyKey key) const;
+
   /// convienience member to determine if head atom is a number
   bool isHeadNumber() const noexcept;
 
@@ -93,12 +188,29 @@ public:
   /// convenience member to determine if head atom is a string
   bool isHeadString() const noexcept;
 
-  /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  /*! Return the bytes the expression retains: its own size and the heap
+    held by its tree, counting text shared with other Atoms in full
+   */
+  std::size_t retainedBytes() const;
 
-  /// equality comparison for two expressions (recursive)
+  /*! Evaluate expression using a post-order traversal (iterative, using
+    an explicit stack of pending evaluations)
+    \throws SemanticError when a semantic error is encountered, including
+    nesting deeper than getEvalDepthLimit()
+  */
+  Expression eval(Environment & env) const;
+
+  /// equality comparison for two expressions (iterative)
   bool operator==(const Expression & exp) const noexcept;
 
+  /// exact equality including properties, which operator== ignores, with
+  /// Atoms compared by Atom::identical (iterative)
+  bool identical(const Expression & exp) const noexcept;
+
+  /// return a hash of the head, tail and properties, equal for identical
+  /// expressions (iterative)
+  std::size_t hash() const noexcept;
+
   std::string makeString() const noexcept;
 
   std::vector<Expression> makeTail() const noexcept;
@@ -120,6 +232,12 @@ public:
   double getTextScale() const noexcept;
   
   double getTextRotation() const noexcept;
+
+  /// return the x coordinate of a point, or of the position of a text
+  double getX() const noexcept;
+
+  /// return the y coordinate of a point, or of the position of a text
+  double getY() const noexcept;
   
 private:
 
@@ -127,34 +245,53 @@ private:
   Atom m_head;
 
   // the tail list is expressed as a vector for access efficiency
-  // and cache coherence, at the cost of wasted memory.
-  std::vector<Expression> m_tail;
-
-  // convenience typedef
-  typedef std::vector<Expression>::iterator IteratorType;
+  // and cache coherence; short tails reuse pooled blocks rather than
+  // each taking a heap allocation.
+  TailType m_tail;
 
   // typedef for List
-  typedef std::vector<Expression>::iterator ListType;
+  typedef TailType::iterator ListType;
   
   // internal helper methods
-  Expression set_property(Environment & env);
-  Expression get_property(Environment & env);
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_lambda(Environment & env);
-  Expression handle_apply(Environment & env);
-  Expression handle_map(Environment & env);
-  Expression discrete_plot(Environment & env);
-  Expression continuous_plot(Environment & env);
-
-  std::map<std::string, Expression> propertymap;
+  Expression handle_lookup(const Atom & head, const Environment & env) const;
+  Expression handle_lambda(Environment & env) const;
+  Expression discrete_plot(Environment & env) const;
+  Expression continuous_plot(Environment & env) const;
+
+  // move the nested expressions into pending, leaving this a leaf
+  void release(std::vector<Expression> & pending) noexcept;
+
+  // true if the tail or a property value holds an expression
+  bool isNested() const noexcept;
+
+  // the graphics fields and other properties, defined in expression.cpp
+  struct PropertyBlock;
+
+  // the properties, allocated only once one is set
+  std::unique_ptr<PropertyBlock> m_properties;
 };
 
+/// return a point at (x, y) of size 0, as made by make-point
+Expression makePoint(double x, double y);
+
+/// return a point of size 0 with any two coordinates, as make-point makes
+/// from arguments that are not both numbers
+Expression makePoint(const Expression & x, const Expression & y);
+
+/// return a line between two points of thickness 1, as made by make-line
+Expression makeLine(const Expression & from, const Expression & to);
+
+/// return text at position (0, 0) with scale 1 and rotation 0, as made by make-text
+Expression makeText(const Expression & text);
+
 /// Render expression to output stream
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
 
 /// inequality comparison for two expressions (recursive)
 bool operator!=(const Expression & left, const Expression & right) noexcept;
+
+inline bool Expression::isHeadNumber() const noexcept{
+  return m_head.isNumber();
+}
   
 #endif
@@ -1,5 +1,8 @@
 #include "catch.hpp"
 
+#include <algorithm>
+#include <sstream>
+
 #include "expression.hpp"
 #include "environment.hpp"
 
@@ -38,3 +41,169 @@ TEST_CASE( "Test symbol expression", "[expression]" ) {
   REQUIRE(exp.isHeadSymbol());
 }
 
+
+// a chain of nested lists, far deeper than the native stack could recurse
+Expression deepList(std::size_t depth){
+  Expression exp;
+  Expression * e = &exp;
+  for(std::size_t i = 0; i < depth; ++i){
+    e->head().setList();
+    e->setProperty("\"depth\"", Expression(static_cast<double>(i)));
+    e->append(Atom(1.));
+    e->append(Atom());
+    e = e->tail();
+  }
+  e->head() = Atom("\"leaf\"");
+  return exp;
+}
+
+TEST_CASE( "Test copying, comparing and destroying deep expressions", "[expression]" ) {
+
+  const std::size_t depth = 300000;
+  Expression exp = deepList(depth);
+
+  Expression copy(exp);
+  REQUIRE(copy == exp);
+
+  Expression assigned;
+  assigned = exp;
+  REQUIRE(assigned == exp);
+
+  // assigning a subtree of itself
+  assigned = *(assigned.tailConstEnd() - 1);
+  REQUIRE(assigned == *(exp.tailConstEnd() - 1));
+  REQUIRE(assigned != exp);
+
+  Expression moved(std::move(copy));
+  REQUIRE(moved == exp);
+  REQUIRE(copy.tailConstBegin() == copy.tailConstEnd());
+}
+
+TEST_CASE( "Test printing deep expressions", "[expression]" ) {
+
+  Expression exp = deepList(200000);
+
+  std::ostringstream oss;
+  oss << exp;
+  std::string out = oss.str();
+
+  REQUIRE(out.substr(0, 8) == "((1) ((1");
+  REQUIRE(std::count(out.begin(), out.end(), '(') == std::count(out.begin(), out.end(), ')'));
+
+  std::string str = exp.makeString();
+  REQUIRE(str.find("(\"leaf\")") != std::string::npos);
+}
+
+TEST_CASE( "Test printing nested expressions", "[expression]" ) {
+
+  Expression inner(std::vector<Expression>{Expression(2.), Expression(Atom("\"s\""))});
+  Expression exp(std::vector<Expression>{Expression(1.), inner, Expression()},
+		 Atom("f"));
+
+  std::ostringstream oss;
+  oss << exp;
+  REQUIRE(oss.str() == "(f(1) ((2) (\"s\")) NONE)");
+}
+
+TEST_CASE( "Test expression properties", "[expression]" ) {
+
+  Expression exp(Atom("\"value\""));
+  REQUIRE(exp.properties().empty());
+  REQUIRE(exp.getProperty(SIZE_KEY) == Expression());
+
+  exp.setProperty("\"size\"", Expression(2.));
+  exp.setProperty("\"a-new-key\"", Expression(Atom("\"x\"")));
+  exp.setProperty("\"b-new-key\"", Expression(Atom("\"y\"")));
+  exp.setProperty(SIZE_KEY, Expression(3.));
+  exp.setProperty("\"a-new-key\"", Expression(Atom("\"z\"")));
+
+  REQUIRE(internPropertyKey("\"size\"") == SIZE_KEY);
+  REQUIRE(propertyKeyName(OBJECT_NAME_KEY) == "\"object-name\"");
+  REQUIRE(propertyKeyName(internPropertyKey("\"a-new-key\"")) == "\"a-new-key\"");
+
+  // graphics properties first, then replacing keeps the order the others
+  // were first set
+  auto props = exp.properties();
+  REQUIRE(props.size() == 3);
+  REQUIRE(props[0].first == SIZE_KEY);
+  REQUIRE(props[0].second == Expression(3.));
+  REQUIRE(propertyKeyName(props[1].first) == "\"a-new-key\"");
+  REQUIRE(props[1].second == Expression(Atom("\"z\"")));
+  REQUIRE(propertyKeyName(props[2].first) == "\"b-new-key\"");
+
+  REQUIRE(exp.getSize() == 3.);
+  REQUIRE(exp.getThickness() == 0.);
+  REQUIRE(!exp.isPoint());
+
+  exp.setProperty(OBJECT_NAME_KEY, Expression(Atom("\"point\"")));
+  Expression copy(exp);
+  REQUIRE(copy.isPoint());
+  REQUIRE(!copy.isLine());
+  REQUIRE(copy.getProperty(SIZE_KEY) == Expression(3.));
+  REQUIRE(copy.getProperty(OBJECT_NAME_KEY) == Expression(Atom("\"point\"")));
+
+  // expressions without properties stay small
+  REQUIRE(sizeof(Expression) <= sizeof(Atom) + sizeof(std::vector<Expression>) + sizeof(void *));
+}
+
+TEST_CASE( "Test graphics primitives", "[expression]" ) {
+
+  Expression point = makePoint(1, 2);
+  REQUIRE(point.isPoint());
+  REQUIRE(point.getX() == 1.);
+  REQUIRE(point.getY() == 2.);
+  REQUIRE(point.getSize() == 0.);
+  REQUIRE(point == Expression(std::vector<Expression>{Expression(1.), Expression(2.)}));
+
+  // values of another kind are held as ordinary properties
+  point.setProperty(SIZE_KEY, Expression(Atom("\"big\"")));
+  REQUIRE(point.getSize() == 0.);
+  REQUIRE(point.getProperty(SIZE_KEY) == Expression(Atom("\"big\"")));
+  point.setProperty(SIZE_KEY, Expression(4.));
+  REQUIRE(point.getSize() == 4.);
+  REQUIRE(point.properties().size() == 2);
+
+  point.setProperty(OBJECT_NAME_KEY, Expression(Atom("\"circle\"")));
+  REQUIRE(!point.isPoint());
+  REQUIRE(point.getProperty(OBJECT_NAME_KEY) == Expression(Atom("\"circle\"")));
+
+  Expression line = makeLine(makePoint(0, 1), makePoint(2, 3));
+  REQUIRE(line.isLine());
+  REQUIRE(line.getThickness() == 1.);
+  REQUIRE(line.tailConstBegin()->getX() == 0.);
+  REQUIRE((line.tailConstBegin() + 1)->getY() == 3.);
+
+  Expression text = makeText(Expression(Atom("\"label\"")));
+  REQUIRE(text.isText());
+  REQUIRE(text.getTextScale() == 1.);
+  REQUIRE(text.getTextRotation() == 0.);
+  REQUIRE(text.getPosition().isPoint());
+  REQUIRE(text.getX() == 0.);
+
+  // the position is held as a field, listed in key order with the others
+  std::vector<PropertyKey> fields = {OBJECT_NAME_KEY, POSITION_KEY, TEXT_SCALE_KEY, TEXT_ROTATION_KEY};
+  auto keysOf = [](const Expression & e){
+    std::vector<PropertyKey> keys;
+    for(auto & p : e.properties()) keys.push_back(p.first);
+    return keys;
+  };
+  REQUIRE(keysOf(text) == fields);
+  std::size_t fieldBytes = text.retainedBytes();
+
+  text.setProperty(POSITION_KEY, makePoint(3, 4));
+  REQUIRE(text.getX() == 3.);
+  REQUIRE(text.getY() == 4.);
+  REQUIRE(keysOf(text) == fields);
+  REQUIRE(text.retainedBytes() == fieldBytes);
+
+  // any other position is an ordinary property, after the fields
+  Expression corner(std::vector<Expression>{Expression(5.), Expression(6.)});
+  text.setProperty(POSITION_KEY, corner);
+  std::vector<PropertyKey> moved = {OBJECT_NAME_KEY, TEXT_SCALE_KEY, TEXT_ROTATION_KEY, POSITION_KEY};
+  REQUIRE(keysOf(text) == moved);
+  REQUIRE(text.retainedBytes() > fieldBytes);
+  REQUIRE(text.getPosition() == corner);
+  REQUIRE(!text.getPosition().isPoint());
+  REQUIRE(text.getX() == 5.);
+  REQUIRE(text.getY() == 6.);
+}
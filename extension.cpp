@@ -0,0 +1,142 @@
+#include "extension.hpp"
+
+#include <cctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dlfcn.h>
+
+#include "plotscript_extension.h"
+#include "semantic_error.hpp"
+
+// a registered procedure, the context of its Procedure
+struct ExtensionProcedure {
+  std::string name;
+  std::string arityError;
+  plotscript_procedure procedure;
+};
+
+typedef std::vector<std::unique_ptr<ExtensionProcedure>> ExtensionProcedures;
+
+// the libraries loaded so far, by dlopen handle, never unloaded
+std::mutex extensionMutex;
+std::map<void *, ExtensionProcedures> extensionLibraries;
+
+// a name the parser reads as a Symbol and no special form takes
+bool validName(const char * name){
+  if((name == nullptr) || (name[0] == '\0') || std::isdigit(name[0]) || (name[0] == '"')){
+    return false;
+  }
+  for(const char * c = name; *c != '\0'; ++c){
+    if(std::isspace(*c) || (*c == '(') || (*c == ')') || (*c == ';')) return false;
+  }
+  return !isSpecialForm(name);
+}
+
+int registerProcedure(plotscript_host * host, const plotscript_procedure * procedure){
+
+  auto & registered = *static_cast<ExtensionProcedures *>(host->state);
+  if((procedure == nullptr) || !validName(procedure->name) || (procedure->scalar == nullptr) ||
+     (procedure->min_args > procedure->max_args)){
+    return 1;
+  }
+  for(auto & p : registered){
+    if(p->name == procedure->name) return 1;
+  }
+
+  std::unique_ptr<ExtensionProcedure> p(new ExtensionProcedure);
+  p->name = procedure->name;
+  p->arityError = "Error in call to " + p->name + ": invalid number of arguments.";
+  p->procedure = *procedure;
+  p->procedure.name = p->name.c_str();
+  registered.push_back(std::move(p));
+  return 0;
+}
+
+Expression callExtension(const void * context, ArgSpan args){
+  auto p = static_cast<const ExtensionProcedure *>(context);
+
+  std::vector<double> values;
+  values.reserve(args.size());
+  for(auto & a : args){
+    if(!a.isHeadNumber() || (a.tailConstBegin() != a.tailConstEnd())){
+      throw SemanticError("Error in call to " + p->name + ": invalid argument.");
+    }
+    values.push_back(a.head().asNumber());
+  }
+
+  double result = 0;
+  const char * error = p->procedure.scalar(p->procedure.context, values.data(), values.size(), &result);
+  if(error != nullptr){
+    throw SemanticError("Error in call to " + p->name + ": " + error);
+  }
+  return Expression(result);
+}
+
+void mapExtension(const void * context, const double * in, double * out, std::size_t n){
+  auto p = static_cast<const ExtensionProcedure *>(context);
+
+  const char * error = p->procedure.vector(p->procedure.context, in, out, n);
+  if(error != nullptr){
+    throw SemanticError("Error in call to " + p->name + ": " + error);
+  }
+}
+
+// open and initialize the library, once
+const ExtensionProcedures & openExtension(const std::string & path){
+  std::lock_guard<std::mutex> lock(extensionMutex);
+
+  void * handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if(handle == nullptr){
+    throw SemanticError("Error during evaluation: cannot load extension: " + std::string(dlerror()));
+  }
+
+  auto loaded = extensionLibraries.find(handle);
+  if(loaded != extensionLibraries.end()){
+    // dlopen counted another reference to the same library
+    dlclose(handle);
+    return loaded->second;
+  }
+
+  auto init = reinterpret_cast<plotscript_extension_init_fn>(dlsym(handle, PLOTSCRIPT_EXTENSION_INIT));
+  if(init == nullptr){
+    dlclose(handle);
+    throw SemanticError("Error during evaluation: extension has no " PLOTSCRIPT_EXTENSION_INIT);
+  }
+
+  ExtensionProcedures registered;
+  plotscript_host host = {PLOTSCRIPT_EXTENSION_ABI_VERSION, registerProcedure, &registered};
+  if(init(&host) != 0){
+    dlclose(handle);
+    throw SemanticError("Error during evaluation: extension failed to initialize");
+  }
+
+  return extensionLibraries.emplace(handle, std::move(registered)).first->second;
+}
+
+Expression loadExtension(const std::string & path, Environment & env){
+
+  const ExtensionProcedures & registered = openExtension(path);
+
+  std::vector<Procedure> procs;
+  for(auto & p : registered){
+    procs.emplace_back(callExtension, (p->procedure.vector != nullptr) ? mapExtension : nullptr,
+		       p.get(), p->procedure.min_args, p->procedure.max_args, p->arityError.c_str());
+
+    // loading the same library again rebinds the same procedures
+    Atom sym(p->name);
+    const Procedure * bound = env.find_proc(sym);
+    if(env.is_known(sym) && !((bound != nullptr) && (*bound == procs.back()))){
+      throw SemanticError("Error during evaluation: extension procedure " + p->name + " already defined");
+    }
+  }
+
+  std::vector<Expression> names;
+  for(std::size_t i = 0; i < procs.size(); ++i){
+    env.add_proc(Atom(registered[i]->name), procs[i]);
+    names.emplace_back(Atom("\"" + registered[i]->name + "\""));
+  }
+  return Expression(names);
+}
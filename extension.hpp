@@ -0,0 +1,26 @@
+/*! \file extension.hpp
+Defines the loading of native extension modules.
+
+The C ABI an extension implements is defined in plotscript_extension.h. A
+library is opened and initialized once per process and never closed, so the
+procedures it registers stay valid in every environment they are bound in.
+ */
+#ifndef EXTENSION_HPP
+#define EXTENSION_HPP
+
+#include <string>
+
+#include "expression.hpp"
+#include "environment.hpp"
+
+/*! Load an extension library and bind its procedures in an environment
+  \param path the path of the shared library, as given to dlopen
+  \param env the environment to bind the procedures in
+  \return the names of the procedures, a list of Strings
+  \throws SemanticError if the library cannot be opened, does not export the
+  entry point or fails to initialize, or a name is already bound in env to
+  anything but the same procedure
+ */
+Expression loadExtension(const std::string & path, Environment & env);
+
+#endif
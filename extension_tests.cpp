@@ -0,0 +1,95 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "extension.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+void extensionFails(Interpreter & interp, const std::string & program, const std::string & message){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  try{
+    interp.evaluate();
+    FAIL("expected a semantic error");
+  }
+  catch(const SemanticError & ex){
+    REQUIRE(std::string(ex.what()) == message);
+  }
+}
+
+const std::string LOAD = "(load-extension \"" TEST_EXTENSION "\")";
+
+TEST_CASE( "Test load-extension binds the procedures of a library", "[extension]" ) {
+
+  Interpreter interp;
+
+  Expression names = runProgram(interp, LOAD);
+  REQUIRE(names == Expression(std::vector<Expression>{
+	Expression(Atom("\"ext-scale\"")), Expression(Atom("\"ext-vector-calls\"")),
+	  Expression(Atom("\"ext-hypot\"")), Expression(Atom("\"ext-log\""))}));
+
+  REQUIRE(runProgram(interp, "(ext-scale 2)") == Expression(6.));
+  REQUIRE(runProgram(interp, "(ext-hypot 3 4)") == Expression(5.));
+  REQUIRE(runProgram(interp, "(ext-hypot 3 4 12)") == Expression(13.));
+  REQUIRE(runProgram(interp, "(apply ext-hypot (list 5 12))") == Expression(13.));
+
+  // lambdas see them, as they see the built-in procedures
+  REQUIRE(runProgram(interp, "(begin (define f (lambda (x) (ext-scale (+ x 1)))) (f 1))") ==
+	  Expression(6.));
+
+  // loading again rebinds the same procedures
+  REQUIRE(runProgram(interp, LOAD) == names);
+  REQUIRE(runProgram(interp, "(ext-scale 1)") == Expression(3.));
+}
+
+TEST_CASE( "Test map uses the vectorized variant", "[extension]" ) {
+
+  Interpreter interp;
+  runProgram(interp, LOAD);
+
+  double before = runProgram(interp, "(ext-vector-calls 0)").head().asNumber();
+  REQUIRE(runProgram(interp, "(map ext-scale (list 1 2 3))") ==
+	  Expression(std::vector<Expression>{Expression(3.), Expression(6.), Expression(9.)}));
+  REQUIRE(runProgram(interp, "(ext-vector-calls 0)") == Expression(before + 1));
+
+  // a list that is not all Numbers is mapped an item at a time
+  extensionFails(interp, "(map ext-scale (list 1 I))", "Error in call to ext-scale: invalid argument.");
+  REQUIRE(runProgram(interp, "(ext-vector-calls 0)") == Expression(before + 1));
+
+  // procedures without one are mapped an item at a time
+  REQUIRE(runProgram(interp, "(map ext-hypot (list -1 2))") ==
+	  Expression(std::vector<Expression>{Expression(1.), Expression(2.)}));
+}
+
+TEST_CASE( "Test extension errors", "[extension]" ) {
+
+  Interpreter interp;
+
+  extensionFails(interp, "(load-extension \"no-such-extension.so\")",
+		 "Error during evaluation: cannot load extension: no-such-extension.so: "
+		 "cannot open shared object file: No such file or directory");
+  extensionFails(interp, "(load-extension 1)",
+		 "Error during evaluation: argument to load-extension not a path string");
+  extensionFails(interp, "(load-extension \"a\" \"b\")",
+		 "Error during evaluation: argument to load-extension not a path string");
+
+  // a name already defined is not replaced
+  runProgram(interp, "(define ext-log 1)");
+  extensionFails(interp, LOAD, "Error during evaluation: extension procedure ext-log already defined");
+  REQUIRE(runProgram(interp, "(+ ext-log)") == Expression(1.));
+
+  Interpreter loaded;
+  runProgram(loaded, LOAD);
+
+  // arity is checked before the operands are evaluated
+  extensionFails(loaded, "(ext-scale (define a 1) 2)", "Error in call to ext-scale: invalid number of arguments.");
+  extensionFails(loaded, "(ext-log 1 2)", "Error in call to ext-log: invalid number of arguments.");
+
+  // errors of the extension are raised
+  extensionFails(loaded, "(ext-log 0)", "Error in call to ext-log: argument must be positive.");
+  extensionFails(loaded, "(ext-log \"a\")", "Error in call to ext-log: invalid argument.");
+  REQUIRE(runProgram(loaded, "(ext-log 1)") == Expression(0.));
+}
@@ -0,0 +1,3 @@
+#include "instrument.hpp"
+
+std::atomic<unsigned> instrumentFlags(0);
@@ -0,0 +1,42 @@
+/*! \file instrument.hpp
+Defines the flags turning on the evaluation instruments: the profiler (see
+profile.hpp), the tracer (see trace.hpp) and the sampler (see sampler.hpp).
+
+The flags are bits of one word, so while every instrument is off the
+evaluator tests a single flag per call, and tests the individual flags only
+once one is on.
+ */
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+#include <atomic>
+
+/// the bits of instrumentFlags
+const unsigned PROFILE_INSTRUMENT = 1;
+const unsigned TRACE_INSTRUMENT = 2;
+const unsigned SAMPLE_INSTRUMENT = 4;
+
+/// the instruments turned on, set by setInstrument
+extern std::atomic<unsigned> instrumentFlags;
+
+/// return true if any instrument is on
+inline bool instrumented() noexcept{
+  return instrumentFlags.load(std::memory_order_relaxed) != 0;
+}
+
+/// return true if the instrument with bit instrument is on
+inline bool instrumentOn(unsigned instrument) noexcept{
+  return (instrumentFlags.load(std::memory_order_relaxed) & instrument) != 0;
+}
+
+/// turn the instrument with bit instrument on or off, leaving the others
+inline void setInstrument(unsigned instrument, bool on) noexcept{
+  if(on){
+    instrumentFlags.fetch_or(instrument, std::memory_order_relaxed);
+  }
+  else{
+    instrumentFlags.fetch_and(~instrument, std::memory_order_relaxed);
+  }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "intern.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+// the table is swept no more often than every this many new entries
+const std::size_t MIN_SWEEP = 1024;
+
+// the interned values, by hash
+class InternTable {
+public:
+
+  ExpressionHandle intern(Expression && value){
+    std::size_t h = value.hash();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = entries.equal_range(h);
+    for(auto it = range.first; it != range.second;){
+      ExpressionHandle live = it->second.lock();
+      if(!live){
+	it = entries.erase(it);
+      }
+      else if(live->identical(value)){
+	return live;
+      }
+      else{
+	++it;
+      }
+    }
+
+    ExpressionHandle handle = std::make_shared<const Expression>(std::move(value));
+    entries.emplace(h, handle);
+
+    // drop the entries of freed values once the table has doubled
+    if(entries.size() >= sweepAt){
+      sweep();
+      sweepAt = std::max(MIN_SWEEP, 2*entries.size());
+    }
+    return handle;
+  }
+
+  std::size_t size(){
+    std::lock_guard<std::mutex> lock(mutex);
+    sweep();
+    return entries.size();
+  }
+
+private:
+
+  void sweep(){
+    for(auto it = entries.begin(); it != entries.end();){
+      if(it->second.expired()){
+	it = entries.erase(it);
+      }
+      else{
+	++it;
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::unordered_multimap<std::size_t, std::weak_ptr<const Expression>> entries;
+  std::size_t sweepAt = MIN_SWEEP;
+};
+
+InternTable & internTable(){
+  static InternTable table;
+  return table;
+}
+
+ExpressionHandle internExpression(Expression value){
+  return internTable().intern(std::move(value));
+}
+
+std::size_t internedExpressions(){
+  return internTable().size();
+}
@@ -0,0 +1,35 @@
+/*! \file intern.hpp
+Defines hash-consing of immutable Expressions.
+
+internExpression returns a shared handle to a value, the same handle for
+every identical value (Expression::identical) while any handle to it is
+alive. The table holds its entries weakly, keyed by Expression::hash, so a
+value is freed once the last handle to it goes. Handles to interned values
+are equal exactly when the values are identical, an O(1) comparison.
+
+The table is shared by all threads.
+ */
+#ifndef INTERN_HPP
+#define INTERN_HPP
+
+#include <cstddef>
+#include <memory>
+
+#include "expression.hpp"
+
+/*! \typedef ExpressionHandle
+\brief A shared reference to an immutable Expression.
+*/
+typedef std::shared_ptr<const Expression> ExpressionHandle;
+
+/*! Return the shared handle of a value, interning it if no identical value
+  is interned
+  \param value the value, moved from if it is interned
+  \return the handle shared by all identical values
+ */
+ExpressionHandle internExpression(Expression value);
+
+/// return the number of values interned and still alive
+std::size_t internedExpressions();
+
+#endif
@@ -0,0 +1,89 @@
+#include "catch.hpp"
+
+#include <sstream>
+
+#include "intern.hpp"
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "scan.hpp"
+
+TEST_CASE( "Test identical and hash", "[intern]" ) {
+
+  Expression a(std::vector<Expression>{Expression(1.), Expression(Atom("\"s\""))});
+  Expression b(a);
+  REQUIRE(a.identical(b));
+  REQUIRE(a.hash() == b.hash());
+
+  // properties take part, unlike operator==
+  b.setProperty("\"note\"", Expression(2.));
+  REQUIRE(a == b);
+  REQUIRE(!a.identical(b));
+
+  REQUIRE(makePoint(1, 2).identical(makePoint(1, 2)));
+  REQUIRE(makePoint(1, 2).hash() == makePoint(1, 2).hash());
+  REQUIRE(!makePoint(1, 2).identical(makePoint(1, 3)));
+  REQUIRE(!makePoint(0, 0).identical(Expression(std::vector<Expression>{Expression(0.), Expression(0.)})));
+
+  // numbers are compared exactly
+  REQUIRE(Expression(1.) == Expression(1. + 1e-16));
+  REQUIRE(!Expression(1.).identical(Expression(1. + 1e-15)));
+  REQUIRE(Expression(std::complex<double>(1, 2)).identical(Expression(std::complex<double>(1, 2))));
+}
+
+TEST_CASE( "Test interning shares identical values", "[intern]" ) {
+
+  std::size_t before = internedExpressions();
+  {
+    ExpressionHandle a = internExpression(makeLine(makePoint(0, 0), makePoint(1, 1)));
+    ExpressionHandle b = internExpression(makeLine(makePoint(0, 0), makePoint(1, 1)));
+    ExpressionHandle c = internExpression(makeLine(makePoint(0, 0), makePoint(1, 2)));
+
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(a->isLine());
+    REQUIRE(internedExpressions() == before + 2);
+  }
+
+  // the table does not keep values alive
+  REQUIRE(internedExpressions() == before);
+}
+
+TEST_CASE( "Test environment values are interned", "[intern]" ) {
+
+  // the built-in values of an environment are interned already
+  Environment builtins;
+  std::size_t before = internedExpressions();
+  {
+    Interpreter interp;
+    std::istringstream iss("(begin (define a (list 1 2 (list 3 \"x\"))) (define b (list 1 2 (list 3 \"x\"))) (define c (list 1 2)))");
+    REQUIRE(interp.parseStream(iss));
+    interp.evaluate();
+
+    REQUIRE(internedExpressions() == before + 2);
+
+    std::istringstream more("(first (rest (rest b)))");
+    REQUIRE(interp.parseStream(more));
+    REQUIRE(interp.evaluate() == Expression(std::vector<Expression>{Expression(3.), Expression(Atom("\"x\""))}));
+  }
+  REQUIRE(internedExpressions() == before);
+}
+
+// a built-in returning the number of interned values
+Expression countInterned(ArgSpan){
+  return Expression(static_cast<double>(internedExpressions()));
+}
+
+TEST_CASE( "Test lambda scopes are not interned", "[intern]" ) {
+
+  Environment env;
+  env.add_proc(Atom("count-interned"), Procedure(countInterned, 1, 1));
+  Expression define = parseFast("(define f (lambda (x) (begin (define y (list x 7)) (count-interned 0))))");
+  REQUIRE(!define.head().isNone());
+  define.eval(env);
+
+  std::size_t before = internedExpressions();
+  Expression call = parseFast("(f (list 5 6))");
+  REQUIRE(!call.head().isNone());
+  REQUIRE(call.eval(env) == Expression(static_cast<double>(before)));
+  REQUIRE(env.get_exp(Atom("x")).head().isNone());
+}
@@ -1,25 +1,90 @@
 #include "interpreter.hpp"
 
 // system includes
+#include <iterator>
 #include <stdexcept>
 
 // module includes
 #include "token.hpp"
 #include "parse.hpp"
+#include "scan.hpp"
+#include "optimize.hpp"
+#include "scratch.hpp"
+#include "serialize.hpp"
 #include "expression.hpp"
 #include "environment.hpp"
 #include "semantic_error.hpp"
+#include "trace.hpp"
+
+// parse text and optimize it in env, the front end shared by parseStream
+// and parseNext
+Expression parseAndOptimize(const std::string & text, const Environment & env) noexcept{
+  Expression parsed;
+  {
+    TraceSpan span("parse", "front end");
+    parsed = parseFast(text);
+  }
+  TraceSpan span("optimize", "front end");
+  return optimize(parsed, env);
+}
 
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  TokenSequenceType tokens = tokenize(expression);
+  // the structural scanner needs the whole buffer; tokenize() reads it
+  // all before parsing anyway
+  std::string text((std::istreambuf_iterator<char>(expression)),
+                   std::istreambuf_iterator<char>());
 
-  ast = parse(tokens);
+  ast = parseAndOptimize(text, env);
 
-  return (ast != Expression());
+  // a failed parse is the None expression, no parsed program has a None head
+  return !ast.head().isNone();
 };
+
+bool Interpreter::parseNext(std::istream & stream, bool & ok) noexcept{
+
+  std::string form;
+  if(!readForm(stream, form)){
+    ok = false;
+    return false;
+  }
+
+  ast = parseAndOptimize(form, env);
+
+  ok = !ast.head().isNone();
+  return true;
+}
 				     
 
+bool Interpreter::parseImage(const char * data, std::size_t size) noexcept{
+
+  BindingList bindings;
+  if(!decodeBindings(data, size, bindings) || (bindings.size() != 1)){
+    ast = Expression();
+    return false;
+  }
+
+  ast = optimize(bindings[0].second, env);
+  return true;
+}
+
 Expression Interpreter::evaluate(){
+  // the temporaries of this evaluation share one pool of buffers
+  ScratchScope scratch;
+  TraceSpan span("eval", "eval");
   return ast.eval(env);
 }
+
+BindingList Interpreter::definitions() const{
+  return env.definitions();
+}
+
+RetainedSizes Interpreter::retainedSizes() const{
+  return env.retainedSizes();
+}
+
+void Interpreter::bind(const BindingList & bindings){
+  for(auto & b : bindings){
+    env.add_exp(Atom(b.first), b.second);
+  }
+}
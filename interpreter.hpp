@@ -20,7 +20,9 @@ It maintains an environment during evaluation.
 \brief Class to parse and evaluate an expression (program)
 
 Interpreter has an Environment, which starts at a default.
-The parse method builds an internal AST.
+The parse method builds an internal AST, either from a whole stream or one
+top-level form at a time, and optimizes it (see optimize.hpp) against the
+current Environment.
 The eval method updates Environment and returns last result.
 */
 class Interpreter {
@@ -32,12 +34,44 @@ public:
    */
   bool parseStream(std::istream &expression) noexcept;
 
+  /*! Parse the next top-level form of a stream into an internal Expression,
+    reading no further than the end of that form
+    \param stream the raw text stream holding zero or more forms
+    \param ok set to true on successful parsing of the form
+    \return false once the stream holds no further forms
+   */
+  bool parseNext(std::istream &stream, bool &ok) noexcept;
+
+  /*! Rebuild the internal Expression from an encoded AST (see serialize.hpp)
+    \param data pointer to the first byte of the encoded AST
+    \param size the number of bytes of the encoded AST
+    \return true on successful decoding
+   */
+  bool parseImage(const char * data, std::size_t size) noexcept;
+
   /*! Evaluate the Expression by walking the tree, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
   Expression evaluate();
 
+  /*! Collect the definitions made in the environment during evaluation.
+    \return the (symbol, expression) pairs beyond the built-in ones
+   */
+  BindingList definitions() const;
+
+  /*! Measure the values bound in the environment
+    \return the (symbol, bytes) pairs in symbol order
+   */
+  RetainedSizes retainedSizes() const;
+
+  /*! Bind symbols directly in the environment, without parsing or evaluation.
+    \param bindings the (symbol, expression) pairs to add, replacing any
+           existing definition of the same symbol
+    \throws SemanticError if a symbol name is not a valid symbol
+   */
+  void bind(const BindingList & bindings);
+
 private:
 
   // the environment
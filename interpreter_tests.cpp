@@ -735,3 +735,200 @@ TEST_CASE( "Test using number as procedure", "[interpreter]" ) {
   
   REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
 }
+
+TEST_CASE( "Test Interpreter parsing and evaluating one form at a time", "[interpreter]" ) {
+
+  std::string program = R"(
+(define a 1)
+; a comment between forms
+(define b (+ a 1))
+(+ a b
+(* 2 b)
+)";
+
+  std::istringstream iss(program);
+  Interpreter interp;
+  bool ok;
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(ok);
+  REQUIRE(interp.evaluate() == Expression(1.));
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(ok);
+  REQUIRE(interp.evaluate() == Expression(2.));
+
+  // an unterminated form consumes the rest of the stream
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(!ok);
+
+  REQUIRE(!interp.parseNext(iss, ok));
+}
+
+TEST_CASE( "Test Interpreter continues after a form that fails to parse", "[interpreter]" ) {
+
+  std::string program = "(define a 1) ) 1abc (+ a 2)";
+
+  std::istringstream iss(program);
+  Interpreter interp;
+  bool ok;
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(ok);
+  REQUIRE(interp.evaluate() == Expression(1.));
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(!ok);
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(!ok);
+
+  REQUIRE(interp.parseNext(iss, ok));
+  REQUIRE(ok);
+  REQUIRE(interp.evaluate() == Expression(3.));
+
+  REQUIRE(!interp.parseNext(iss, ok));
+}
+
+// (+ 1 (+ 1 ... (+ 1 1)))
+std::string nestedSum(std::size_t depth){
+  std::string program;
+  for(std::size_t i = 0; i < depth; ++i){
+    program += "(+ 1 ";
+  }
+  program += "1" + std::string(depth, ')');
+  return program;
+}
+
+TEST_CASE( "Test Interpreter evaluates deeply nested expressions", "[interpreter]" ) {
+
+  Interpreter interp;
+
+  std::istringstream sum(nestedSum(50000));
+  REQUIRE(interp.parseStream(sum));
+  REQUIRE(interp.evaluate() == Expression(50001.));
+
+  std::string program;
+  for(std::size_t i = 0; i < 20000; ++i){
+    program += "(set-property \"p" + std::to_string(i % 3) + "\" " + std::to_string(i) + " ";
+  }
+  program += "(list 1 2)" + std::string(20000, ')');
+
+  std::istringstream props(program);
+  REQUIRE(interp.parseStream(props));
+  Expression result = interp.evaluate();
+  REQUIRE(result == Expression(std::vector<Expression>{Expression(1.), Expression(2.)}));
+
+  std::istringstream get("(get-property \"p0\" (begin (define a (list 3)) (set-property \"p0\" a a)))");
+  REQUIRE(interp.parseStream(get));
+  REQUIRE(interp.evaluate() == Expression(std::vector<Expression>{Expression(3.)}));
+}
+
+TEST_CASE( "Test Interpreter evaluation depth limit", "[interpreter]" ) {
+
+  Interpreter interp;
+  setEvalDepthLimit(1000);
+
+  std::istringstream deep(nestedSum(2000));
+  REQUIRE(interp.parseStream(deep));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  // the depth is restored after the error
+  std::istringstream shallow(nestedSum(900));
+  REQUIRE(interp.parseStream(shallow));
+  REQUIRE(interp.evaluate() == Expression(901.));
+
+  setEvalDepthLimit(DEFAULT_EVAL_DEPTH_LIMIT);
+  REQUIRE(getEvalDepthLimit() == DEFAULT_EVAL_DEPTH_LIMIT);
+}
+
+TEST_CASE( "Test Interpreter checks built-in arity before evaluating operands", "[interpreter]" ) {
+
+  Interpreter interp;
+
+  std::istringstream call("(first (define a (list 1)) (define b 2))");
+  REQUIRE(interp.parseStream(call));
+  try{
+    interp.evaluate();
+    FAIL("expected a SemanticError");
+  }
+  catch(const SemanticError & error){
+    REQUIRE(std::string(error.what()) == "Error in call to first: invalid number of arguments.");
+  }
+
+  // neither define was evaluated
+  std::istringstream lookup("(list a)");
+  REQUIRE(interp.parseStream(lookup));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  // through map and apply the arity is checked at each call
+  std::istringstream mapped("(map range (list 1 2))");
+  REQUIRE(interp.parseStream(mapped));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  std::istringstream applied("(apply first (list (list 1 2) 3))");
+  REQUIRE(interp.parseStream(applied));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  std::istringstream fine("(apply join (list (list 1) (list 2 3)))");
+  REQUIRE(interp.parseStream(fine));
+  REQUIRE(interp.evaluate() == Expression(std::vector<Expression>{Expression(1.), Expression(2.), Expression(3.)}));
+}
+
+TEST_CASE( "Test Interpreter lambda calls inside map and apply", "[interpreter]" ) {
+
+  std::string program = "(begin (define f (lambda (x) (* x 2))) (define g (lambda (x y) (+ (f x) y))) (list (map f (list 1 2 3)) (apply g (list 4 5)) (map - (list 1 2))))";
+  INFO(program);
+  Expression result = run(program);
+
+  Expression expected(std::vector<Expression>{
+      Expression(std::vector<Expression>{Expression(2.), Expression(4.), Expression(6.)}),
+      Expression(13.),
+      Expression(std::vector<Expression>{Expression(-1.), Expression(-2.)})});
+  REQUIRE(result == expected);
+}
+
+TEST_CASE( "Test Interpreter graphics primitives", "[interpreter]" ) {
+
+  Expression point = run("(make-point 1 2)");
+  REQUIRE(point.isPoint());
+  REQUIRE(point.getX() == 1.);
+  REQUIRE(point.getY() == 2.);
+
+  // the property special-forms still see the graphics properties
+  REQUIRE(run("(get-property \"object-name\" (make-point 1 2))") == Expression(Atom("\"point\"")));
+  REQUIRE(run("(get-property \"thickness\" (make-line (make-point 0 0) (make-point 1 1)))") == Expression(1.));
+  REQUIRE(run("(get-property \"position\" (make-text \"a\"))").isPoint());
+  REQUIRE(run("(get-property \"size\" (set-property \"size\" \"big\" (make-point 0 0)))") == Expression(Atom("\"big\"")));
+  REQUIRE(run("(set-property \"object-name\" \"point\" (list 3 4))").isPoint());
+
+  // the plots are built from the same primitives
+  Expression plot = run("(discrete-plot (list (list -1 -1) (list 1 1)) (list))");
+  REQUIRE(plot.tailConstBegin()->isPoint());
+  REQUIRE((plot.tailConstBegin() + 1)->isLine());
+
+  // any arguments are accepted, as the make-* lambdas accepted them
+  Expression loose = run("(make-point \"a\" 2)");
+  REQUIRE(loose == Expression(std::vector<Expression>{Expression(Atom("\"a\"")), Expression(2.)}));
+  REQUIRE(loose.isPoint());
+  REQUIRE(run("(get-property \"size\" (make-point \"a\" 2))") == Expression(0.));
+  Expression line = run("(make-line 1 2)");
+  REQUIRE(line == Expression(std::vector<Expression>{Expression(1.), Expression(2.)}));
+  REQUIRE(line.isLine());
+  REQUIRE(run("(get-property \"thickness\" (make-line (make-point 0 0) 5))") == Expression(1.));
+  Expression text = run("(make-text 3)");
+  REQUIRE(text == Expression(3.));
+  REQUIRE(text.isText());
+
+  std::vector<std::string> programs = {"(make-point 1)",
+				       "(make-point 1 2 3)",
+				       "(make-line 1)",
+				       "(make-text \"a\" \"b\")"};
+  for(auto s : programs){
+    INFO(s);
+    Interpreter interp;
+    std::istringstream iss(s);
+    REQUIRE(interp.parseStream(iss));
+    REQUIRE_THROWS_WITH(interp.evaluate(), "Error: during apply : Error in call to procedure : invalid number of arguments.");
+  }
+}
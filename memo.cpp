@@ -0,0 +1,244 @@
+#include "memo.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+PropertyKey memoizedKey(){
+  static const PropertyKey key = internPropertyKey("\"memoized\"");
+  return key;
+}
+
+// combine a value into a running hash
+inline void combine(std::size_t & h, std::size_t value){
+  h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+}
+
+// the symbols of the body of a lambda other than its parameters and the
+// special forms, which the body may look up in the calling environment
+std::set<std::string> freeSymbols(const Expression & lambda){
+
+  std::set<std::string> params;
+  const Expression & list = *lambda.tailConstBegin();
+  for(auto p = list.tailConstBegin(); p != list.tailConstEnd(); ++p){
+    params.insert(p->head().asSymbol());
+  }
+
+  std::set<std::string> symbols;
+  std::vector<const Expression *> pending = {&*(lambda.tailConstEnd() - 1)};
+  while(!pending.empty()){
+    const Expression & e = *pending.back();
+    pending.pop_back();
+
+    bool call = e.tailConstBegin() != e.tailConstEnd();
+    if(e.isHeadSymbol()){
+      const std::string & name = e.head().asSymbol();
+      if(!(call && isSpecialForm(name)) && !params.count(name)){
+	symbols.insert(name);
+      }
+    }
+
+    auto t = e.tailConstBegin();
+    // the parameters of a nested lambda are not looked up
+    if(call && e.isHeadSymbol() && (e.head().asSymbol() == "lambda")) ++t;
+    for(; t != e.tailConstEnd(); ++t){
+      pending.push_back(&*t);
+    }
+  }
+  return symbols;
+}
+
+// the free symbols of a lambda, as recorded by memoize if it is memoized
+std::vector<std::string> lookupSymbols(const Expression & lambda){
+  std::vector<std::string> names;
+
+  Expression recorded = lambda.getProperty(memoizedKey());
+  if(recorded.isHeadList()){
+    for(auto s = recorded.tailConstBegin(); s != recorded.tailConstEnd(); ++s){
+      names.push_back(s->head().asSymbol());
+    }
+  }
+  else{
+    std::set<std::string> symbols = freeSymbols(lambda);
+    names.assign(symbols.begin(), symbols.end());
+  }
+  return names;
+}
+
+Expression memoize(const Expression & lambda){
+
+  std::vector<Expression> symbols;
+  for(auto & name : freeSymbols(lambda)){
+    symbols.emplace_back(Atom(name));
+  }
+
+  Expression result(lambda);
+  result.setProperty(memoizedKey(), Expression(symbols));
+  return result;
+}
+
+MemoKey makeMemoKey(const ExpressionHandle & lambda, ArgSpan args,
+		    const Environment & env){
+
+  MemoKey key;
+  key.bindings.push_back(lambda);
+  key.args.assign(args.begin(), args.end());
+
+  // the free symbols, and those of the lambdas they name, in the order met
+  std::set<std::string> seen;
+  std::vector<std::string> pending = lookupSymbols(*lambda);
+  std::reverse(pending.begin(), pending.end());
+  while(!pending.empty()){
+    std::string name = std::move(pending.back());
+    pending.pop_back();
+    if(!seen.insert(name).second) continue;
+
+    // nullptr for a procedure or unbound
+    key.bindings.push_back(env.get_handle(Atom(name)));
+    const ExpressionHandle & value = key.bindings.back();
+    if(value && value->head().isLambda()){
+      std::vector<std::string> more = lookupSymbols(*value);
+      pending.insert(pending.end(), more.rbegin(), more.rend());
+    }
+  }
+
+  key.hash = 0;
+  for(auto & b : key.bindings){
+    combine(key.hash, std::hash<const Expression *>()(b.get()));
+  }
+  for(auto & a : key.args){
+    combine(key.hash, a.hash());
+  }
+  return key;
+}
+
+// the cached results, most recently used first
+class MemoCache {
+public:
+
+  bool lookup(const MemoKey & key, Expression & value){
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = find(key);
+    if(it == entries.end()){
+      ++misses;
+      return false;
+    }
+
+    entries.splice(entries.begin(), entries, it);
+    value = it->value;
+    ++hits;
+    return true;
+  }
+
+  void store(MemoKey && key, const Expression & value){
+    std::lock_guard<std::mutex> lock(mutex);
+    if(capacity == 0) return;
+
+    auto it = find(key);
+    if(it != entries.end()){
+      entries.splice(entries.begin(), entries, it);
+      return;
+    }
+
+    std::size_t h = key.hash;
+    entries.push_front(Entry{std::move(key), value});
+    index.emplace(h, entries.begin());
+    trim();
+  }
+
+  MemoStats stats(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return MemoStats{entries.size(), capacity, hits, misses, evictions};
+  }
+
+  void clear(){
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    hits = misses = evictions = 0;
+  }
+
+  void resize(std::size_t n){
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = n;
+    trim();
+  }
+
+private:
+
+  struct Entry {
+    MemoKey key;
+    Expression value;
+  };
+  typedef std::list<Entry>::iterator EntryIterator;
+
+  EntryIterator find(const MemoKey & key){
+    auto range = index.equal_range(key.hash);
+    for(auto i = range.first; i != range.second; ++i){
+      const MemoKey & other = i->second->key;
+      if((other.bindings != key.bindings) || (other.args.size() != key.args.size())) continue;
+
+      bool same = true;
+      for(std::size_t k = 0; same && (k < key.args.size()); ++k){
+	same = other.args[k].identical(key.args[k]);
+      }
+      if(same) return i->second;
+    }
+    return entries.end();
+  }
+
+  // evict the least recently used entries beyond capacity
+  void trim(){
+    while(entries.size() > capacity){
+      EntryIterator last = std::prev(entries.end());
+      auto range = index.equal_range(last->key.hash);
+      for(auto i = range.first; i != range.second; ++i){
+	if(i->second == last){
+	  index.erase(i);
+	  break;
+	}
+      }
+      entries.pop_back();
+      ++evictions;
+    }
+  }
+
+  std::mutex mutex;
+  std::list<Entry> entries;
+  std::unordered_multimap<std::size_t, EntryIterator> index;
+  std::size_t capacity = DEFAULT_MEMO_CAPACITY;
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t evictions = 0;
+};
+
+MemoCache & memoCache(){
+  static MemoCache cache;
+  return cache;
+}
+
+bool lookupMemo(const MemoKey & key, Expression & value){
+  return memoCache().lookup(key, value);
+}
+
+void storeMemo(MemoKey key, const Expression & value){
+  memoCache().store(std::move(key), value);
+}
+
+MemoStats memoStats(){
+  return memoCache().stats();
+}
+
+void clearMemo(){
+  memoCache().clear();
+}
+
+void setMemoCapacity(std::size_t capacity){
+  memoCache().resize(capacity);
+}
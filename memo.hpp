@@ -0,0 +1,93 @@
+/*! \file memo.hpp
+Defines the cache of results of memoized lambdas.
+
+(memoize f) returns the lambda f marked with the "memoized" property, whose
+value lists the free symbols of its body. A call of a marked lambda first
+looks for its result in a bounded cache, least recently used entries being
+evicted, and stores the result on a miss. Calls that raise an error are not
+stored.
+
+Lambdas are called in a copy of the calling environment, so the result of a
+call can depend on whatever its free symbols are bound to there. The key of
+a call is therefore the lambda, its arguments, and the values its free
+symbols (and those of any lambda they name) have in the calling environment.
+The lambda and the free values are keyed by the identity of their bindings
+(see intern.hpp), which the key holds, so building and comparing a key does
+not copy or hash them however large they are; only the arguments are
+compared by value. A value bound in the scope of an enclosing call is not
+interned, so a call under another activation of that scope misses.
+
+The cache is shared by all threads.
+ */
+#ifndef MEMO_HPP
+#define MEMO_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "expression.hpp"
+#include "environment.hpp"
+#include "intern.hpp"
+
+/// the default number of results kept
+const std::size_t DEFAULT_MEMO_CAPACITY = 4096;
+
+/// the counters of the memo cache
+struct MemoStats {
+  std::size_t entries;
+  std::size_t capacity;
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t evictions;
+};
+
+/// the key of a call of a memoized lambda
+struct MemoKey {
+  std::vector<ExpressionHandle> bindings; // the lambda, then the free values, nullptr if not bound to one
+  std::vector<Expression> args;
+  std::size_t hash;
+};
+
+/// return the key of the property marking a memoized lambda
+PropertyKey memoizedKey();
+
+/*! Mark a lambda as memoized
+  \param lambda the lambda value
+  \return the lambda with the "memoized" property set to its free symbols
+ */
+Expression memoize(const Expression & lambda);
+
+/*! Build the key of a call of a memoized lambda
+  \param lambda the binding of the lambda in env
+  \param args the argument values
+  \param env the environment of the call
+ */
+MemoKey makeMemoKey(const ExpressionHandle & lambda, ArgSpan args,
+		    const Environment & env);
+
+/*! Look up the result of a call, counting a hit or a miss
+  \param key the key of the call
+  \param value set to the result on a hit
+  \return true on a hit
+ */
+bool lookupMemo(const MemoKey & key, Expression & value);
+
+/*! Store the result of a call, evicting the least recently used result if
+  the cache is full
+  \param key the key of the call
+  \param value the result
+ */
+void storeMemo(MemoKey key, const Expression & value);
+
+/// return the current counters
+MemoStats memoStats();
+
+/// drop every cached result and zero the counters
+void clearMemo();
+
+/*! Set the number of results kept, evicting any beyond it
+  \param capacity the new capacity, 0 disables caching
+ */
+void setMemoCapacity(std::size_t capacity);
+
+#endif
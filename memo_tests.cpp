@@ -0,0 +1,157 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "memo.hpp"
+#include "directive.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE( "Test memoize caches lambda results", "[memo]" ) {
+
+  clearMemo();
+  Interpreter interp;
+
+  Expression f = runProgram(interp, "(define f (memoize (lambda (x) (* x x))))");
+  REQUIRE(f.head().isLambda());
+  REQUIRE(f.getProperty(memoizedKey()).isHeadList());
+
+  REQUIRE(runProgram(interp, "(map f (list 1 2 1 2 1))") ==
+	  Expression(std::vector<Expression>{Expression(1.), Expression(4.), Expression(1.),
+		Expression(4.), Expression(1.)}));
+  MemoStats stats = memoStats();
+  REQUIRE(stats.misses == 2);
+  REQUIRE(stats.hits == 3);
+  REQUIRE(stats.entries == 2);
+
+  REQUIRE(runProgram(interp, "(+ (f 2) (apply f (list 2)))") == Expression(8.));
+  REQUIRE(memoStats().hits == 5);
+
+  // complex, string and list arguments are keys too
+  runProgram(interp, "(define g (memoize (lambda (x) x)))");
+  REQUIRE(runProgram(interp, "(g (list 1 I \"a\"))") == runProgram(interp, "(g (list 1 I \"a\"))"));
+  REQUIRE(runProgram(interp, "(g (list 1 I \"b\"))") != runProgram(interp, "(g (list 1 I \"a\"))"));
+
+  // an unmarked lambda is not cached
+  stats = memoStats();
+  runProgram(interp, "(define h (lambda (x) (* x x)))");
+  runProgram(interp, "(map h (list 1 1))");
+  REQUIRE(memoStats().hits == stats.hits);
+  REQUIRE(memoStats().misses == stats.misses);
+}
+
+TEST_CASE( "Test memoize keys on free symbols", "[memo]" ) {
+
+  clearMemo();
+  Interpreter interp;
+
+  runProgram(interp, "(begin (define k 2) (define f (memoize (lambda (x) (* x k)))))");
+  REQUIRE(runProgram(interp, "(f 3)") == Expression(6.));
+
+  // lambdas see the bindings of their caller
+  runProgram(interp, "(define g (lambda (k) (f 3)))");
+  REQUIRE(runProgram(interp, "(g 10)") == Expression(30.));
+  REQUIRE(runProgram(interp, "(f 3)") == Expression(6.));
+
+  // including through the lambdas the body calls
+  runProgram(interp, "(begin (define s (lambda (x) (+ x k))) (define t (memoize (lambda (x) (s x)))))");
+  REQUIRE(runProgram(interp, "(t 1)") == Expression(3.));
+  REQUIRE(runProgram(interp, "(g 10)") == Expression(30.));
+  runProgram(interp, "(define u (lambda (k) (t 1)))");
+  REQUIRE(runProgram(interp, "(u 5)") == Expression(6.));
+}
+
+TEST_CASE( "Test memoize keys on the bindings of captured values", "[memo]" ) {
+
+  clearMemo();
+  Environment env;
+  env.add_exp(Atom("table"), Expression(std::vector<Expression>(1000, Expression(1.))));
+  env.add_exp(Atom("f"), memoize(Expression(std::vector<Expression>{
+	  Expression(std::vector<Expression>{Expression(Atom("x"))}),
+	  Expression(std::vector<Expression>{Expression(Atom("table")), Expression(Atom("x"))}, Atom("list"))},
+      Atom("lambda"))));
+
+  // the key holds the bindings themselves, not copies
+  Expression arg(2.);
+  MemoKey key = makeMemoKey(env.get_handle(Atom("f")), ArgSpan(&arg, 1), env);
+  // the lambda, then list (a procedure) and table in symbol order
+  REQUIRE(key.bindings.size() == 3);
+  REQUIRE(key.bindings[0] == env.get_handle(Atom("f")));
+  REQUIRE(!key.bindings[1]);
+  REQUIRE(key.bindings[2] == env.get_handle(Atom("table")));
+  storeMemo(key, Expression(1.));
+  Expression value;
+  REQUIRE(lookupMemo(makeMemoKey(env.get_handle(Atom("f")), ArgSpan(&arg, 1), env), value));
+
+  // an identical table shares the interned binding, a different one does not
+  env.add_exp(Atom("table"), Expression(std::vector<Expression>(1000, Expression(1.))));
+  REQUIRE(lookupMemo(makeMemoKey(env.get_handle(Atom("f")), ArgSpan(&arg, 1), env), value));
+  env.add_exp(Atom("table"), Expression(std::vector<Expression>(1000, Expression(2.))));
+  REQUIRE(!lookupMemo(makeMemoKey(env.get_handle(Atom("f")), ArgSpan(&arg, 1), env), value));
+}
+
+TEST_CASE( "Test memoize errors and eviction", "[memo]" ) {
+
+  clearMemo();
+  Interpreter interp;
+
+  std::istringstream bad("(memoize 1)");
+  REQUIRE(interp.parseStream(bad));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  std::istringstream many("(memoize (lambda (x) x) (lambda (x) x))");
+  REQUIRE(interp.parseStream(many));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  // failed calls are not cached
+  runProgram(interp, "(define f (memoize (lambda (x) (first x))))");
+  for(int i = 0; i < 2; ++i){
+    std::istringstream call("(f (list))");
+    REQUIRE(interp.parseStream(call));
+    REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  }
+  REQUIRE(memoStats().entries == 0);
+
+  setMemoCapacity(2);
+  runProgram(interp, "(map f (list (list 1) (list 2) (list 3)))");
+  MemoStats stats = memoStats();
+  REQUIRE(stats.entries == 2);
+  REQUIRE(stats.evictions == 1);
+
+  // the least recently used went
+  runProgram(interp, "(f (list 3))");
+  runProgram(interp, "(f (list 1))");
+  REQUIRE(memoStats().hits == stats.hits + 1);
+
+  setMemoCapacity(DEFAULT_MEMO_CAPACITY);
+  clearMemo();
+}
+
+TEST_CASE( "Test memo directive", "[memo]" ) {
+
+  clearMemo();
+  Interpreter interp;
+  std::string reply;
+
+  runProgram(interp, "(begin (define f (memoize (lambda (x) (+ x 1)))) (map f (list 1 1)))");
+
+  REQUIRE(handleDirective(interp, "%memo", reply));
+  REQUIRE(reply == "Memo cache: 1 of 4096 entries, 1 hits, 1 misses, 0 evictions.");
+
+  REQUIRE(handleDirective(interp, "%memo capacity 10", reply));
+  REQUIRE(memoStats().capacity == 10);
+  REQUIRE(handleDirective(interp, "%memo capacity ten", reply));
+  REQUIRE(reply.find("Error") == 0);
+  REQUIRE(handleDirective(interp, "%memo capacity", reply));
+  REQUIRE(reply.find("Error") == 0);
+  REQUIRE(handleDirective(interp, "%memo flush", reply));
+  REQUIRE(reply.find("Error") == 0);
+
+  REQUIRE(handleDirective(interp, "%memo clear", reply));
+  REQUIRE(memoStats().entries == 0);
+  REQUIRE(memoStats().hits == 0);
+
+  setMemoCapacity(DEFAULT_MEMO_CAPACITY);
+}
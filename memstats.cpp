@@ -0,0 +1,105 @@
+#include "memstats.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+// the counters of every thread, kept after a thread exits as the objects
+// it made may outlive it
+struct CounterRegistry {
+  std::mutex mutex;
+  std::vector<ThreadMemoryCounters *> counters;
+};
+
+// constructed on first use, as static objects of other files count
+// themselves during static initialization, and never destroyed, as threads
+// and static objects count themselves until the process ends
+CounterRegistry & counterRegistry(){
+  static CounterRegistry * registry = new CounterRegistry;
+  return *registry;
+}
+
+ThreadMemoryCounters * registerMemoryCounters(){
+  ThreadMemoryCounters * counters = new ThreadMemoryCounters();
+  for(auto & v : counters->values){
+    v.store(0, std::memory_order_relaxed);
+  }
+
+  CounterRegistry & registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.counters.push_back(counters);
+  threadMemoryCounters() = counters;
+  return counters;
+}
+
+std::int64_t memoryCounter(MemoryCounter counter) noexcept{
+  CounterRegistry & registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::int64_t sum = 0;
+  for(auto counters : registry.counters){
+    sum += counters->values[counter].load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+const char * memoryCounterName(MemoryCounter counter) noexcept{
+  static const char * names[MemoryCounterCount] = {
+    "expressions", "atoms", "tail-bytes", "property-bytes", "string-bytes", "complex-bytes"};
+  return names[counter];
+}
+
+// the sizes, the largest first
+RetainedSizes sortedSizes(RetainedSizes sizes){
+  std::stable_sort(sizes.begin(), sizes.end(), [](const RetainedSizes::value_type & a,
+						  const RetainedSizes::value_type & b){
+		     return a.second > b.second;
+		   });
+  return sizes;
+}
+
+Expression memoryStats(const Environment & env){
+
+  std::vector<Expression> stats;
+  for(int c = 0; c < MemoryCounterCount; ++c){
+    MemoryCounter counter = static_cast<MemoryCounter>(c);
+    stats.emplace_back(std::vector<Expression>{
+	Expression(Atom("\"" + std::string(memoryCounterName(counter)) + "\"")),
+	  Expression(static_cast<double>(memoryCounter(counter)))});
+  }
+
+  std::vector<Expression> bindings;
+  for(auto & size : sortedSizes(env.retainedSizes())){
+    bindings.emplace_back(std::vector<Expression>{
+	Expression(Atom("\"" + size.first + "\"")), Expression(static_cast<double>(size.second))});
+  }
+  stats.emplace_back(std::vector<Expression>{Expression(Atom("\"bindings\"")), Expression(bindings)});
+
+  return Expression(stats);
+}
+
+std::string formatMemoryStats(const RetainedSizes & sizes, std::size_t top){
+
+  std::ostringstream out;
+  out << "Memory: " << memoryCounter(LiveExpressions) << " expressions, "
+      << memoryCounter(LiveAtoms) << " atoms; heap bytes: "
+      << memoryCounter(TailBytes) << " tails, "
+      << memoryCounter(PropertyBytes) << " properties, "
+      << memoryCounter(StringBytes) << " strings, "
+      << memoryCounter(ComplexBytes) << " complex.";
+
+  RetainedSizes sorted = sortedSizes(sizes);
+  if(sorted.size() > top){
+    sorted.resize(top);
+  }
+  if(!sorted.empty()){
+    out << "\nLargest bindings (bytes retained):";
+    for(auto & size : sorted){
+      out << "\n  " << size.first << " " << size.second;
+    }
+  }
+  return out.str();
+}
@@ -0,0 +1,125 @@
+/*! \file memstats.hpp
+Defines the accounting of live objects and heap bytes.
+
+Counters of live Expressions and Atoms and of the heap bytes held by tails,
+property blocks, Symbol and String text and Complex values are updated as
+objects are made and destroyed. They are cheap enough to be always compiled
+in: each thread counts in relaxed atomics of its own, summed when read. An
+object destroyed on another thread than the one that made it is subtracted
+there, so only the sums are meaningful. The retained size of each binding of an environment is
+computed when asked for.
+
+The sizes are of the objects themselves: they do not include allocator
+overheads, and text shared by copies of an Atom is counted once in the
+counters but once per copy in retained sizes.
+ */
+#ifndef MEMSTATS_HPP
+#define MEMSTATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// the memory counters
+enum MemoryCounter { LiveExpressions, LiveAtoms, TailBytes, PropertyBytes,
+		     StringBytes, ComplexBytes, MemoryCounterCount };
+
+/// the counters of one thread, written only by it
+struct ThreadMemoryCounters {
+  std::atomic<std::int64_t> values[MemoryCounterCount];
+};
+
+/// return the counters of the current thread, nullptr until it first counts
+inline ThreadMemoryCounters *& threadMemoryCounters() noexcept{
+  static thread_local ThreadMemoryCounters * counters = nullptr;
+  return counters;
+}
+
+/// make and return the counters of the current thread
+ThreadMemoryCounters * registerMemoryCounters();
+
+/*! Add delta to a counter
+  Each thread adds to counters of its own, which only it writes, so counting
+  takes no lock or atomic read-modify-write; memoryCounter sums them.
+ */
+inline void countMemory(MemoryCounter counter, std::int64_t delta) noexcept{
+  ThreadMemoryCounters * counters = threadMemoryCounters();
+  if(counters == nullptr){
+    counters = registerMemoryCounters();
+  }
+  std::atomic<std::int64_t> & value = counters->values[counter];
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+/*! \class CountedAllocator
+\brief A standard allocator counting the bytes it holds in a counter
+*/
+template<typename T, MemoryCounter Counter>
+class CountedAllocator {
+public:
+
+  typedef T value_type;
+
+  template<typename U>
+  struct rebind {
+    typedef CountedAllocator<U, Counter> other;
+  };
+
+  CountedAllocator() noexcept {}
+
+  template<typename U>
+  CountedAllocator(const CountedAllocator<U, Counter> &) noexcept {}
+
+  T * allocate(std::size_t n){
+    T * p = std::allocator<T>().allocate(n);
+    countMemory(Counter, n*sizeof(T));
+    return p;
+  }
+
+  void deallocate(T * p, std::size_t n) noexcept{
+    countMemory(Counter, -static_cast<std::int64_t>(n*sizeof(T)));
+    std::allocator<T>().deallocate(p, n);
+  }
+};
+
+template<typename T, typename U, MemoryCounter Counter>
+bool operator==(const CountedAllocator<T, Counter> &, const CountedAllocator<U, Counter> &) noexcept{
+  return true;
+}
+
+template<typename T, typename U, MemoryCounter Counter>
+bool operator!=(const CountedAllocator<T, Counter> &, const CountedAllocator<U, Counter> &) noexcept{
+  return false;
+}
+
+/// return the value of a counter, summed over all threads
+std::int64_t memoryCounter(MemoryCounter counter) noexcept;
+
+/// return the name of a counter, as reported, e.g. "tail-bytes"
+const char * memoryCounterName(MemoryCounter counter) noexcept;
+
+/*! \typedef RetainedSizes
+\brief (symbol, bytes) pairs, the retained size of each binding
+*/
+typedef std::vector<std::pair<std::string, std::size_t>> RetainedSizes;
+
+class Environment;
+class Expression;
+
+/*! Return the counters and the retained size of each binding of env as a
+  list of (name value) lists, the last ("bindings" list) holding a (symbol
+  bytes) list for each binding, the largest first
+ */
+Expression memoryStats(const Environment & env);
+
+/*! Return the counters and the largest bindings as text
+  \param sizes the retained size of each binding
+  \param top the most bindings to show
+ */
+std::string formatMemoryStats(const RetainedSizes & sizes, std::size_t top);
+
+#endif
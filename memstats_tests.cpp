@@ -0,0 +1,104 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "memstats.hpp"
+#include "directive.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE( "Test memory counters follow live objects", "[memstats]" ) {
+
+  std::int64_t expressions = memoryCounter(LiveExpressions);
+  std::int64_t atoms = memoryCounter(LiveAtoms);
+  std::int64_t tails = memoryCounter(TailBytes);
+  std::int64_t properties = memoryCounter(PropertyBytes);
+  std::int64_t strings = memoryCounter(StringBytes);
+  std::int64_t complexes = memoryCounter(ComplexBytes);
+
+  {
+    std::vector<Expression> items(100, Expression(1.));
+    Expression list(items);
+    REQUIRE(memoryCounter(LiveExpressions) >= expressions + 201);
+    REQUIRE(memoryCounter(LiveAtoms) >= atoms + 201);
+    REQUIRE(memoryCounter(TailBytes) >= tails + 100*static_cast<std::int64_t>(sizeof(Expression)));
+
+    Expression text(Atom("\"" + std::string(100, 'a') + "\""));
+    REQUIRE(memoryCounter(StringBytes) >= strings + 100);
+
+    // copies share the text
+    std::int64_t shared = memoryCounter(StringBytes);
+    Expression copy(text);
+    REQUIRE(memoryCounter(StringBytes) == shared);
+
+    Expression z(std::complex<double>(1, 2));
+    REQUIRE(memoryCounter(ComplexBytes) > complexes);
+
+    list.setProperty(internPropertyKey("\"note\""), text);
+    REQUIRE(memoryCounter(PropertyBytes) > properties);
+  }
+
+  REQUIRE(memoryCounter(LiveExpressions) == expressions);
+  REQUIRE(memoryCounter(LiveAtoms) == atoms);
+  REQUIRE(memoryCounter(TailBytes) == tails);
+  REQUIRE(memoryCounter(PropertyBytes) == properties);
+  REQUIRE(memoryCounter(StringBytes) == strings);
+  REQUIRE(memoryCounter(ComplexBytes) == complexes);
+}
+
+TEST_CASE( "Test retained size of expressions", "[memstats]" ) {
+
+  REQUIRE(Expression(1.).retainedBytes() == sizeof(Expression));
+  REQUIRE(Expression(Atom("\"abc\"")).retainedBytes() > sizeof(Expression));
+
+  std::vector<Expression> items(1000, Expression(1.));
+  Expression list(items);
+  REQUIRE(list.retainedBytes() >= 1001*sizeof(Expression));
+
+  Expression nested(std::vector<Expression>{list, list});
+  REQUIRE(nested.retainedBytes() >= 2*list.retainedBytes());
+}
+
+TEST_CASE( "Test memory-stats special form", "[memstats]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(begin (define small 1) (define big (range 1 1000 1)))");
+
+  Expression stats = runProgram(interp, "(memory-stats)");
+  REQUIRE(stats.isHeadList());
+  auto entry = stats.tailConstBegin();
+  REQUIRE(*entry->tailConstBegin() == Expression(Atom("\"expressions\"")));
+  REQUIRE((entry->tailConstBegin() + 1)->head().asNumber() > 1000);
+
+  const Expression & bindings = *(stats.tailConstEnd() - 1);
+  REQUIRE(*bindings.tailConstBegin() == Expression(Atom("\"bindings\"")));
+  const Expression & sizes = *(bindings.tailConstBegin() + 1);
+  const Expression & largest = *sizes.tailConstBegin();
+  REQUIRE(*largest.tailConstBegin() == Expression(Atom("\"big\"")));
+  REQUIRE((largest.tailConstBegin() + 1)->head().asNumber() >= 1000*sizeof(Expression));
+
+  std::istringstream bad("(memory-stats 1)");
+  REQUIRE(interp.parseStream(bad));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+}
+
+TEST_CASE( "Test mem directive", "[memstats]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(begin (define small 1) (define big (range 1 1000 1)))");
+  std::string reply;
+
+  REQUIRE(handleDirective(interp, "%mem", reply));
+  REQUIRE(reply.find("Memory: ") == 0);
+  REQUIRE(reply.find("\nLargest bindings (bytes retained):\n  big ") != std::string::npos);
+  REQUIRE(reply.find("\n  small ") != std::string::npos);
+
+  REQUIRE(handleDirective(interp, "%mem 1", reply));
+  REQUIRE(reply.find("\n  big ") != std::string::npos);
+  REQUIRE(reply.find("\n  small ") == std::string::npos);
+
+  REQUIRE(handleDirective(interp, "%mem lots", reply));
+  REQUIRE(reply.find("Error") == 0);
+}
@@ -1,11 +1,18 @@
 #include <QApplication>
 #include "notebook_app.hpp"
+#include "trace.hpp"
 
 int main(int argc, char *argv[])
 {
   QApplication app(argc, argv);
+  QStringList args = app.arguments();
+  int trace = args.indexOf("--trace");
+  if(trace > 0 && trace + 1 < args.size()){
+    // the trace is written at exit
+    traceToFile(args[trace + 1].toStdString());
+    setTraceThreadName("gui");
+  }
   NotebookApp noteApp;
   noteApp.show();
   return app.exec();
 }
-
@@ -6,14 +6,23 @@ NotebookApp::NotebookApp(QWidget * parent) : QWidget(parent) {
     QPushButton *stopButton = new QPushButton("Stop Kernel");
     QPushButton *resetButton = new QPushButton("Reset Kernel");
     QPushButton *interruptButton = new QPushButton("Interrupt");
+    QPushButton *saveButton = new QPushButton("Save Session");
+    QPushButton *loadButton = new QPushButton("Load Session");
+    QPushButton *profileButton = new QPushButton("Profile");
     startButton->setObjectName("start");
     stopButton->setObjectName("stop");
     resetButton->setObjectName("reset");
     interruptButton->setObjectName("interrupt");
+    saveButton->setObjectName("save");
+    loadButton->setObjectName("load");
+    profileButton->setObjectName("profile");
     hLayout->addWidget(startButton);
     hLayout->addWidget(stopButton);
     hLayout->addWidget(resetButton);
     hLayout->addWidget(interruptButton);
+    hLayout->addWidget(saveButton);
+    hLayout->addWidget(loadButton);
+    hLayout->addWidget(profileButton);
     QVBoxLayout *vLayout = new QVBoxLayout;
     setObjectName("notebook");
     vLayout->addLayout(hLayout);
@@ -25,4 +34,7 @@ NotebookApp::NotebookApp(QWidget * parent) : QWidget(parent) {
     QObject::connect(stopButton, SIGNAL(clicked()), &output, SLOT(recieveStopSignal()));
     QObject::connect(resetButton, SIGNAL(clicked()), &output, SLOT(recieveResetSignal()));
     QObject::connect(interruptButton, SIGNAL(clicked()), &output, SLOT(recieveInterruptSignal()));
+    QObject::connect(saveButton, SIGNAL(clicked()), &output, SLOT(recieveSaveSignal()));
+    QObject::connect(loadButton, SIGNAL(clicked()), &output, SLOT(recieveLoadSignal()));
+    QObject::connect(profileButton, SIGNAL(clicked()), &output, SLOT(recieveProfileSignal()));
 }
\ No newline at end of file
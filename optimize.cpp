@@ -0,0 +1,132 @@
+#include "optimize.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "semantic_error.hpp"
+
+// the built-in procedures without side effects, with Number or Complex
+// results for Number or Complex arguments
+const std::set<std::string> PURE_PROCEDURES = {
+  "+", "-", "*", "/", "sqrt", "^", "ln", "sin", "cos", "tan",
+  "real", "imag", "mag", "arg", "conj"};
+
+// the built-in constants
+const std::set<std::string> CONSTANTS = {"pi", "e", "I"};
+
+// true if e is (form ...)
+bool isForm(const Expression & e, const char * form){
+  return e.isHeadSymbol() && (e.tailConstBegin() != e.tailConstEnd()) &&
+    (e.head().asSymbol() == form);
+}
+
+// collect the names the program defines or binds as lambda parameters
+std::set<std::string> boundNames(const Expression & ast){
+  std::set<std::string> names;
+
+  std::vector<const Expression *> pending = {&ast};
+  while(!pending.empty()){
+    const Expression & e = *pending.back();
+    pending.pop_back();
+
+    if(isForm(e, "define") && e.tailConstBegin()->isHeadSymbol()){
+      names.insert(e.tailConstBegin()->head().asSymbol());
+    }
+    else if(isForm(e, "lambda")){
+      const Expression & params = *e.tailConstBegin();
+      if(params.isHeadSymbol()) names.insert(params.head().asSymbol());
+      for(auto p = params.tailConstBegin(); p != params.tailConstEnd(); ++p){
+	if(p->isHeadSymbol()) names.insert(p->head().asSymbol());
+      }
+    }
+
+    for(auto t = e.tailConstBegin(); t != e.tailConstEnd(); ++t){
+      pending.push_back(&*t);
+    }
+  }
+  return names;
+}
+
+// Replace e by its value if it is a call of a pure procedure with constant
+// arguments that succeeds.
+void fold(Expression & e, const Environment & env, const std::set<std::string> & bound){
+
+  if(!e.isHeadSymbol() || (e.tailConstBegin() == e.tailConstEnd())) return;
+
+  std::string name = e.head().asSymbol();
+  if(!PURE_PROCEDURES.count(name) || bound.count(name) || !env.is_proc(e.head())) return;
+
+  std::vector<Expression> args;
+  for(auto t = e.tailConstBegin(); t != e.tailConstEnd(); ++t){
+    if(t->tailConstBegin() != t->tailConstEnd()) return;
+
+    if(t->isHeadNumber() || t->isHeadComplex()){
+      args.push_back(*t);
+    }
+    else if(t->isHeadSymbol() && CONSTANTS.count(t->head().asSymbol()) &&
+	    !bound.count(t->head().asSymbol()) && env.is_exp(t->head())){
+      args.push_back(env.get_exp(t->head()));
+    }
+    else{
+      return;
+    }
+  }
+
+  Expression value;
+  try{
+    value = env.get_proc(e.head())(args);
+  }
+  catch(const SemanticError &){
+    return;
+  }
+
+  if(value.isHeadNumber() || value.isHeadComplex()){
+    e = value;
+  }
+}
+
+Expression optimize(const Expression & ast, const Environment & env){
+
+  Expression result(ast);
+  std::set<std::string> bound = boundNames(result);
+  std::size_t limit = getEvalDepthLimit();
+
+  // post-order walk, rewriting each expression once its tail is done
+  struct Item {
+    Expression * exp;
+    std::size_t depth;
+    bool expanded;
+  };
+  std::vector<Item> stack = {{&result, 1, false}};
+  while(!stack.empty()){
+    Item & item = stack.back();
+    Expression & e = *item.exp;
+    std::size_t depth = item.depth;
+
+    if(!item.expanded){
+      item.expanded = true;
+
+      // the parameters of a lambda and the symbol of a define are not evaluated
+      auto t = e.tailBegin();
+      if(isForm(e, "lambda") || isForm(e, "define")) ++t;
+      for(; t != e.tailEnd(); ++t){
+	stack.push_back({&*t, depth + 1, false});
+      }
+      continue;
+    }
+    stack.pop_back();
+
+    // a call deeper than the limit fails at evaluation, and so do its callers
+    if(depth <= limit){
+      fold(e, env, bound);
+    }
+
+    if(isForm(e, "begin") && (e.tailConstEnd() - e.tailConstBegin() == 1) && !bound.count("begin")){
+      Expression form(std::move(*e.tailBegin()));
+      e = std::move(form);
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,30 @@
+/*! \file optimize.hpp
+Defines the optimization pass run on a parsed AST before evaluation.
+
+The pass rewrites the AST without changing the result of evaluating it:
+
+- calls of the pure numeric built-in procedures (+, -, *, /, sqrt, ^, ln,
+  sin, cos, tan, real, imag, mag, arg, conj) whose arguments are all
+  Number or Complex literals, or the constants pi, e and I, are replaced
+  by their value. A call is only folded when it succeeds, so errors are
+  still raised at evaluation.
+- a begin with a single form is replaced by that form.
+
+Names that the program defines or uses as lambda parameters are never
+folded, since they may then mean something else, and neither are calls
+nested deeper than the evaluation depth limit, which would fail.
+ */
+#ifndef OPTIMIZE_HPP
+#define OPTIMIZE_HPP
+
+#include "expression.hpp"
+#include "environment.hpp"
+
+/*! Optimize a parsed AST (iterative)
+  \param ast the AST, as returned by the parser
+  \param env the environment it will be evaluated in
+  \return the optimized AST
+ */
+Expression optimize(const Expression & ast, const Environment & env);
+
+#endif
@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include "optimize.hpp"
+#include "scan.hpp"
+#include "semantic_error.hpp"
+
+Expression optimized(const std::string & program){
+  Environment env;
+  Expression ast = parseFast(program);
+  REQUIRE(!ast.head().isNone());
+  return optimize(ast, env);
+}
+
+bool sameAst(const std::string & program, const std::string & expected){
+  return optimized(program) == parseFast(expected);
+}
+
+TEST_CASE( "Test optimize folds constant calls", "[optimize]" ) {
+
+  REQUIRE(optimized("(+ 1 2 3)") == Expression(6.));
+  REQUIRE(optimized("(* 2 (- 5 (/ 4 2)))") == Expression(6.));
+  REQUIRE(optimized("(sqrt -1)") == Expression(std::complex<double>(0, 1)));
+  REQUIRE(optimized("(real (+ 3 I))") == Expression(3.));
+  REQUIRE(optimized("(cos pi)") == Expression(-1.));
+
+  REQUIRE(sameAst("(define a (^ 2 10))", "(define a 1024)"));
+  REQUIRE(sameAst("(list (+ 1 1) (* 2 x))", "(list 2 (* 2 x))"));
+  REQUIRE(sameAst("(lambda (x) (+ x (* 2 3)))", "(lambda (x) (+ x 6))"));
+}
+
+TEST_CASE( "Test optimize leaves failing calls", "[optimize]" ) {
+
+  REQUIRE(sameAst("(- 1 2 3)", "(- 1 2 3)"));
+  REQUIRE(sameAst("(ln -1)", "(ln -1)"));
+  REQUIRE(sameAst("(+ 1 \"a\")", "(+ 1 \"a\")"));
+  REQUIRE(sameAst("(+ 1 (first (list 2)))", "(+ 1 (first (list 2)))"));
+}
+
+TEST_CASE( "Test optimize respects bound names", "[optimize]" ) {
+
+  // a lambda parameter shadows a constant
+  REQUIRE(sameAst("(begin (define f (lambda (pi) (* pi 2))) (f 1))",
+		  "(begin (define f (lambda (pi) (* pi 2))) (f 1))"));
+
+  // the parameter list itself is left alone
+  REQUIRE(sameAst("(lambda (x (+ 1 2)) x)", "(lambda (x (+ 1 2)) x)"));
+
+  // a name defined anywhere in the program is never folded
+  REQUIRE(sameAst("(begin (define sqrt 1) (sqrt 4))", "(begin (define sqrt 1) (sqrt 4))"));
+
+  // nor is a name the environment does not map to a built-in procedure
+  REQUIRE(sameAst("(unknown 1 2)", "(unknown 1 2)"));
+}
+
+TEST_CASE( "Test optimize inlines single form begin", "[optimize]" ) {
+
+  REQUIRE(optimized("(begin (+ 1 2))") == Expression(3.));
+  REQUIRE(sameAst("(begin (begin (define a 1)))", "(define a 1)"));
+  REQUIRE(sameAst("(begin (define a 1) a)", "(begin (define a 1) a)"));
+  REQUIRE(sameAst("(list (begin x))", "(list x)"));
+}
+
+TEST_CASE( "Test optimize deeply nested programs", "[optimize]" ) {
+
+  auto deepSum = [](std::size_t depth){
+    std::string program;
+    for(std::size_t i = 0; i < depth; ++i){
+      program += "(+ 1 ";
+    }
+    return program + "1" + std::string(depth, ')');
+  };
+
+  // iterative, so this does not overflow the stack
+  REQUIRE(optimized(deepSum(50000)) == Expression(50001.));
+
+  // calls nested past the depth limit would fail to evaluate, so are kept
+  setEvalDepthLimit(100);
+  REQUIRE(optimized(deepSum(100)) == Expression(101.));
+  Expression kept = optimized(deepSum(101));
+  REQUIRE(kept.isHeadSymbol());
+  Environment env;
+  REQUIRE_THROWS_AS(kept.eval(env), SemanticError);
+  setEvalDepthLimit(DEFAULT_EVAL_DEPTH_LIMIT);
+}
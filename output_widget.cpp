@@ -18,19 +18,9 @@ OutputWidget::OutputWidget(QWidget * parent) : QWidget(parent) {
     setObjectName("output");
     layout->addWidget(view);
     view->setScene(scene);
-    std::ifstream ifs(STARTUP_FILE);
-    if(!interp.parseStream(ifs)){
+    if(!loadStartupImage(interp)){
         scene->clear();
-        scene->addText("Error: Invalid Program. Could not parse.");
-    }
-    else{
-        try{
-        Expression exp = interp.evaluate();
-        }
-        catch(const SemanticError & ex){
-            scene->clear();
-            scene->addText(QString(ex.what()));
-        }
+        scene->addText("Error: Invalid startup image.");
     }
     tempInterp = interp;
     con = Consumer(inputQueue,outputQueue);
@@ -85,8 +75,29 @@ void OutputWidget::recieveInterruptSignal(){
     global_status_flag+=1;
 }
 
+void OutputWidget::recieveSaveSignal(){
+    QString filename = QFileDialog::getSaveFileName(this, "Save Session", "", "Plotscript sessions (*.plss)");
+    if(filename.isEmpty()){
+        return;
+    }
+    recieveText("%save " + filename);
+}
+
+void OutputWidget::recieveLoadSignal(){
+    QString filename = QFileDialog::getOpenFileName(this, "Load Session", "", "Plotscript sessions (*.plss)");
+    if(filename.isEmpty()){
+        return;
+    }
+    recieveText("%load " + filename);
+}
+
+void OutputWidget::recieveProfileSignal(){
+    recieveText("%profile report");
+}
+
 void OutputWidget::recieveTimerSignal(){
     if(outputQueue->try_pop(tempPair)){
+        TraceSpan span("render-result", "gui");
         // std::istringstream expression(str.toStdString());
             std::string errorString = tempPair.first;
             if(errorString.length() > 0){
@@ -101,13 +112,10 @@ void OutputWidget::recieveTimerSignal(){
                     Expression exp = tempPair.second;
                     scene->clear();
                     if(exp.isText()){
-                        std::vector<Expression> tail = exp.makeTail();
-                        Expression newExp = exp.getPosition();
                         double scale = exp.getTextScale();
                         double rotation = exp.getTextRotation();
-                        std::vector<Expression> tail2 = newExp.makeTail();
-                        double x = tail2[0].head().asNumber();
-                        double y = tail2[1].head().asNumber();
+                        double x = exp.getX();
+                        double y = exp.getY();
                         std::string text = exp.head().asString();
                         std::string subText = text.substr(1,text.length()-2);
                         QGraphicsTextItem *str = scene->addText(QString::fromStdString(subText));
@@ -135,7 +143,7 @@ void OutputWidget::recieveTimerSignal(){
                         printList(exp);
                     }
                     else if(exp.isHeadList() || exp.head().isDiscrete()/* || exp.head().isContinuous()*/){
-                        if (exp.makeTail().size() >= 10){
+                        if ((exp.tailConstEnd() - exp.tailConstBegin()) >= 10){
                             exp.head().setDiscretePlot();
                         }
                         printList(exp);
@@ -171,18 +179,20 @@ void OutputWidget::recieveText(QString str){
         view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
         return;
     }
-    inputQueue->push(str.toStdString());
+    {
+        TraceSpan span("submit-input", "queue");
+        inputQueue->push(str.toStdString());
+    }
 
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 }
 
 void OutputWidget::printList(Expression exp){
     if(exp.isPoint()){
-        std::vector<Expression> tail = exp.makeTail();
         double w = exp.getSize();
         double h = exp.getSize();
-        double x = tail[0].head().asNumber();
-        double y = tail[1].head().asNumber();
+        double x = exp.getX();
+        double y = exp.getY();
         if(exp.head().isDiscrete()){
             w = .5;
             h = .5;
@@ -199,14 +209,13 @@ void OutputWidget::printList(Expression exp){
         view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     }
     else if(exp.isLine()){
-        std::vector<Expression> tail = exp.makeTail();
         double thickness = exp.getThickness();
-        std::vector<Expression> p1 = tail[0].makeTail();
-        std::vector<Expression> p2 = tail[1].makeTail();
-        double x1 = p1[0].head().asNumber();
-        double y1 = p1[1].head().asNumber();
-        double x2 = p2[0].head().asNumber();
-        double y2 = p2[1].head().asNumber();
+        const Expression & p1 = *exp.tailConstBegin();
+        const Expression & p2 = *(exp.tailConstBegin() + 1);
+        double x1 = p1.getX();
+        double y1 = p1.getY();
+        double x2 = p2.getX();
+        double y2 = p2.getY();
         QPen pen = QPen(Qt::black);
         pen.setWidth(thickness);
         if(exp.head().isDiscrete() || exp.head().isContinuous()){
@@ -220,11 +229,10 @@ void OutputWidget::printList(Expression exp){
     else{
         for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
             if((*e).isPoint()){
-                std::vector<Expression> tail = (*e).makeTail();
                 double w = (*e).getSize();
                 double h = (*e).getSize();
-                double x = tail[0].head().asNumber();
-                double y = tail[1].head().asNumber();
+                double x = (*e).getX();
+                double y = (*e).getY();
                 if(exp.head().isDiscrete()){
                     w = .5;
                     h = .5;
@@ -242,14 +250,13 @@ void OutputWidget::printList(Expression exp){
                 view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
             }
             else if((*e).isLine()){
-                std::vector<Expression> tail = (*e).makeTail();
                 double thickness = (*e).getThickness();
-                std::vector<Expression> p1 = tail[0].makeTail();
-                std::vector<Expression> p2 = tail[1].makeTail();
-                double x1 = p1[0].head().asNumber();
-                double y1 = p1[1].head().asNumber();
-                double x2 = p2[0].head().asNumber();
-                double y2 = p2[1].head().asNumber();
+                const Expression & p1 = *(*e).tailConstBegin();
+                const Expression & p2 = *((*e).tailConstBegin() + 1);
+                double x1 = p1.getX();
+                double y1 = p1.getY();
+                double x2 = p2.getX();
+                double y2 = p2.getY();
                 QPen pen = QPen(Qt::black);
                 pen.setWidth(thickness);
                 if(exp.head().isDiscrete() || exp.head().isContinuous()){
@@ -261,11 +268,8 @@ void OutputWidget::printList(Expression exp){
                 view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
             }
             else if((*e).isText() && !singleTextPrinted){
-                std::vector<Expression> tail = (*e).makeTail();
-                Expression newExp = (*e).getPosition();
-                std::vector<Expression> tail2 = newExp.makeTail();
-                double x = tail2[0].head().asNumber();
-                double y = tail2[1].head().asNumber();
+                double x = (*e).getX();
+                double y = (*e).getY();
                 // double scale = exp.getTextScale();
                 // double rotation = exp.getTextRotation();
                 std::string text = (*e).head().asString();
@@ -12,6 +12,7 @@
 #include <QtMath>
 #include <QTimer>
 #include <QTextBlockFormat>
+#include <QFileDialog>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -21,9 +22,11 @@
 #include <chrono>
 #include "expression.hpp"
 #include "interpreter.hpp"
+#include "directive.hpp"
 #include "semantic_error.hpp"
-#include "startup_config.hpp"
+#include "startup_image.hpp"
 #include "message_queue.hpp"
+#include "trace.hpp"
 
 typedef MessageQueue<std::string> imq;
 typedef MessageQueue<std::pair<std::string,Expression>> omq;
@@ -47,17 +50,27 @@ public:
   }
   void operator()(Interpreter i)
   {
+    if(tracing()){
+      setTraceThreadName("kernel");
+    }
     while(status == true){
       Expression tempExp;
       std::string tempStr;
       std::string errStr;
-      inputQueue->wait_and_pop(tempStr);
+      {
+        TraceSpan span("wait-input", "queue");
+        inputQueue->wait_and_pop(tempStr);
+      }
+      TraceSpan span("handle-input", "kernel");
       std::istringstream expression(tempStr);
       if(tempStr == ""){
         changeRunStatus();
         return;
       }
-      if(!i.parseStream(expression)){
+      if(handleDirective(i, tempStr, errStr)){
+        // the reply is shown in place of a result
+      }
+      else if(!i.parseStream(expression)){
         errStr = "Error: Invalid Program. Could not parse.";
       }
       else{
@@ -104,6 +117,9 @@ private slots:
     void recieveStopSignal();
     void recieveResetSignal();
     void recieveInterruptSignal();
+    void recieveSaveSignal();
+    void recieveLoadSignal();
+    void recieveProfileSignal();
     void recieveTimerSignal();
 
 private:
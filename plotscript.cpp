@@ -6,9 +6,15 @@
 #include <cstdlib>
 
 #include "interpreter.hpp"
+#include "compile.hpp"
+#include "directive.hpp"
 #include "semantic_error.hpp"
-#include "startup_config.hpp"
+#include "startup_image.hpp"
 #include "message_queue.hpp"
+#include "pool.hpp"
+#include "sampler.hpp"
+#include "server.hpp"
+#include "trace.hpp"
 
 
 typedef MessageQueue<std::string> imq;
@@ -94,17 +100,27 @@ public:
   }
   void operator()(Interpreter i)
   {
+    if(tracing()){
+      setTraceThreadName("kernel");
+    }
     while(status == true){
       Expression tempExp;
       std::string tempStr;
       std::string errStr;
-      inputQueue->wait_and_pop(tempStr);
+      {
+        TraceSpan span("wait-input", "queue");
+        inputQueue->wait_and_pop(tempStr);
+      }
+      TraceSpan span("handle-input", "kernel");
       std::istringstream expression(tempStr);
       if(tempStr == ""){
         changeRunStatus();
         return;
       }
-      if(!i.parseStream(expression)){
+      if(handleDirective(i, tempStr, errStr)){
+        // the reply is shown in place of a result
+      }
+      else if(!i.parseStream(expression)){
         tempStr = "Invalid Program. Could not parse.";
       }
       else{
@@ -184,8 +200,90 @@ int eval_from_stream(std::istream & stream, Interpreter interp){
   return EXIT_SUCCESS;
 }
 
+// evaluate each top-level form of the stream as soon as it has been read
+int eval_each_from_stream(std::istream & stream, Interpreter interp){
+
+  int status = EXIT_SUCCESS;
+  bool ok;
+
+  while(interp.parseNext(stream, ok)){
+    if(!ok){
+      error("Invalid Program. Could not parse.");
+      status = EXIT_FAILURE;
+      continue;
+    }
+    try{
+      Expression exp = interp.evaluate();
+      std::cout << exp << std::endl;
+    }
+    catch(const SemanticError & ex){
+      std::cerr << ex.what() << std::endl;
+      status = EXIT_FAILURE;
+    }
+  }
+
+  return status;
+}
+
+int eval_each_from_file(std::string filename, Interpreter interp){
+
+  std::ifstream ifs(filename);
+  if(!ifs){
+    error("Could not open file for reading.");
+    return EXIT_FAILURE;
+  }
+
+  return eval_each_from_stream(ifs, interp);
+}
+
+// true if the filename ends with the compiled script extension
+bool is_compiled(const std::string & filename){
+  return (filename.size() > COMPILED_EXTENSION.size()) &&
+    (filename.compare(filename.size() - COMPILED_EXTENSION.size(),
+		      COMPILED_EXTENSION.size(), COMPILED_EXTENSION) == 0);
+}
+
+int eval_from_compiled(std::string filename, Interpreter interp){
+
+  std::string message;
+  bool ok = loadCompiledScript(filename, interp, message);
+  if(!ok){
+    error(message);
+    return EXIT_FAILURE;
+  }
+  if(!message.empty()){
+    info(message);
+  }
+
+  try{
+    Expression exp = interp.evaluate();
+    std::cout << exp << std::endl;
+  }
+  catch(const SemanticError & ex){
+    std::cerr << ex.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int compile_file(std::string source, std::string target){
+
+  std::string message;
+  if(!compileScript(source, target, message)){
+    error(message);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int eval_from_file(std::string filename, Interpreter interp){
-      
+
+  if(is_compiled(filename)){
+    return eval_from_compiled(filename, interp);
+  }
+
   std::ifstream ifs(filename);
   if(!ifs){
     error("Could not open file for reading.");
@@ -274,13 +372,16 @@ void repl(Interpreter interp){
     }
     input->push(line);
 
-    while(output->empty()){
-      if(global_status_flag > 0){
-        std::cout << "Error: interpreter kernel not running" << std::endl;
-        break;
+    {
+      TraceSpan span("wait-result", "queue");
+      while(output->empty()){
+        if(global_status_flag > 0){
+          std::cout << "Error: interpreter kernel not running" << std::endl;
+          break;
+        }
       }
+      output->try_pop(tempPair);
     }
-    output->try_pop(tempPair);
     // output->wait_and_pop(tempPair);
     if(global_status_flag == 0){
       if(tempPair.first == ""){
@@ -297,35 +398,138 @@ void repl(Interpreter interp){
   delete output;
 }
 
+// the server of --serve, stopped by SIGINT and SIGTERM
+Server * serving = nullptr;
+
+void stop_serving(int){
+  if(serving != nullptr){
+    serving->stop();
+  }
+}
+
+// serve sessions on a socket until interrupted, options are --workers n,
+// --timeout ms and --processes n
+int serve(std::string path, int argc, char *argv[], Interpreter interp){
+
+  ServerOptions options;
+  PoolOptions poolOptions;
+  bool workersGiven = false;
+  bool pooled = false;
+  for(int i = 0; i < argc; i += 2){
+    std::string option(argv[i]);
+    long value = -1;
+    if(i + 1 < argc){
+      std::istringstream in(argv[i+1]);
+      if(!(in >> value) || !in.eof()) value = -1;
+    }
+    if((option == "--workers") && (value >= 0)){
+      options.workers = static_cast<std::size_t>(value);
+      workersGiven = true;
+    }
+    else if((option == "--timeout") && (value >= 0)){
+      options.timeout = std::chrono::milliseconds(value);
+      poolOptions.timeout = options.timeout;
+    }
+    else if((option == "--processes") && (value >= 0)){
+      poolOptions.processes = static_cast<std::size_t>(value);
+      pooled = true;
+    }
+    else{
+      error("Incorrect command line arguments for --serve.");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // the pool forks, so it starts before the server starts its threads
+  ProcessPool pool(interp, poolOptions);
+  std::string message;
+  if(pooled){
+    if(!pool.start(message)){
+      error(message);
+      return EXIT_FAILURE;
+    }
+    options.pool = &pool;
+    options.timeout = std::chrono::milliseconds(0);
+    if(!workersGiven){
+      options.workers = pool.processes();
+    }
+  }
+
+  Server server(interp, options);
+  if(!server.listen(path, message)){
+    error(message);
+    return EXIT_FAILURE;
+  }
+
+#if !defined(_WIN64) && !defined(_WIN32)
+  serving = &server;
+  struct sigaction stopHandler;
+  stopHandler.sa_handler = stop_serving;
+  sigemptyset(&stopHandler.sa_mask);
+  stopHandler.sa_flags = 0;
+  sigaction(SIGINT, &stopHandler, NULL);
+  sigaction(SIGTERM, &stopHandler, NULL);
+#endif
+
+  info("Serving on " + path + ".");
+  server.run();
+  serving = nullptr;
+
+  return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[])
 {
   install_handler();
-   Interpreter interp;
-   std::ifstream ifs(STARTUP_FILE);
-    if(!interp.parseStream(ifs)){
-    error("Invalid Program. Could not parse.");
+  Interpreter interp;
+  if(!loadStartupImage(interp)){
+    error("Invalid startup image.");
     return EXIT_FAILURE;
   }
-  else{
-    try{
-      Expression exp = interp.evaluate();
+  // the trace and samples are written at exit, the remaining arguments
+  // are as usual
+  while(argc >= 3){
+    std::string option(argv[1]);
+    if(option == "--trace"){
+      traceToFile(argv[2]);
+      setTraceThreadName("main");
     }
-    catch(const SemanticError & ex){
-      std::cerr << ex.what() << std::endl;
-      return EXIT_FAILURE;
-    }	
+    else if(option == "--sample"){
+      if(!sampleToFile(argv[2])){
+        error("Could not start the sampling timer.");
+        return EXIT_FAILURE;
+      }
+    }
+    else{
+      break;
+    }
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc >= 3 && std::string(argv[1]) == "--serve"){
+    return serve(argv[2], argc - 3, argv + 3, interp);
+  }
+  else if(argc == 2 && std::string(argv[1]) == "--stream"){
+    return eval_each_from_stream(std::cin, interp);
   }
-  if(argc == 2){
+  else if(argc == 2){
     return eval_from_file(argv[1], interp);
   }
   else if(argc == 3){
     if(std::string(argv[1]) == "-e"){
       return eval_from_command(argv[2], interp);
     }
+    else if(std::string(argv[1]) == "--stream"){
+      return eval_each_from_file(argv[2], interp);
+    }
     else{
       error("Incorrect number of command line arguments.");
     }
   }
+  else if(argc == 5 && std::string(argv[1]) == "--compile" && std::string(argv[3]) == "-o"){
+    return compile_file(argv[2], argv[4]);
+  }
   else{
     repl(interp);
   }
@@ -0,0 +1,342 @@
+// Benchmark: the interpreter's hot paths, from tokenizing and parsing to
+// Atoms, environment lookups, built-in arithmetic, lambda application, map
+// over large lists, plots and the message queue between the front ends and
+// the kernel.
+//
+// Each benchmark runs a batch of operations per repetition, the batch grown
+// until a repetition takes at least 200 us. After the warmup repetitions it
+// reports over the timed repetitions the median, 99th percentile and
+// fastest time per operation, and the heap allocations per operation.
+//
+// usage: plotscript_bench [reps] [--reps n] [--warmup n] [--filter text] [--json]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "atom.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "message_queue.hpp"
+#include "parse.hpp"
+#include "scan.hpp"
+#include "semantic_error.hpp"
+#include "token.hpp"
+
+// results are folded into this, so the work making them is not optimized out
+volatile std::size_t sink = 0;
+
+// the shortest time of a repetition
+const std::chrono::microseconds MIN_REP_TIME(200);
+
+// a sum of products of differences, nested depth deep
+std::string polynomial(int terms, int depth){
+  std::ostringstream out;
+  out << "(+";
+  for(int i = 0; i < terms; ++i){
+    std::string term = std::to_string(i);
+    for(int d = 0; d < depth; ++d){
+      term = "(* (- " + term + " " + std::to_string(d) + ") (/ " + std::to_string(d + 1) + " 2))";
+    }
+    out << " " << term;
+  }
+  out << ")";
+  return out.str();
+}
+
+// a benchmark runs n operations per call
+struct Benchmark {
+  std::string name;
+  std::function<void(std::size_t n)> run;
+};
+
+struct Result {
+  std::string name;
+  std::size_t reps;
+  std::size_t opsPerRep;
+  double medianNs;
+  double p99Ns;
+  double minNs;
+  double allocsPerOp;
+};
+
+// parse program into interp, exiting on failure
+void parseOrExit(Interpreter & interp, const std::string & name, const std::string & program){
+  std::istringstream iss(program);
+  if(!interp.parseStream(iss)){
+    std::cerr << "Error: Invalid Program. Could not parse: " << name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+// evaluate interp's program, exiting on failure
+Expression evaluateOrExit(Interpreter & interp, const std::string & name){
+  try{
+    return interp.evaluate();
+  }
+  catch(const SemanticError & ex){
+    std::cerr << name << ": " << ex.what() << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+// parse and evaluate the whole program each operation, as a script run does
+Benchmark script(const std::string & name, const std::string & program){
+  auto interp = std::make_shared<Interpreter>();
+  return {name, [interp, name, program](std::size_t n){
+      for(std::size_t i = 0; i < n; ++i){
+	parseOrExit(*interp, name, program);
+	sink = sink + (evaluateOrExit(*interp, name).head().isNone() ? 0 : 1);
+      }
+    }};
+}
+
+// evaluate program each operation, after evaluating setup once
+Benchmark evaluation(const std::string & name, const std::string & setup, const std::string & program){
+  auto interp = std::make_shared<Interpreter>();
+  if(!setup.empty()){
+    parseOrExit(*interp, name, setup);
+    evaluateOrExit(*interp, name);
+  }
+  parseOrExit(*interp, name, program);
+  return {name, [interp, name](std::size_t n){
+      for(std::size_t i = 0; i < n; ++i){
+	sink = sink + (evaluateOrExit(*interp, name).head().isNone() ? 0 : 1);
+      }
+    }};
+}
+
+std::vector<Benchmark> benchmarks(){
+
+  const std::string text = polynomial(40, 12);
+  std::istringstream iss(text);
+  const TokenSequenceType tokens = tokenize(iss);
+
+  std::vector<Benchmark> all;
+
+  all.push_back({"tokenize", [text](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  std::istringstream in(text);
+	  sink = sink + tokenize(in).size();
+	}
+      }});
+  all.push_back({"tokenize-fast", [text](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  sink = sink + tokenizeFast(text).size();
+	}
+      }});
+  all.push_back({"parse", [tokens](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  sink = sink + (parse(tokens).head().isNone() ? 0 : 1);
+	}
+      }});
+  all.push_back({"parse-fast", [text](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  sink = sink + (parseFast(text).head().isNone() ? 0 : 1);
+	}
+      }});
+
+  all.push_back({"atom-number", [](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  Atom a(static_cast<double>(i));
+	  sink = sink + a.isNumber();
+	}
+      }});
+  all.push_back({"atom-symbol", [](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  Atom a("a-symbol-name");
+	  sink = sink + a.isSymbol();
+	}
+      }});
+  Atom longString("\"a string long enough not to be stored inline\"");
+  all.push_back({"atom-copy", [longString](std::size_t n){
+	for(std::size_t i = 0; i < n; ++i){
+	  Atom a(longString);
+	  sink = sink + a.isString();
+	}
+      }});
+
+  auto env = std::make_shared<Environment>();
+  env->add_exp(Atom("x"), Expression(2.0));
+  all.push_back({"env-find-proc", [env](std::size_t n){
+	Atom plus("+");
+	for(std::size_t i = 0; i < n; ++i){
+	  sink = sink + (env->find_proc(plus) != nullptr);
+	}
+      }});
+  all.push_back({"env-get-exp", [env](std::size_t n){
+	Atom x("x");
+	for(std::size_t i = 0; i < n; ++i){
+	  sink = sink + env->get_exp(x).isHeadNumber();
+	}
+      }});
+
+  all.push_back(script("flat-sum", polynomial(400, 1)));
+  all.push_back(script("nested-arith", polynomial(40, 12)));
+  all.push_back(script("lambda-map", "(begin (define f (lambda (x) (+ (* x x) (- x 1) (/ x 2))))"
+		       " (map f (range 0 500 1)))"));
+  all.push_back(script("map-recip", "(map / (map - (range 1 20000 1)))"));
+  all.push_back(script("map-complex", "(map / (map sqrt (map - (range 1 20000 1))))"));
+  all.push_back(script("apply-sum", "(apply + (map - (range 0 20000 1)))"));
+  all.push_back(script("apply-product", "(apply * (range 1 1.2 0.00001))"));
+
+  all.push_back(evaluation("builtin-add", "(define a 1)", "(+ a 2 3.5)"));
+  all.push_back(evaluation("builtin-mul-div", "(define a 3)", "(/ (* a a 2) 7)"));
+  all.push_back(evaluation("lambda-apply", "(define f (lambda (x y) (+ x y)))", "(apply f (list 1 2))"));
+  all.push_back(evaluation("lambda-call", "(define f (lambda (x y) (+ x y)))", "(f 1 2)"));
+  all.push_back(evaluation("map-lambda-20000", "(begin (define sq (lambda (x) (* x x)))"
+			   " (define items (range 0 20000 1)))", "(map sq items)"));
+  all.push_back(evaluation("map-builtin-20000", "(define items (range 0 20000 1))", "(map sin items)"));
+  all.push_back(evaluation("discrete-plot", "(begin (define sq (lambda (x) (list x (* x x))))"
+			   " (define points (map sq (range -10 10 0.1))))",
+			   "(discrete-plot points (list (list \"title\" \"t\")))"));
+  all.push_back(evaluation("continuous-plot", "(define f (lambda (x) (+ (* 2 x) (sin x))))",
+			   "(continuous-plot f (list -10 10) (list (list \"title\" \"t\")))"));
+
+  // one operation is a message through a queue to another thread
+  all.push_back({"message-queue", [](std::size_t n){
+	MessageQueue<std::string> queue;
+	std::thread consumer([&queue, n](){
+	    std::string message;
+	    for(std::size_t i = 0; i < n; ++i){
+	      queue.wait_and_pop(message);
+	      sink = sink + message.size();
+	    }
+	  });
+	const std::string message("(+ 1 2)");
+	for(std::size_t i = 0; i < n; ++i){
+	  queue.push(message);
+	}
+	consumer.join();
+      }});
+
+  return all;
+}
+
+// the time of one repetition of n operations
+double timeRep(const Benchmark & b, std::size_t n){
+  auto start = std::chrono::steady_clock::now();
+  b.run(n);
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+Result measure(const Benchmark & b, std::size_t reps, std::size_t warmup){
+
+  // grow the batch until a repetition is long enough to time, after a
+  // first cold operation
+  timeRep(b, 1);
+  std::size_t n = 1;
+  double minRepNs = std::chrono::duration<double, std::nano>(MIN_REP_TIME).count();
+  while(timeRep(b, n) < minRepNs){
+    n *= 2;
+  }
+
+  for(std::size_t i = 0; i < warmup; ++i){
+    timeRep(b, n);
+  }
+
+  std::vector<double> perOp;
+  unsigned long before = allocationCount();
+  for(std::size_t i = 0; i < reps; ++i){
+    perOp.push_back(timeRep(b, n)/n);
+  }
+  unsigned long count = allocationCount() - before;
+
+  std::sort(perOp.begin(), perOp.end());
+  std::size_t p99 = static_cast<std::size_t>(std::ceil(0.99*reps)) - 1;
+  return {b.name, reps, n, perOp[reps/2], perOp[p99], perOp[0],
+      static_cast<double>(count)/(static_cast<double>(reps)*n)};
+}
+
+void printTable(const std::vector<Result> & results){
+  std::cout << std::left << std::setw(20) << "case"
+	    << std::right << std::setw(10) << "ops/rep"
+	    << std::setw(14) << "median ns/op" << std::setw(14) << "p99 ns/op"
+	    << std::setw(14) << "min ns/op" << std::setw(12) << "allocs/op" << std::endl;
+  for(auto & r : results){
+    std::cout << std::left << std::setw(20) << r.name
+	      << std::right << std::setw(10) << r.opsPerRep << std::fixed << std::setprecision(1)
+	      << std::setw(14) << r.medianNs << std::setw(14) << r.p99Ns
+	      << std::setw(14) << r.minNs << std::setprecision(2) << std::setw(12) << r.allocsPerOp
+	      << std::endl;
+  }
+}
+
+void printJson(const std::vector<Result> & results){
+  std::cout << "{\"benchmarks\":[";
+  for(std::size_t i = 0; i < results.size(); ++i){
+    const Result & r = results[i];
+    std::cout << (i == 0 ? "\n" : ",\n") << std::fixed << std::setprecision(3)
+	      << "{\"name\":\"" << r.name << "\",\"reps\":" << r.reps
+	      << ",\"ops_per_rep\":" << r.opsPerRep << ",\"median_ns\":" << r.medianNs
+	      << ",\"p99_ns\":" << r.p99Ns << ",\"min_ns\":" << r.minNs
+	      << ",\"allocs_per_op\":" << r.allocsPerOp << "}";
+  }
+  std::cout << "\n]}" << std::endl;
+}
+
+// read a count of at least minimum, exiting on anything else
+std::size_t countArgument(const char * program, const char * arg, long minimum){
+  char * end = nullptr;
+  long value = std::strtol(arg, &end, 10);
+  if((*arg == '\0') || (*end != '\0') || (value < minimum)){
+    std::cerr << "Usage: " << program
+	      << " [reps] [--reps n] [--warmup n] [--filter text] [--json]" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  return static_cast<std::size_t>(value);
+}
+
+int main(int argc, char *argv[])
+{
+  std::size_t reps = 50;
+  std::size_t warmup = 5;
+  std::string filter;
+  bool json = false;
+
+  for(int i = 1; i < argc; ++i){
+    std::string arg(argv[i]);
+    if(arg == "--json"){
+      json = true;
+    }
+    else if(((arg == "--reps") || (arg == "--warmup") || (arg == "--filter")) && (i + 1 < argc)){
+      const char * value = argv[++i];
+      if(arg == "--filter"){
+	filter = value;
+      }
+      else{
+	(arg == "--reps" ? reps : warmup) = countArgument(argv[0], value, (arg == "--reps") ? 1 : 0);
+      }
+    }
+    else{
+      reps = countArgument(argv[0], argv[i], 1);
+    }
+  }
+
+  std::vector<Result> results;
+  for(auto & b : benchmarks()){
+    if(b.name.find(filter) != std::string::npos){
+      results.push_back(measure(b, reps, warmup));
+    }
+  }
+
+  if(json){
+    printJson(results);
+  }
+  else{
+    printTable(results);
+  }
+  return EXIT_SUCCESS;
+}
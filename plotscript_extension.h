@@ -0,0 +1,88 @@
+/*! \file plotscript_extension.h
+Defines the C ABI of native extension modules.
+
+An extension is a shared library exporting plotscript_extension_init. The
+special form (load-extension "path") loads it and calls the function once
+with a host, through which it registers its procedures; the names are then
+bound in the environment like the built-in procedures.
+
+Procedures take and return real Numbers. Each has a context pointer, passed
+back on every call, and may have a vectorized variant that the map special
+form calls once on a whole list of Numbers instead of once per item. A
+procedure reports an error by returning a message, which the interpreter
+raises as a semantic error; it returns NULL on success.
+
+Extensions are never unloaded, so the context pointers and the returned
+messages must remain valid for the life of the process. Procedures may be
+called from several interpreter threads at once.
+
+The header is plain C and includes nothing from the interpreter, so an
+extension needs only this file to build.
+ */
+#ifndef PLOTSCRIPT_EXTENSION_H
+#define PLOTSCRIPT_EXTENSION_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// the version of this ABI, changed whenever it changes incompatibly
+#define PLOTSCRIPT_EXTENSION_ABI_VERSION 1
+
+/// the max_args of a procedure taking any number of arguments
+#define PLOTSCRIPT_ANY_ARITY ((size_t)-1)
+
+/*! A procedure: set *result from the nargs arguments
+  \return NULL on success, otherwise the error message
+ */
+typedef const char * (*plotscript_scalar_fn)(void * context, const double * args,
+					     size_t nargs, double * result);
+
+/*! The vectorized variant of a unary procedure: set out[i] from in[i] for
+  each i < n
+  \return NULL on success, otherwise the error message
+ */
+typedef const char * (*plotscript_vector_fn)(void * context, const double * in,
+					     double * out, size_t n);
+
+/// the description of a procedure, copied by register_procedure
+typedef struct plotscript_procedure {
+  const char * name;           /* the symbol bound to the procedure */
+  plotscript_scalar_fn scalar; /* required */
+  plotscript_vector_fn vector; /* NULL if there is no vectorized variant */
+  void * context;              /* passed to scalar and vector */
+  size_t min_args;
+  size_t max_args;             /* or PLOTSCRIPT_ANY_ARITY */
+} plotscript_procedure;
+
+/// the interface the interpreter gives plotscript_extension_init
+typedef struct plotscript_host {
+  /* the ABI version of the interpreter */
+  unsigned abi_version;
+
+  /* register a procedure, returning 0 on success, nonzero if the
+     description is invalid or the name is taken */
+  int (*register_procedure)(struct plotscript_host * host,
+			    const plotscript_procedure * procedure);
+
+  /* private to the interpreter */
+  void * state;
+} plotscript_host;
+
+/*! The entry point of an extension, named PLOTSCRIPT_EXTENSION_INIT
+  \param host the interpreter, valid during the call only
+  \return 0 on success, nonzero to fail the load (e.g. on an unsupported
+  abi_version)
+ */
+typedef int (*plotscript_extension_init_fn)(plotscript_host * host);
+
+/// the name of the entry point an extension exports
+#define PLOTSCRIPT_EXTENSION_INIT "plotscript_extension_init"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
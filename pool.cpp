@@ -0,0 +1,510 @@
+#include "pool.hpp"
+
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// module includes
+#include "semantic_error.hpp"
+#include "serialize.hpp"
+
+#if defined(__linux__)
+
+// the kinds of ring record
+enum RecordKind : std::uint32_t { ReadyRecord, ValueRecord, ErrorRecord };
+
+// the header of a ring record, followed by length bytes: an encoded image
+// holding the value, or the error message
+struct RecordHeader {
+  std::uint64_t id; // the request, 0 for a ReadyRecord
+  std::uint32_t slot;
+  std::uint32_t kind;
+  std::uint64_t length;
+};
+
+// the shared part of a worker slot
+struct SharedSlot {
+  std::atomic<pid_t> pid; // the worker, set by it before it is ready and by the spawner
+  sem_t request; // posted when a request is in the slot
+  std::uint64_t id;
+  std::uint64_t length;
+  char program[POOL_PROGRAM_BYTES];
+};
+
+// the head of the shared-memory segment, followed by the slots and the ring
+struct PoolShared {
+  std::atomic<bool> stopping;
+  std::size_t slotCount;
+  std::size_t ringBytes;
+
+  // a robust mutex, so a worker dying while holding it does not block the rest
+  pthread_mutex_t ringMutex;
+  sem_t records; // posted after a record is written, to wake the collector
+  std::uint64_t head; // the offset of the next record to read
+  std::uint64_t tail; // the offset after the last record written
+
+  SharedSlot & slot(std::size_t i){
+    return reinterpret_cast<SharedSlot *>(reinterpret_cast<char *>(this) + slotsOffset())[i];
+  }
+
+  char * ring(){
+    return reinterpret_cast<char *>(this) + slotsOffset() + slotCount*sizeof(SharedSlot);
+  }
+
+  static std::size_t slotsOffset(){
+    return (sizeof(PoolShared) + 63) & ~std::size_t(63);
+  }
+};
+
+std::size_t recordBytes(std::uint64_t length){
+  return (sizeof(RecordHeader) + length + 7) & ~std::size_t(7);
+}
+
+void lockRing(PoolShared & shared){
+  if(pthread_mutex_lock(&shared.ringMutex) == EOWNERDEAD){
+    // records are published by moving tail last, so the ring is consistent
+    pthread_mutex_consistent(&shared.ringMutex);
+  }
+}
+
+// copy into and out of the ring at an offset, wrapping at its end
+void ringPut(PoolShared & shared, std::uint64_t offset, const char * data, std::size_t n){
+  std::size_t at = offset % shared.ringBytes;
+  std::size_t first = std::min(n, shared.ringBytes - at);
+  std::memcpy(shared.ring() + at, data, first);
+  std::memcpy(shared.ring(), data + first, n - first);
+}
+
+void ringGet(PoolShared & shared, std::uint64_t offset, char * data, std::size_t n){
+  std::size_t at = offset % shared.ringBytes;
+  std::size_t first = std::min(n, shared.ringBytes - at);
+  std::memcpy(data, shared.ring() + at, first);
+  std::memcpy(data + first, shared.ring(), n - first);
+}
+
+// append a record, waiting for the front end to make room; return false if
+// it can never fit or the pool is stopping
+bool ringWrite(PoolShared & shared, const RecordHeader & header, const std::string & data){
+  std::size_t need = recordBytes(header.length);
+  if(need > shared.ringBytes) return false;
+
+  while(!shared.stopping.load()){
+    lockRing(shared);
+    if(shared.ringBytes - (shared.tail - shared.head) >= need){
+      ringPut(shared, shared.tail, reinterpret_cast<const char *>(&header), sizeof(header));
+      ringPut(shared, shared.tail + sizeof(header), data.data(), data.size());
+      shared.tail += need;
+      pthread_mutex_unlock(&shared.ringMutex);
+      sem_post(&shared.records);
+      return true;
+    }
+    pthread_mutex_unlock(&shared.ringMutex);
+    usleep(1000);
+  }
+  return false;
+}
+
+// take the next record, returning false if the ring is empty
+bool ringRead(PoolShared & shared, RecordHeader & header, std::string & data){
+  lockRing(shared);
+  if(shared.head == shared.tail){
+    pthread_mutex_unlock(&shared.ringMutex);
+    return false;
+  }
+  ringGet(shared, shared.head, reinterpret_cast<char *>(&header), sizeof(header));
+  data.resize(header.length);
+  ringGet(shared, shared.head + sizeof(header), &data[0], data.size());
+  shared.head += recordBytes(header.length);
+  pthread_mutex_unlock(&shared.ringMutex);
+  return true;
+}
+
+// evaluate program in a copy of prototype, returning the record kind and data
+RecordKind evaluateProgram(const Interpreter & prototype, const std::string & program, std::string & data){
+  Interpreter interp(prototype);
+  std::istringstream in(program);
+  try{
+    if(!interp.parseStream(in)){
+      data = "Error: Invalid Program. Could not parse.";
+      return ErrorRecord;
+    }
+    Expression value = interp.evaluate();
+    data = encodeBindings(BindingList{Binding(std::string(), value)});
+    return ValueRecord;
+  }
+  catch(const SemanticError & ex){
+    data = ex.what();
+  }
+  catch(const std::exception & ex){
+    data = std::string("Error: ") + ex.what();
+  }
+  return ErrorRecord;
+}
+
+// the body of a worker process, which never returns
+void runWorker(PoolShared & shared, std::size_t index, const Interpreter & prototype, pid_t spawner){
+  // die with the spawner, and leave Ctrl-C to the front end
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  if(getppid() != spawner) _exit(EXIT_FAILURE);
+  signal(SIGINT, SIG_IGN);
+
+  // the front end may kill the worker as soon as it hands it a request
+  SharedSlot & slot = shared.slot(index);
+  slot.pid.store(getpid());
+  RecordHeader header = {0, static_cast<std::uint32_t>(index), ReadyRecord, 0};
+  if(!ringWrite(shared, header, std::string())) _exit(EXIT_SUCCESS);
+
+  for(;;){
+    while((sem_wait(&slot.request) != 0) && (errno == EINTR)){}
+    if(shared.stopping.load()) _exit(EXIT_SUCCESS);
+
+    std::string program(slot.program, slot.length);
+    std::string data;
+    header.id = slot.id;
+    header.kind = evaluateProgram(prototype, program, data);
+    header.length = data.size();
+    if(recordBytes(header.length) > shared.ringBytes){
+      data = "Error: result too large for the process pool.";
+      header.kind = ErrorRecord;
+      header.length = data.size();
+    }
+    if(!ringWrite(shared, header, data)) _exit(EXIT_SUCCESS);
+  }
+}
+
+// fork the worker of a slot, retrying while fork fails
+void spawnWorker(PoolShared & shared, std::size_t index, const Interpreter & prototype){
+  pid_t spawner = getpid();
+  while(!shared.stopping.load()){
+    pid_t pid = fork();
+    if(pid == 0){
+      runWorker(shared, index, prototype, spawner);
+    }
+    if(pid > 0){
+      shared.slot(index).pid.store(pid);
+      return;
+    }
+    usleep(100000);
+  }
+}
+
+// the body of the spawner process, which forks the workers and replaces
+// those that die until the pool stops; it never returns
+void runSpawner(PoolShared & shared, const Interpreter & prototype, pid_t frontEnd){
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  if(getppid() != frontEnd) _exit(EXIT_FAILURE);
+  signal(SIGINT, SIG_IGN);
+
+  for(std::size_t i = 0; i < shared.slotCount; ++i){
+    spawnWorker(shared, i, prototype);
+  }
+
+  for(;;){
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if(pid < 0){
+      if(errno == EINTR) continue;
+      _exit(EXIT_SUCCESS);
+    }
+    if(shared.stopping.load()) continue;
+    for(std::size_t i = 0; i < shared.slotCount; ++i){
+      if(shared.slot(i).pid.load() == pid){
+	spawnWorker(shared, i, prototype);
+	break;
+      }
+    }
+  }
+}
+
+// return the realtime clock after a wait, as sem_timedwait requires
+timespec realtimeAfter(std::chrono::nanoseconds wait){
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  long long ns = static_cast<long long>(now.tv_nsec) + wait.count();
+  now.tv_sec += static_cast<time_t>(ns / 1000000000);
+  now.tv_nsec = static_cast<long>(ns % 1000000000);
+  return now;
+}
+
+#endif
+
+ProcessPool::ProcessPool(const Interpreter & prototype, const PoolOptions & options):
+  m_prototype(prototype), m_options(options), m_shared(nullptr),
+  m_sharedBytes(0), m_spawner(-1), m_nextId(0), m_stopping(false){
+  if(m_options.processes == 0){
+    m_options.processes = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+ProcessPool::~ProcessPool(){
+  stop();
+}
+
+std::size_t ProcessPool::processes() const noexcept{
+  return m_options.processes;
+}
+
+void ProcessPool::answer(std::uint64_t id, const PoolResult & result){
+  auto found = m_pending.find(id);
+  if(found == m_pending.end()) return;
+  found->second->result = result;
+  found->second->done = true;
+  m_pending.erase(found);
+  m_changed.notify_all();
+}
+
+PoolResult ProcessPool::evaluate(const std::string & program){
+
+  PoolResult result;
+  if(program.size() > POOL_PROGRAM_BYTES){
+    result.error = "Error: program too large for the process pool.";
+    return result;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  std::size_t index = 0;
+  m_changed.wait(lock, [&]{
+      if(m_stopping || (m_shared == nullptr)) return true;
+      for(index = 0; index < m_slots.size(); ++index){
+	if(m_slots[index].ready && !m_slots[index].busy) return true;
+      }
+      return false;
+    });
+  if(m_stopping || (m_shared == nullptr)){
+    result.error = "Error: the process pool is not running.";
+    return result;
+  }
+
+#if defined(__linux__)
+  Slot & slot = m_slots[index];
+  slot.busy = true;
+  slot.id = ++m_nextId;
+  slot.deadline = std::chrono::steady_clock::now() + m_options.timeout;
+
+  // the worker is blocked on its semaphore until the post
+  SharedSlot & shared = m_shared->slot(index);
+  std::memcpy(shared.program, program.data(), program.size());
+  shared.length = program.size();
+  shared.id = slot.id;
+  sem_post(&shared.request);
+
+  Pending pending;
+  m_pending[slot.id] = &pending;
+  m_changed.wait(lock, [&]{ return pending.done; });
+  result = pending.result;
+#endif
+
+  return result;
+}
+
+#if defined(__linux__)
+
+bool ProcessPool::start(std::string & message){
+  if(m_shared != nullptr) return true;
+
+  std::size_t slots = m_options.processes;
+  if(m_options.ringBytes < recordBytes(0)){
+    message = "the result ring of the process pool is too small";
+    return false;
+  }
+  m_sharedBytes = PoolShared::slotsOffset() + slots*sizeof(SharedSlot) + m_options.ringBytes;
+  void * memory = mmap(nullptr, m_sharedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(memory == MAP_FAILED){
+    message = std::string("cannot map the process pool: ") + std::strerror(errno);
+    return false;
+  }
+
+  PoolShared * shared = new (memory) PoolShared;
+  shared->stopping.store(false);
+  shared->slotCount = slots;
+  shared->ringBytes = m_options.ringBytes;
+  shared->head = 0;
+  shared->tail = 0;
+
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&shared->ringMutex, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+  sem_init(&shared->records, 1, 0);
+  for(std::size_t i = 0; i < slots; ++i){
+    SharedSlot * slot = new (&shared->slot(i)) SharedSlot;
+    slot->pid.store(0);
+    sem_init(&slot->request, 1, 0);
+  }
+
+  pid_t frontEnd = getpid();
+  pid_t pid = fork();
+  if(pid == 0){
+    runSpawner(*shared, m_prototype, frontEnd);
+  }
+  if(pid < 0){
+    message = std::string("cannot fork the process pool: ") + std::strerror(errno);
+    munmap(memory, m_sharedBytes);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shared = shared;
+  m_spawner = pid;
+  m_stopping = false;
+  m_slots.assign(slots, Slot());
+  m_collector = std::thread(&ProcessPool::collect, this);
+  return true;
+}
+
+void ProcessPool::stop(){
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if((m_shared == nullptr) || m_stopping) return;
+    m_stopping = true;
+    m_changed.notify_all();
+    PoolResult stopped;
+    stopped.error = "Error: the process pool stopped.";
+    while(!m_pending.empty()){
+      answer(m_pending.begin()->first, stopped);
+    }
+  }
+  m_collector.join();
+
+  // idle workers wake and exit, busy ones are killed; a worker forked
+  // meanwhile sees stopping or the post
+  m_shared->stopping.store(true);
+  for(std::size_t i = 0; i < m_shared->slotCount; ++i){
+    pid_t pid = m_shared->slot(i).pid.load();
+    if(pid > 0) kill(pid, SIGKILL);
+    sem_post(&m_shared->slot(i).request);
+  }
+  int status;
+  while((waitpid(m_spawner, &status, 0) < 0) && (errno == EINTR)){}
+
+  for(std::size_t i = 0; i < m_shared->slotCount; ++i){
+    sem_destroy(&m_shared->slot(i).request);
+  }
+  sem_destroy(&m_shared->records);
+  pthread_mutex_destroy(&m_shared->ringMutex);
+  munmap(m_shared, m_sharedBytes);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shared = nullptr;
+  m_spawner = -1;
+  m_slots.clear();
+}
+
+// kill the workers of requests past their deadline, with m_mutex held
+void ProcessPool::killExpired(){
+  if(m_options.timeout.count() <= 0) return;
+
+  auto now = std::chrono::steady_clock::now();
+  for(std::size_t i = 0; i < m_slots.size(); ++i){
+    Slot & slot = m_slots[i];
+    if(!slot.busy || (slot.deadline > now)) continue;
+
+    // the replacement announces itself with a ReadyRecord
+    pid_t pid = m_shared->slot(i).pid.load();
+    if(pid > 0) kill(pid, SIGKILL);
+    slot.busy = false;
+    slot.ready = false;
+    PoolResult timedOut;
+    timedOut.error = "Error: request timed out.";
+    answer(slot.id, timedOut);
+  }
+}
+
+void ProcessPool::collect(){
+  const std::chrono::milliseconds MAX_WAIT(100);
+
+  for(;;){
+    // wait for a record until the nearest deadline
+    std::chrono::nanoseconds wait = MAX_WAIT;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_stopping) return;
+      auto now = std::chrono::steady_clock::now();
+      for(auto & slot : m_slots){
+	if(slot.busy && (m_options.timeout.count() > 0)){
+	  wait = std::min(wait, std::max(std::chrono::nanoseconds(0),
+					 std::chrono::duration_cast<std::chrono::nanoseconds>(slot.deadline - now)));
+	}
+      }
+    }
+
+    timespec until = realtimeAfter(wait);
+    sem_timedwait(&m_shared->records, &until);
+
+    // a worker killed between writing a record and posting loses the post,
+    // so read every record in the ring rather than one per post
+    while(sem_trywait(&m_shared->records) == 0){}
+    RecordHeader header;
+    std::string data;
+    while(ringRead(*m_shared, header, data)){
+      PoolResult result;
+      if(header.kind == ValueRecord){
+	BindingList bindings;
+	result.ok = decodeBindings(data.data(), data.size(), bindings) && (bindings.size() == 1);
+	if(result.ok){
+	  result.value = bindings[0].second;
+	}
+	else{
+	  result.error = "Error: the process pool returned a malformed result.";
+	}
+      }
+      else{
+	result.error = data;
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(header.slot >= m_slots.size()) continue;
+      Slot & slot = m_slots[header.slot];
+      if(header.kind == ReadyRecord){
+	if(slot.busy){
+	  // the worker died during the request
+	  PoolResult died;
+	  died.error = "Error: the worker process died.";
+	  answer(slot.id, died);
+	  slot.busy = false;
+	}
+	slot.ready = true;
+	m_changed.notify_all();
+      }
+      else if(slot.busy && (slot.id == header.id)){
+	slot.busy = false;
+	answer(header.id, result);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    killExpired();
+  }
+}
+
+#else
+
+bool ProcessPool::start(std::string & message){
+  message = "the process pool needs Linux";
+  return false;
+}
+
+void ProcessPool::stop(){}
+
+void ProcessPool::collect(){}
+
+void ProcessPool::killExpired(){}
+
+#endif
@@ -0,0 +1,135 @@
+/*! \file pool.hpp
+Defines a pool of pre-forked processes evaluating plotscript programs.
+
+A ProcessPool forks, once, a spawner process holding a copy of a prototype
+Interpreter, which forks the worker processes, so each worker inherits the
+already-initialized interpreter copy-on-write and a replacement costs a
+fork rather than a start-up. Each request is evaluated in a fresh copy of
+the prototype in a worker, so requests are independent of each other.
+
+Programs are handed to a worker in a slot of a shared-memory segment, and
+results come back through a ring in the same segment as the serialized
+Expression (see serialize.hpp) or the error message. A request running past
+the timeout has its worker killed, and a worker that dies, killed or
+crashed, is replaced; its request is answered with an error and the process
+using the pool carries on. evaluate may be called from many threads at
+once, running up to one request per worker in parallel.
+
+The pool needs Linux; elsewhere start fails. start forks, so call it before
+the process starts other threads.
+ */
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "expression.hpp"
+#include "interpreter.hpp"
+
+/// the longest program a worker accepts
+const std::size_t POOL_PROGRAM_BYTES = 1 << 20;
+
+/// the options of a ProcessPool
+struct PoolOptions {
+  /// the worker processes, 0 for one per core
+  std::size_t processes = 0;
+
+  /// the longest a request may run, 0 for no limit
+  std::chrono::milliseconds timeout = std::chrono::milliseconds(10000);
+
+  /// the bytes of the result ring, which bound the size of a result
+  std::size_t ringBytes = 8 << 20;
+};
+
+/// the outcome of a request evaluated by a ProcessPool
+struct PoolResult {
+  /// true if value holds the result, false if error holds the error message
+  bool ok = false;
+  Expression value;
+  std::string error;
+};
+
+struct PoolShared;
+
+/*! \class ProcessPool
+\brief Evaluates programs in pre-forked worker processes
+*/
+class ProcessPool {
+public:
+
+  /*! Construct a pool whose workers evaluate in copies of prototype
+    \param prototype the interpreter each request starts from
+    \param options the worker processes, timeout and ring size
+   */
+  ProcessPool(const Interpreter & prototype, const PoolOptions & options);
+
+  /// stop the pool
+  ~ProcessPool();
+
+  ProcessPool(const ProcessPool &) = delete;
+  ProcessPool & operator=(const ProcessPool &) = delete;
+
+  /*! Fork the spawner and the workers
+    \param message set to the error on failure
+    \return true on success
+   */
+  bool start(std::string & message);
+
+  /*! Evaluate a program in a worker, waiting for one to be free
+    \param program the program text
+    \return the value, or the parse, evaluation, timeout or worker error
+   */
+  PoolResult evaluate(const std::string & program);
+
+  /// answer waiting requests with an error and end the processes
+  void stop();
+
+  /// return the number of worker processes
+  std::size_t processes() const noexcept;
+
+private:
+
+  // the state of a worker slot as seen by this process
+  struct Slot {
+    bool ready = false; // a worker waits for a request
+    bool busy = false; // a request was handed to the worker
+    std::uint64_t id = 0; // the request
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  // a request waiting for its answer
+  struct Pending {
+    bool done = false;
+    PoolResult result;
+  };
+
+  void collect();
+  void answer(std::uint64_t id, const PoolResult & result);
+  void killExpired();
+
+  Interpreter m_prototype;
+  PoolOptions m_options;
+  PoolShared * m_shared;
+  std::size_t m_sharedBytes;
+  int m_spawner;
+
+  // guards the members below
+  std::mutex m_mutex;
+  std::condition_variable m_changed; // a slot became ready or a request was answered
+  std::vector<Slot> m_slots;
+  std::map<std::uint64_t, Pending *> m_pending;
+  std::uint64_t m_nextId;
+  bool m_stopping;
+
+  std::thread m_collector; // reads the ring and kills expired workers
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pool.hpp"
+#include "interpreter.hpp"
+#include "test_helpers.hpp"
+
+Interpreter poolPrototype(){
+  Interpreter interp;
+  runProgram(interp, "(begin (define base 10) (define inc (lambda (x) (+ x 1))))");
+  return interp;
+}
+
+Expression evaluateHere(const std::string & program){
+  Interpreter interp = poolPrototype();
+  return runProgram(interp, program);
+}
+
+TEST_CASE( "Test process pool evaluates in workers", "[pool]" ) {
+
+  PoolOptions options;
+  options.processes = 2;
+  ProcessPool pool(poolPrototype(), options);
+  std::string message;
+  REQUIRE(pool.start(message));
+  REQUIRE(pool.processes() == 2);
+
+  std::vector<std::string> programs = {
+    "(inc base)",
+    "(list 1 (list \"two\" (+ 1 I)) pi)",
+    "(set-property \"note\" (list 1 2) (make-point 1 2))",
+    "(lambda (x) (* x base))",
+    "(discrete-plot (list (list 1 2) (list 2 3)) (list (list \"title\" \"t\")))",
+  };
+  for(auto & p : programs){
+    PoolResult result = pool.evaluate(p);
+    INFO(p);
+    REQUIRE(result.ok);
+    REQUIRE(result.value == evaluateHere(p));
+  }
+
+  // each request starts from the prototype
+  REQUIRE(pool.evaluate("(define base 1)").ok);
+  REQUIRE(pool.evaluate("(define base 1)").ok);
+  PoolResult result = pool.evaluate("(+ base 0)");
+  REQUIRE(result.ok);
+  REQUIRE(result.value == Expression(10.));
+
+  result = pool.evaluate("(+ 1 unknown)");
+  REQUIRE(!result.ok);
+  REQUIRE(result.error == "Error during evaluation: unknown symbol");
+  result = pool.evaluate("(+ 1");
+  REQUIRE(!result.ok);
+  REQUIRE(result.error == "Error: Invalid Program. Could not parse.");
+
+  pool.stop();
+  result = pool.evaluate("(+ 1 2)");
+  REQUIRE(!result.ok);
+  REQUIRE(result.error == "Error: the process pool is not running.");
+}
+
+TEST_CASE( "Test process pool serves concurrent requests", "[pool]" ) {
+
+  PoolOptions options;
+  options.processes = 3;
+  options.ringBytes = 4096; // wraps many times
+  ProcessPool pool(poolPrototype(), options);
+  std::string message;
+  REQUIRE(pool.start(message));
+
+  std::vector<std::thread> threads;
+  std::vector<int> wrong(6, 0);
+  for(int t = 0; t < 6; ++t){
+    threads.emplace_back([&pool, &wrong, t]{
+	for(int i = 0; i < 50; ++i){
+	  int n = 100*t + i;
+	  PoolResult result = pool.evaluate("(list " + std::to_string(n) + " (inc " + std::to_string(n) + "))");
+	  std::vector<Expression> expected = {Expression(double(n)), Expression(double(n + 1))};
+	  if(!result.ok || !(result.value == Expression(expected))) ++wrong[t];
+	}
+      });
+  }
+  for(auto & t : threads){
+    t.join();
+  }
+  for(int w : wrong){
+    REQUIRE(w == 0);
+  }
+
+  // a result that can never fit in the ring
+  PoolResult result = pool.evaluate("(range 0 10000 1)");
+  REQUIRE(!result.ok);
+  REQUIRE(result.error == "Error: result too large for the process pool.");
+}
+
+TEST_CASE( "Test process pool kills runaway requests", "[pool]" ) {
+
+  PoolOptions options;
+  options.processes = 1;
+  options.timeout = std::chrono::milliseconds(300);
+  ProcessPool pool(poolPrototype(), options);
+  std::string message;
+  REQUIRE(pool.start(message));
+
+  auto start = std::chrono::steady_clock::now();
+  PoolResult result = pool.evaluate("(begin (define g (lambda (x) (length (map inc (range 0 1000 1))))) (map g (range 0 1000000 1)))");
+  REQUIRE(!result.ok);
+  REQUIRE(result.error == "Error: request timed out.");
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+  // the killed worker is replaced
+  result = pool.evaluate("(inc base)");
+  REQUIRE(result.ok);
+  REQUIRE(result.value == Expression(11.));
+}
@@ -0,0 +1,126 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+
+// a call being timed on this thread
+struct ActiveCall {
+  std::string name;
+  bool lambda;
+  std::chrono::steady_clock::time_point start;
+  std::uint64_t childNs;
+};
+
+typedef std::pair<std::string, bool> ProfileKey;
+
+thread_local std::vector<ActiveCall> activeCalls;
+
+// the activations of each name on this thread's stack, for recursion
+thread_local std::map<ProfileKey, std::size_t> activeNames;
+
+std::mutex profileMutex;
+std::map<ProfileKey, ProfileEntry> profileTotals;
+
+ProfileEntry & totalsOf(const ProfileKey & key){
+  auto it = profileTotals.find(key);
+  if(it == profileTotals.end()){
+    it = profileTotals.emplace(key, ProfileEntry{key.first, key.second, 0, 0, 0, 0}).first;
+  }
+  return it->second;
+}
+
+void setProfiling(bool on) noexcept{
+  setInstrument(PROFILE_INSTRUMENT, on);
+}
+
+void enterProfile(const Atom & name, bool lambda){
+  activeCalls.push_back(ActiveCall{name.asSymbol(), lambda, std::chrono::steady_clock::now(), 0});
+  ++activeNames[ProfileKey(activeCalls.back().name, lambda)];
+}
+
+void exitProfile(){
+  if(activeCalls.empty()) return;
+
+  ActiveCall call = std::move(activeCalls.back());
+  activeCalls.pop_back();
+  std::uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - call.start).count();
+  if(!activeCalls.empty()){
+    activeCalls.back().childNs += elapsed;
+  }
+
+  ProfileKey key(std::move(call.name), call.lambda);
+  auto active = activeNames.find(key);
+  bool outermost = (--active->second == 0);
+  if(outermost){
+    activeNames.erase(active);
+  }
+
+  std::lock_guard<std::mutex> lock(profileMutex);
+  ProfileEntry & entry = totalsOf(key);
+  ++entry.calls;
+  if(outermost){
+    entry.inclusiveNs += elapsed;
+  }
+  entry.exclusiveNs += (elapsed > call.childNs) ? (elapsed - call.childNs) : 0;
+}
+
+void countArgumentAlloc(const Atom & name, bool lambda){
+  std::lock_guard<std::mutex> lock(profileMutex);
+  ++totalsOf(ProfileKey(name.asSymbol(), lambda)).argumentAllocs;
+}
+
+std::vector<ProfileEntry> profileReport(){
+  std::vector<ProfileEntry> report;
+  {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    for(auto & entry : profileTotals){
+      report.push_back(entry.second);
+    }
+  }
+
+  std::stable_sort(report.begin(), report.end(), [](const ProfileEntry & a, const ProfileEntry & b){
+      return a.exclusiveNs > b.exclusiveNs;
+    });
+  return report;
+}
+
+std::string formatProfile(){
+  std::vector<ProfileEntry> report = profileReport();
+
+  std::ostringstream out;
+  out << "Profile (" << (profiling() ? "on" : "off") << "): " << report.size()
+      << ((report.size() == 1) ? " entry." : " entries.");
+  if(report.empty()){
+    return out.str();
+  }
+
+  std::size_t width = 4;
+  for(auto & entry : report){
+    width = std::max(width, entry.name.size());
+  }
+
+  out << "\n" << std::left << std::setw(width) << "name" << std::right
+      << std::setw(8) << "kind" << std::setw(12) << "calls"
+      << std::setw(12) << "incl ms" << std::setw(12) << "excl ms"
+      << std::setw(12) << "arg allocs";
+  out << std::fixed << std::setprecision(3);
+  for(auto & entry : report){
+    out << "\n" << std::left << std::setw(width) << entry.name << std::right
+	<< std::setw(8) << (entry.lambda ? "lambda" : "builtin") << std::setw(12) << entry.calls
+	<< std::setw(12) << (entry.inclusiveNs / 1e6) << std::setw(12) << (entry.exclusiveNs / 1e6)
+	<< std::setw(12) << entry.argumentAllocs;
+  }
+  return out.str();
+}
+
+void clearProfile(){
+  std::lock_guard<std::mutex> lock(profileMutex);
+  profileTotals.clear();
+}
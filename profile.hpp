@@ -0,0 +1,83 @@
+/*! \file profile.hpp
+Defines the evaluation profiler.
+
+While profiling is on, the evaluator records for each built-in procedure and
+each lambda (by the symbol it is called through):
+
+- the number of calls
+- the inclusive wall time, the calls and everything they call; a recursive
+  call is counted once, in its outermost activation
+- the exclusive wall time, the inclusive time less that of the profiled
+  calls made from it
+- the number of times the argument stack grew while evaluating the operands
+  of its calls
+
+While it is off, the evaluator tests a single flag per call (see
+instrument.hpp). Each thread
+keeps its own stack of active calls; the totals are shared by all threads.
+ */
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "atom.hpp"
+#include "instrument.hpp"
+
+/// the totals of a profiled procedure or lambda
+struct ProfileEntry {
+  std::string name;
+  bool lambda;
+  std::uint64_t calls;
+  std::uint64_t inclusiveNs;
+  std::uint64_t exclusiveNs;
+  std::uint64_t argumentAllocs;
+};
+
+/// return true if profiling is on
+inline bool profiling() noexcept{
+  return instrumentOn(PROFILE_INSTRUMENT);
+}
+
+/// turn profiling on or off, keeping the totals
+void setProfiling(bool on) noexcept;
+
+/*! Start timing a call on the current thread
+  \param name the symbol the procedure or lambda is called through
+  \param lambda true for a lambda, false for a built-in procedure
+ */
+void enterProfile(const Atom & name, bool lambda);
+
+/// finish timing the most recent call entered on the current thread
+void exitProfile();
+
+/*! Count a growth of the argument stack while evaluating the operands of a
+  call of name
+  \param name the symbol the procedure or lambda is called through
+  \param lambda true for a lambda, false for a built-in procedure
+ */
+void countArgumentAlloc(const Atom & name, bool lambda);
+
+/// return the totals, the most exclusive time first
+std::vector<ProfileEntry> profileReport();
+
+/// return the totals as a text table
+std::string formatProfile();
+
+/// zero the totals
+void clearProfile();
+
+/*! \class ProfileCall
+\brief Times a call of a built-in procedure for its lifetime
+*/
+class ProfileCall {
+public:
+  ProfileCall(const Atom & name){ enterProfile(name, false); }
+  ~ProfileCall(){ exitProfile(); }
+  ProfileCall(const ProfileCall &) = delete;
+  ProfileCall & operator=(const ProfileCall &) = delete;
+};
+
+#endif
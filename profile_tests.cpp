@@ -0,0 +1,138 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "profile.hpp"
+#include "sampler.hpp"
+#include "trace.hpp"
+#include "directive.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+const ProfileEntry * findEntry(const std::vector<ProfileEntry> & report,
+			       const std::string & name, bool lambda){
+  for(auto & entry : report){
+    if((entry.name == name) && (entry.lambda == lambda)) return &entry;
+  }
+  return nullptr;
+}
+
+TEST_CASE( "Test profile counts calls and times", "[profile]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(define sq (lambda (x) (* x x)))");
+  runProgram(interp, "(define fact (lambda (n) (apply * (range 1 n 1))))");
+
+  clearProfile();
+  runProgram(interp, "(+ (sq 2) (sq 3))");
+  REQUIRE(profileReport().empty());
+
+  setProfiling(true);
+  runProgram(interp, "(map sq (list 1 2 3))");
+  runProgram(interp, "(+ (sq 2) (sq 3) (fact 5))");
+  setProfiling(false);
+
+  std::vector<ProfileEntry> report = profileReport();
+  const ProfileEntry * sq = findEntry(report, "sq", true);
+  const ProfileEntry * mul = findEntry(report, "*", false);
+  const ProfileEntry * add = findEntry(report, "+", false);
+  REQUIRE(sq != nullptr);
+  REQUIRE(mul != nullptr);
+  REQUIRE(add != nullptr);
+  REQUIRE(sq->calls == 5);
+  REQUIRE(mul->calls == 6);
+  REQUIRE(add->calls == 1);
+
+  // the time of a call includes that of the calls made from it
+  REQUIRE(sq->exclusiveNs <= sq->inclusiveNs);
+  REQUIRE(findEntry(report, "fact", true)->calls == 1);
+  const ProfileEntry * fact = findEntry(report, "fact", true);
+  REQUIRE(fact->inclusiveNs >= findEntry(report, "range", false)->inclusiveNs);
+  REQUIRE(fact->exclusiveNs <= fact->inclusiveNs);
+  for(std::size_t i = 1; i < report.size(); ++i){
+    REQUIRE(report[i - 1].exclusiveNs >= report[i].exclusiveNs);
+  }
+
+  // off, nothing more is recorded
+  runProgram(interp, "(sq 4)");
+  REQUIRE(findEntry(profileReport(), "sq", true)->calls == 5);
+  clearProfile();
+}
+
+TEST_CASE( "Test profile recursion and errors", "[profile]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(define f (lambda (x) (g x)))");
+  runProgram(interp, "(define g (lambda (x) (first x)))");
+
+  clearProfile();
+  setProfiling(true);
+  std::istringstream bad("(f (list))");
+  REQUIRE(interp.parseStream(bad));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+  // the calls an error ends are still counted
+  std::vector<ProfileEntry> report = profileReport();
+  REQUIRE(findEntry(report, "f", true)->calls == 1);
+  REQUIRE(findEntry(report, "g", true)->calls == 1);
+  REQUIRE(findEntry(report, "first", false)->calls == 1);
+
+  // the argument stack grows for the operands of the first call
+  runProgram(interp, "(define h (lambda (a b c d e) (+ a b c d e)))");
+  runProgram(interp, "(h 1 2 3 4 5)");
+  report = profileReport();
+  REQUIRE(findEntry(report, "h", true)->argumentAllocs > 0);
+  setProfiling(false);
+  clearProfile();
+}
+
+TEST_CASE( "Test profile directive", "[profile]" ) {
+
+  Interpreter interp;
+  std::string reply;
+  clearProfile();
+
+  REQUIRE(handleDirective(interp, "%profile report", reply));
+  REQUIRE(reply == "Profile (off): 0 entries.");
+
+  REQUIRE(handleDirective(interp, "%profile on", reply));
+  REQUIRE(reply == "Profiling on.");
+  REQUIRE(profiling());
+  runProgram(interp, "(begin (define k (lambda (x) (- x))) (k 1))");
+  REQUIRE(handleDirective(interp, "%profile off", reply));
+  REQUIRE(!profiling());
+
+  REQUIRE(handleDirective(interp, "%profile report", reply));
+  REQUIRE(reply.find("Profile (off): 2 entries.\nname") == 0);
+  REQUIRE(reply.find("\nk ") != std::string::npos);
+  REQUIRE(reply.find("\n- ") != std::string::npos);
+  REQUIRE(reply.find("lambda") != std::string::npos);
+
+  REQUIRE(handleDirective(interp, "%profile clear", reply));
+  REQUIRE(profileReport().empty());
+  REQUIRE(handleDirective(interp, "%profile", reply));
+  REQUIRE(reply.find("Error") == 0);
+  REQUIRE(handleDirective(interp, "%profile loud", reply));
+  REQUIRE(reply.find("Error") == 0);
+}
+
+TEST_CASE( "Test the instruments share one flag", "[profile]" ) {
+
+  REQUIRE(!instrumented());
+  setProfiling(true);
+  startTrace();
+  REQUIRE(instrumented());
+  REQUIRE(profiling());
+  REQUIRE(tracing());
+  REQUIRE(!sampling());
+
+  // turning one off leaves the others on
+  setProfiling(false);
+  REQUIRE(instrumented());
+  REQUIRE(!profiling());
+  REQUIRE(tracing());
+  stopTrace();
+  REQUIRE(!instrumented());
+}
@@ -0,0 +1,301 @@
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <signal.h>
+#include <sys/time.h>
+
+
+// the frame standing for those deeper than SHADOW_FRAMES
+const std::uint32_t DEEPER_FRAMES = 0;
+
+// how often the folding thread folds the rings
+const std::chrono::milliseconds FOLD_INTERVAL(20);
+
+struct Sample {
+  std::uint32_t depth;
+  std::uint32_t frames[SHADOW_FRAMES];
+};
+
+// the shadow stack of one thread, written only by it, and the samples its
+// signal handler takes
+struct ShadowStack {
+  std::uint32_t frames[SHADOW_FRAMES];
+  std::atomic<std::uint32_t> depth;
+  std::atomic<std::uint64_t> taken; // the samples ever taken
+  std::uint64_t folded; // the samples folded, guarded by samplerMutex
+  Sample samples[SAMPLE_RING_SIZE];
+};
+
+// guards everything below but the shadow stacks themselves
+std::mutex samplerMutex;
+
+// the shadow stacks of every thread, kept after a thread exits so its
+// samples can still be folded, and never destroyed as samples are written
+// at exit
+std::vector<ShadowStack *> & allShadows = *new std::vector<ShadowStack *>;
+
+std::vector<std::string> frameNames{"..."};
+std::unordered_map<std::string, std::uint32_t> frameIds;
+
+std::map<std::vector<std::uint32_t>, std::uint64_t> foldedCounts;
+std::uint64_t foldedTotal = 0;
+
+// read by the signal handler, so a plain pointer with no initializer to run
+thread_local ShadowStack * threadShadow = nullptr;
+
+// the folding thread, and the serialization of starting and stopping
+std::mutex controlMutex;
+std::thread folder;
+std::condition_variable foldWake;
+bool foldStop = false;
+
+ShadowStack * registerShadow(){
+  ShadowStack * shadow = new ShadowStack;
+  shadow->depth.store(0, std::memory_order_relaxed);
+  shadow->taken.store(0, std::memory_order_relaxed);
+  shadow->folded = 0;
+
+  std::lock_guard<std::mutex> lock(samplerMutex);
+  allShadows.push_back(shadow);
+  threadShadow = shadow;
+  return shadow;
+}
+
+std::uint32_t frameId(const std::string & name){
+  // most calls find the name without taking the lock
+  thread_local std::unordered_map<std::string, std::uint32_t> cached;
+  auto found = cached.find(name);
+  if(found != cached.end()){
+    return found->second;
+  }
+
+  std::uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    auto global = frameIds.find(name);
+    if(global == frameIds.end()){
+      global = frameIds.emplace(name, static_cast<std::uint32_t>(frameNames.size())).first;
+      frameNames.push_back(name);
+    }
+    id = global->second;
+  }
+  cached.emplace(name, id);
+  return id;
+}
+
+void pushShadowFrame(const Atom & name){
+  ShadowStack * shadow = (threadShadow != nullptr) ? threadShadow : registerShadow();
+
+  std::uint32_t depth = shadow->depth.load(std::memory_order_relaxed);
+  if(depth < SHADOW_FRAMES){
+    shadow->frames[depth] = frameId(name.asSymbol());
+  }
+  // the handler sees the frame before the depth that includes it
+  shadow->depth.store(depth + 1, std::memory_order_release);
+}
+
+void popShadowFrame() noexcept{
+  ShadowStack * shadow = threadShadow;
+  if(shadow == nullptr) return;
+
+  std::uint32_t depth = shadow->depth.load(std::memory_order_relaxed);
+  if(depth > 0){
+    shadow->depth.store(depth - 1, std::memory_order_release);
+  }
+}
+
+void takeSample() noexcept{
+  ShadowStack * shadow = threadShadow;
+  if(shadow == nullptr) return;
+
+  std::uint32_t depth = shadow->depth.load(std::memory_order_acquire);
+  if(depth == 0) return;
+
+  std::uint64_t n = shadow->taken.load(std::memory_order_relaxed);
+  Sample & sample = shadow->samples[n % SAMPLE_RING_SIZE];
+  sample.depth = depth;
+  std::copy(shadow->frames, shadow->frames + std::min<std::size_t>(depth, SHADOW_FRAMES), sample.frames);
+  shadow->taken.store(n + 1, std::memory_order_release);
+}
+
+void sampleSignal(int){
+  takeSample();
+}
+
+// fold the samples taken since the last fold, with samplerMutex held;
+// samples overwritten before they were folded are lost
+void foldSamples(){
+  std::vector<std::uint32_t> key;
+  for(auto shadow : allShadows){
+    std::uint64_t n = shadow->taken.load(std::memory_order_acquire);
+    std::uint64_t first = shadow->folded;
+    if(n - first > SAMPLE_RING_SIZE){
+      first = n - SAMPLE_RING_SIZE;
+    }
+
+    for(std::uint64_t i = first; i < n; ++i){
+      const Sample & sample = shadow->samples[i % SAMPLE_RING_SIZE];
+      key.assign(sample.frames, sample.frames + std::min<std::size_t>(sample.depth, SHADOW_FRAMES));
+      if(sample.depth > SHADOW_FRAMES){
+	key.push_back(DEEPER_FRAMES);
+      }
+      ++foldedCounts[key];
+      ++foldedTotal;
+    }
+    shadow->folded = n;
+  }
+}
+
+void foldLoop(){
+  std::unique_lock<std::mutex> lock(samplerMutex);
+  while(!foldStop){
+    foldWake.wait_for(lock, FOLD_INTERVAL);
+    foldSamples();
+  }
+}
+
+// set the profiling timer, an interval of 0 stops it
+bool setSampleTimer(long intervalUs){
+  itimerval timer;
+  timer.it_interval.tv_sec = intervalUs / 1000000;
+  timer.it_interval.tv_usec = intervalUs % 1000000;
+  timer.it_value = timer.it_interval;
+  return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+void stopSamplingAtExit(){
+  stopSampling();
+}
+
+bool startSampling(unsigned hz){
+  std::lock_guard<std::mutex> control(controlMutex);
+  if(hz == 0) return false;
+
+  // the handler stays installed, a late SIGPROF must not end the program
+  static bool installed = false;
+  if(!installed){
+    struct sigaction action;
+    action.sa_handler = sampleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if(sigaction(SIGPROF, &action, nullptr) != 0){
+      return false;
+    }
+    std::atexit(stopSamplingAtExit);
+    installed = true;
+  }
+
+  if(!folder.joinable()){
+    foldStop = false;
+    folder = std::thread(foldLoop);
+  }
+
+  setInstrument(SAMPLE_INSTRUMENT, true);
+  long intervalUs = std::max(1L, 1000000L / static_cast<long>(hz));
+  if(!setSampleTimer(intervalUs)){
+    setInstrument(SAMPLE_INSTRUMENT, false);
+    return false;
+  }
+  return true;
+}
+
+void stopSampling(){
+  std::lock_guard<std::mutex> control(controlMutex);
+
+  setSampleTimer(0);
+  setInstrument(SAMPLE_INSTRUMENT, false);
+
+  if(folder.joinable()){
+    {
+      std::lock_guard<std::mutex> lock(samplerMutex);
+      foldStop = true;
+    }
+    foldWake.notify_all();
+    folder.join();
+  }
+
+  std::lock_guard<std::mutex> lock(samplerMutex);
+  foldSamples();
+}
+
+void clearSamples(){
+  std::lock_guard<std::mutex> lock(samplerMutex);
+  for(auto shadow : allShadows){
+    shadow->folded = shadow->taken.load(std::memory_order_acquire);
+  }
+  foldedCounts.clear();
+  foldedTotal = 0;
+}
+
+std::uint64_t sampleCount(){
+  std::lock_guard<std::mutex> lock(samplerMutex);
+  foldSamples();
+  return foldedTotal;
+}
+
+std::string foldedStacks(){
+  std::vector<std::string> lines;
+  {
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    foldSamples();
+    for(auto & stack : foldedCounts){
+      std::string line;
+      for(auto id : stack.first){
+	if(!line.empty()) line += ";";
+	line += frameNames[id];
+      }
+      lines.push_back(line + " " + std::to_string(stack.second) + "\n");
+    }
+  }
+
+  std::sort(lines.begin(), lines.end());
+  std::string folded;
+  for(auto & line : lines){
+    folded += line;
+  }
+  return folded;
+}
+
+bool writeFoldedStacks(const std::string & path, std::string & message){
+  std::ofstream out(path);
+  if(out){
+    out << foldedStacks();
+  }
+  if(!out){
+    message = "could not write samples to " + path;
+    return false;
+  }
+  return true;
+}
+
+std::string samplePath;
+
+void writeSamplesAtExit(){
+  stopSampling();
+  std::string message;
+  if(!writeFoldedStacks(samplePath, message)){
+    std::cerr << "Error: " << message << std::endl;
+  }
+}
+
+bool sampleToFile(const std::string & path){
+  if(!startSampling(DEFAULT_SAMPLE_HZ)){
+    return false;
+  }
+  if(samplePath.empty()){
+    std::atexit(writeSamplesAtExit);
+  }
+  samplePath = path;
+  return true;
+}
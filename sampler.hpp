@@ -0,0 +1,104 @@
+/*! \file sampler.hpp
+Defines the sampling profiler of plotscript call chains.
+
+While sampling is on, each thread that evaluates keeps a shadow stack of the
+plotscript calls it is in, the symbols of lambdas and built-in procedures,
+outermost first. A profiling timer (SIGPROF, counting the CPU time of the
+process) interrupts whichever thread is running; the signal handler copies
+that thread's shadow stack into a ring of samples of its own, taking no lock
+and allocating nothing. A background thread folds the rings into counts of
+each distinct stack, which foldedStacks returns in the form read by
+flamegraph tools: one line per stack, the frames separated by ';' and
+followed by the number of samples.
+
+Only the outermost SHADOW_FRAMES frames of a stack are kept, deeper frames
+are folded into a frame named "...". Samples taken outside any plotscript
+call are not counted. While sampling is off, each call tests a single flag.
+ */
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "atom.hpp"
+#include "instrument.hpp"
+
+/// the frames of a shadow stack a sample keeps
+const std::size_t SHADOW_FRAMES = 64;
+
+/// the samples each thread's ring holds until they are folded
+const std::size_t SAMPLE_RING_SIZE = 1024;
+
+/// the sampling rate %sample on uses unless given one
+const unsigned DEFAULT_SAMPLE_HZ = 1000;
+
+/// return true if sampling is on
+inline bool sampling() noexcept{
+  return instrumentOn(SAMPLE_INSTRUMENT);
+}
+
+/*! Turn sampling on, keeping samples already folded
+  \param hz the samples per second of CPU time
+  \return false if the timer could not be started
+ */
+bool startSampling(unsigned hz);
+
+/// turn sampling off and fold the samples taken
+void stopSampling();
+
+/// drop the samples taken so far
+void clearSamples();
+
+/// enter a call of name on the current thread's shadow stack
+void pushShadowFrame(const Atom & name);
+
+/// leave the call most recently entered on the current thread's shadow stack
+void popShadowFrame() noexcept;
+
+/*! Sample the current thread's shadow stack, as the timer signal does
+  Safe to call from a signal handler.
+ */
+void takeSample() noexcept;
+
+/// return the number of samples folded so far
+std::uint64_t sampleCount();
+
+/// return the folded stacks, one "frame;frame;... count" line each, sorted
+std::string foldedStacks();
+
+/*! Write the folded stacks to a file
+  \param path the file to write
+  \param message set to the error if the file cannot be written
+  \return true on success
+ */
+bool writeFoldedStacks(const std::string & path, std::string & message);
+
+/*! Turn sampling on and write the folded stacks to a file when the program
+  exits
+  \param path the file to write
+  \return false if the timer could not be started
+ */
+bool sampleToFile(const std::string & path);
+
+/*! \class ShadowCall
+\brief Enters a call of a built-in procedure on the shadow stack for its
+lifetime, if sampling was on at its start
+*/
+class ShadowCall {
+public:
+  ShadowCall(const Atom & name): m_on(sampling()){
+    if(m_on) pushShadowFrame(name);
+  }
+  ~ShadowCall(){
+    if(m_on) popShadowFrame();
+  }
+  ShadowCall(const ShadowCall &) = delete;
+  ShadowCall & operator=(const ShadowCall &) = delete;
+
+private:
+  bool m_on;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "sampler.hpp"
+#include "directive.hpp"
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "scan.hpp"
+#include "semantic_error.hpp"
+
+const std::string SAMPLE_FILE = "sampler_test.folded";
+
+// a built-in sampling the shadow stack it is called in
+Expression sampleNow(ArgSpan args){
+  takeSample();
+  return args[0];
+}
+
+Expression sampleEval(Environment & env, const std::string & program){
+  Expression ast = parseFast(program);
+  REQUIRE(!ast.head().isNone());
+  return ast.eval(env);
+}
+
+TEST_CASE( "Test sampler folds the shadow stack", "[sampler]" ) {
+
+  Environment env;
+  env.add_proc(Atom("sample-now"), Procedure(sampleNow, 1, 1));
+  sampleEval(env, "(define f (lambda (x) (sample-now x)))");
+  sampleEval(env, "(define g (lambda (x) (f (sample-now x))))");
+
+  clearSamples();
+  sampleEval(env, "(f 1)");
+  takeSample();
+  REQUIRE(foldedStacks() == "");
+
+  setInstrument(SAMPLE_INSTRUMENT, true);
+  sampleEval(env, "(+ (f 1) (g 2))");
+  sampleEval(env, "(map f (list 1 2))");
+  sampleEval(env, "(apply g (list 3))");
+  setInstrument(SAMPLE_INSTRUMENT, false);
+
+  REQUIRE(foldedStacks() == "f;sample-now 3\ng;f;sample-now 2\ng;sample-now 2\n");
+  REQUIRE(sampleCount() == 7);
+
+  clearSamples();
+  REQUIRE(foldedStacks() == "");
+  REQUIRE(sampleCount() == 0);
+}
+
+TEST_CASE( "Test sampler unwinds the shadow stack on errors", "[sampler]" ) {
+
+  Environment env;
+  env.add_proc(Atom("sample-now"), Procedure(sampleNow, 1, 1));
+  sampleEval(env, "(define bad (lambda (x) (+ (sample-now x) (list 1))))");
+
+  clearSamples();
+  setInstrument(SAMPLE_INSTRUMENT, true);
+  REQUIRE_THROWS_AS(sampleEval(env, "(bad 1)"), SemanticError);
+  setInstrument(SAMPLE_INSTRUMENT, false);
+
+  // nothing is left on the stack
+  takeSample();
+  REQUIRE(foldedStacks() == "bad;sample-now 1\n");
+  clearSamples();
+}
+
+TEST_CASE( "Test sampler keeps the outermost frames", "[sampler]" ) {
+
+  clearSamples();
+  Atom frame("r");
+  for(std::size_t i = 0; i < SHADOW_FRAMES + 3; ++i){
+    pushShadowFrame(frame);
+  }
+  takeSample();
+  for(std::size_t i = 0; i < SHADOW_FRAMES + 3; ++i){
+    popShadowFrame();
+  }
+
+  std::string expected;
+  for(std::size_t i = 0; i < SHADOW_FRAMES; ++i){
+    expected += "r;";
+  }
+  REQUIRE(foldedStacks() == expected + "... 1\n");
+  clearSamples();
+}
+
+TEST_CASE( "Test sampler timer samples evaluation", "[sampler]" ) {
+
+  Interpreter interp;
+  std::istringstream define("(define spin (lambda (n) (apply + (map sin (range 0 n 1)))))");
+  REQUIRE(interp.parseStream(define));
+  interp.evaluate();
+
+  clearSamples();
+  REQUIRE(startSampling(2000));
+  REQUIRE(sampling());
+  for(int i = 0; (i < 1000) && (sampleCount() < 5); ++i){
+    std::istringstream program("(spin 20000)");
+    REQUIRE(interp.parseStream(program));
+    interp.evaluate();
+  }
+  stopSampling();
+  REQUIRE(!sampling());
+
+  // only the evaluating thread had frames, all under spin
+  std::string folded = foldedStacks();
+  REQUIRE(sampleCount() >= 5);
+  std::istringstream lines(folded);
+  std::string line;
+  while(std::getline(lines, line)){
+    REQUIRE(line.compare(0, 4, "spin") == 0);
+  }
+  clearSamples();
+}
+
+TEST_CASE( "Test sample directives", "[sampler]" ) {
+
+  Interpreter interp;
+  std::string reply;
+
+  clearSamples();
+  REQUIRE(handleDirective(interp, "%sample report", reply));
+  REQUIRE(reply == "No samples.");
+
+  REQUIRE(handleDirective(interp, "%sample on 0", reply));
+  REQUIRE(reply == "Error: %sample on takes a number of samples per second.");
+  REQUIRE(handleDirective(interp, "%sample on x", reply));
+  REQUIRE(reply == "Error: %sample on takes a number of samples per second.");
+  REQUIRE(!sampling());
+
+  REQUIRE(handleDirective(interp, "%sample on 500", reply));
+  REQUIRE(reply == "Sampling on at 500 Hz.");
+  REQUIRE(sampling());
+  REQUIRE(handleDirective(interp, "%sample off", reply));
+  REQUIRE(reply.compare(0, 14, "Sampling off, ") == 0);
+  REQUIRE(!sampling());
+
+  Atom frame("d");
+  pushShadowFrame(frame);
+  takeSample();
+  popShadowFrame();
+  REQUIRE(handleDirective(interp, "%sample report", reply));
+  REQUIRE(reply == "d 1");
+
+  REQUIRE(handleDirective(interp, "%sample dump " + SAMPLE_FILE, reply));
+  REQUIRE(reply == "Samples written to " + SAMPLE_FILE + ".");
+  std::ifstream in(SAMPLE_FILE);
+  std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  REQUIRE(written == "d 1\n");
+  std::remove(SAMPLE_FILE.c_str());
+
+  REQUIRE(handleDirective(interp, "%sample dump", reply));
+  REQUIRE(reply == "Error: %sample dump requires a file name.");
+  REQUIRE(handleDirective(interp, "%sample clear", reply));
+  REQUIRE(reply == "Samples cleared.");
+  REQUIRE(handleDirective(interp, "%sample report", reply));
+  REQUIRE(reply == "No samples.");
+  REQUIRE(handleDirective(interp, "%sample", reply));
+  REQUIRE(reply == "Error: %sample requires on [hz], off, report, dump file or clear.");
+}
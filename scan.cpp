@@ -0,0 +1,390 @@
+#include "scan.hpp"
+
+// system includes
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stack>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// module includes
+#include "trace.hpp"
+
+// define constants for special characters, these must agree with token.cpp
+const char SCAN_OPENCHAR = '(';
+const char SCAN_CLOSECHAR = ')';
+const char SCAN_COMMENTCHAR = ';';
+const char SCAN_QUOTECHAR = '"';
+
+// the scanner works on blocks of this many bytes, one bit per byte
+const std::size_t BLOCK_SIZE = 64;
+
+// white-space as classified by isspace in the "C" locale
+inline bool isSpace(char c){
+  return (c == ' ') || (c >= '\t' && c <= '\r');
+}
+
+// bit masks of the structural and white-space bytes in one block
+struct BlockMasks {
+  uint64_t structural;
+  uint64_t whitespace;
+};
+
+#if defined(__AVX2__)
+
+inline void compare32(const char * p, __m256i & ws, __m256i & st){
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  st = _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SCAN_OPENCHAR)),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SCAN_CLOSECHAR))),
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SCAN_QUOTECHAR)),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SCAN_COMMENTCHAR))));
+  // '\t' through '\r' is a contiguous range, bytes >= 0x80 compare negative
+  ws = _mm256_or_si256(
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+    _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v)));
+}
+
+BlockMasks classify(const char * p){
+  __m256i ws0, st0, ws1, st1;
+  compare32(p, ws0, st0);
+  compare32(p + 32, ws1, st1);
+
+  BlockMasks m;
+  m.structural = uint64_t(uint32_t(_mm256_movemask_epi8(st0))) |
+    (uint64_t(uint32_t(_mm256_movemask_epi8(st1))) << 32);
+  m.whitespace = uint64_t(uint32_t(_mm256_movemask_epi8(ws0))) |
+    (uint64_t(uint32_t(_mm256_movemask_epi8(ws1))) << 32);
+  return m;
+}
+
+#elif defined(SCAN_USE_SSE2)
+
+BlockMasks classify(const char * p){
+  const __m128i open = _mm_set1_epi8(SCAN_OPENCHAR);
+  const __m128i close = _mm_set1_epi8(SCAN_CLOSECHAR);
+  const __m128i quote = _mm_set1_epi8(SCAN_QUOTECHAR);
+  const __m128i comment = _mm_set1_epi8(SCAN_COMMENTCHAR);
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i low = _mm_set1_epi8('\t' - 1);
+  const __m128i high = _mm_set1_epi8('\r' + 1);
+
+  BlockMasks m = {0, 0};
+  for(std::size_t i = 0; i < BLOCK_SIZE; i += 16){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i st = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, open), _mm_cmpeq_epi8(v, close)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, comment)));
+    // '\t' through '\r' is a contiguous range, bytes >= 0x80 compare negative
+    __m128i ws = _mm_or_si128(
+      _mm_cmpeq_epi8(v, space),
+      _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmpgt_epi8(high, v)));
+    m.structural |= uint64_t(uint32_t(_mm_movemask_epi8(st)) & 0xffff) << i;
+    m.whitespace |= uint64_t(uint32_t(_mm_movemask_epi8(ws)) & 0xffff) << i;
+  }
+  return m;
+}
+
+#else
+
+BlockMasks classify(const char * p){
+  BlockMasks m = {0, 0};
+  for(std::size_t i = 0; i < BLOCK_SIZE; ++i){
+    char c = p[i];
+    if((c == SCAN_OPENCHAR) || (c == SCAN_CLOSECHAR) ||
+       (c == SCAN_QUOTECHAR) || (c == SCAN_COMMENTCHAR)){
+      m.structural |= uint64_t(1) << i;
+    }
+    else if(isSpace(c)){
+      m.whitespace |= uint64_t(1) << i;
+    }
+  }
+  return m;
+}
+
+#endif
+
+// append the offset of each set bit in mask, lowest first
+inline void flatten(uint64_t mask, std::size_t base, StructuralIndex & index){
+  while(mask != 0){
+#if defined(__GNUC__)
+    index.push_back(base + __builtin_ctzll(mask));
+#else
+    std::size_t bit = 0;
+    while(((mask >> bit) & 1) == 0) ++bit;
+    index.push_back(base + bit);
+#endif
+    mask &= mask - 1;
+  }
+}
+
+StructuralIndex scan(const std::string & text){
+  TraceSpan span("tokenize", "front end");
+
+  StructuralIndex index;
+  const char * data = text.data();
+  const std::size_t size = text.size();
+
+  // the top bit of the previous block's white-space, so runs that cross a
+  // block boundary are only recorded once
+  uint64_t carry = 0;
+
+  std::size_t offset = 0;
+  while(offset < size){
+    BlockMasks m;
+    std::size_t remaining = size - offset;
+    if(remaining >= BLOCK_SIZE){
+      m = classify(data + offset);
+    }
+    else{
+      // pad the final partial block with bytes that are never structural
+      char block[BLOCK_SIZE];
+      std::memset(block, 'x', BLOCK_SIZE);
+      std::memcpy(block, data + offset, remaining);
+      m = classify(block);
+    }
+
+    uint64_t wsStart = m.whitespace & ~((m.whitespace << 1) | carry);
+    carry = m.whitespace >> (BLOCK_SIZE - 1);
+
+    flatten(m.structural | wsStart, offset, index);
+    offset += BLOCK_SIZE;
+  }
+
+  return index;
+}
+
+// Walk the structural index of text, calling into sink for each token. The
+// rules mirror tokenize() exactly, including its treatment of comments (which
+// do not end a token) and unterminated strings. Sink methods return false to
+// stop the walk early.
+template<typename Sink>
+void walk(const std::string & text, Sink & sink){
+
+  const StructuralIndex index = scan(text);
+  const char * data = text.data();
+  const std::size_t size = text.size();
+
+  std::string token;
+  std::size_t last = 0; // start of characters not yet consumed
+
+  for(std::size_t k = 0; k < index.size(); ++k){
+    std::size_t p = index[k];
+
+    // already consumed by a string or comment
+    if(p < last) continue;
+
+    token.append(data + last, p - last);
+    char c = data[p];
+
+    if(c == SCAN_OPENCHAR){
+      if(!token.empty()){
+        if(!sink.atom(token)) return;
+        token.clear();
+      }
+      if(!sink.open()) return;
+      last = p + 1;
+    }
+    else if(c == SCAN_CLOSECHAR){
+      if(!token.empty()){
+        if(!sink.atom(token)) return;
+        token.clear();
+      }
+      if(!sink.close()) return;
+      last = p + 1;
+    }
+    else if(c == SCAN_QUOTECHAR){
+      const void * q = std::memchr(data + p + 1, SCAN_QUOTECHAR, size - p - 1);
+      if(q != nullptr){
+        last = static_cast<const char *>(q) - data + 1;
+        token.append(data + p, last - p);
+      }
+      else{
+        // tokenize() appends the EOF marker to an unterminated string
+        token.append(data + p, size - p);
+        token.push_back(static_cast<char>(std::char_traits<char>::eof()));
+        last = size;
+      }
+      if(!sink.atom(token)) return;
+      token.clear();
+    }
+    else if(c == SCAN_COMMENTCHAR){
+      const void * q = std::memchr(data + p + 1, '\n', size - p - 1);
+      if(q == nullptr){
+        last = size;
+        break;
+      }
+      last = static_cast<const char *>(q) - data + 1;
+
+      // a white-space run may begin inside the comment and continue past it
+      if((last < size) && isSpace(data[last])){
+        if(!token.empty()){
+          if(!sink.atom(token)) return;
+          token.clear();
+        }
+        while((last < size) && isSpace(data[last])) ++last;
+      }
+    }
+    else{
+      if(!token.empty()){
+        if(!sink.atom(token)) return;
+        token.clear();
+      }
+      last = p + 1;
+      while((last < size) && isSpace(data[last])) ++last;
+    }
+  }
+
+  token.append(data + last, size - last);
+  if(!token.empty()){
+    sink.atom(token);
+  }
+}
+
+// sink collecting a token sequence
+struct TokenSink {
+  TokenSequenceType tokens;
+
+  bool open(){
+    tokens.push_back(Token::TokenType::OPEN);
+    return true;
+  }
+  bool close(){
+    tokens.push_back(Token::TokenType::CLOSE);
+    return true;
+  }
+  bool atom(const std::string & str){
+    tokens.emplace_back(str);
+    return true;
+  }
+};
+
+TokenSequenceType tokenizeFast(const std::string & text){
+  TokenSink sink;
+  walk(text, sink);
+  return sink.tokens;
+}
+
+// Convert a token that is a plain decimal literal, [+-]digits[.digits][e[+-]digits]
+// (or with the leading digits omitted), to a double. Anything else, including
+// out-of-range values, is left for the Atom conversion, which has the final say.
+bool parseNumber(const std::string & str, double & value){
+
+  const char * p = str.c_str();
+  if((*p == '+') || (*p == '-')) ++p;
+
+  bool digits = false;
+  while(*p >= '0' && *p <= '9'){ ++p; digits = true; }
+  if(*p == '.'){
+    ++p;
+    while(*p >= '0' && *p <= '9'){ ++p; digits = true; }
+  }
+  if(!digits) return false;
+
+  if((*p == 'e') || (*p == 'E')){
+    ++p;
+    if((*p == '+') || (*p == '-')) ++p;
+    if(!(*p >= '0' && *p <= '9')) return false;
+    while(*p >= '0' && *p <= '9') ++p;
+  }
+  if(*p != '\0') return false;
+
+  errno = 0;
+  char * end = nullptr;
+  value = std::strtod(str.c_str(), &end);
+  return (errno != ERANGE) && (end == p) && std::isfinite(value);
+}
+
+// sink building the AST with the same state machine as parse()
+struct AstSink {
+  Expression ast;
+  std::stack<Expression *> stack;
+  std::vector<double> numbers; // pending numeric literals for stack.top()
+  bool athead = false;
+  bool done = false;
+  bool failed = false;
+
+  bool fail(){
+    failed = true;
+    return false;
+  }
+
+  void flushNumbers(){
+    for(auto v : numbers){
+      stack.top()->append(Atom(v));
+    }
+    numbers.clear();
+  }
+
+  bool open(){
+    if(done) return fail();
+    athead = true;
+    return true;
+  }
+
+  bool close(){
+    if(done || stack.empty()) return fail();
+    flushNumbers();
+    stack.pop();
+    if(stack.empty()) done = true;
+    return true;
+  }
+
+  bool atom(const std::string & str){
+    if(done) return fail();
+
+    double value;
+    bool number = parseNumber(str, value);
+
+    if(athead){
+      Atom a = number ? Atom(value) : Atom(Token(str));
+      if(a.isNone()) return fail();
+
+      if(stack.empty()){
+        ast.head() = a;
+        stack.push(&ast);
+      }
+      else{
+        flushNumbers();
+        stack.top()->append(a);
+        stack.push(stack.top()->tail());
+      }
+      athead = false;
+    }
+    else{
+      if(stack.empty()) return fail();
+
+      if(number){
+        numbers.push_back(value);
+      }
+      else{
+        Atom a = Atom(Token(str));
+        if(a.isNone()) return fail();
+        flushNumbers();
+        stack.top()->append(a);
+      }
+    }
+    return true;
+  }
+};
+
+Expression parseFast(const std::string & text) noexcept{
+
+  AstSink sink;
+  walk(text, sink);
+
+  if(sink.failed || !sink.stack.empty()){
+    return Expression();
+  }
+
+  return sink.ast;
+}
@@ -0,0 +1,56 @@
+/*! \file scan.hpp
+Defines the structural scanner, a fast front end to the tokenizer and parser.
+
+The scanner classifies the input 64 bytes at a time (using SSE2 or AVX2 when
+the compiler targets them, else a scalar loop) and records the position of
+every structural character: parentheses, quotes, comment starts and the first
+character of each run of white-space. Tokens are then cut directly from the
+index without visiting the characters in between.
+
+tokenize() and parse() remain the reference implementation; the functions
+below produce identical results.
+ */
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#include <string>
+#include <vector>
+
+#include "token.hpp"
+#include "expression.hpp"
+
+/*! \typedef StructuralIndex
+Offsets into the scanned text of each structural character, in order.
+ */
+typedef std::vector<std::size_t> StructuralIndex;
+
+/*! \fn StructuralIndex scan(const std::string & text)
+\brief Build the structural index of a text buffer
+
+\param text the input characters
+\return the offsets of every parenthesis, quote, comment start and
+        white-space run start in text
+ */
+StructuralIndex scan(const std::string & text);
+
+/*! \fn TokenSequenceType tokenizeFast(const std::string & text)
+\brief Split a buffer into a sequence of tokens using the structural index
+
+\param text the input characters
+\return the same sequence tokenize() produces for a stream of text
+ */
+TokenSequenceType tokenizeFast(const std::string & text);
+
+/*! \fn Expression parseFast(const std::string & text)
+\brief Parse a buffer directly into an expression using the structural index
+
+\param text the input characters
+\return the same expression parse(tokenize()) produces, or the None Expression
+
+No token sequence is materialized. Runs of plain numeric literals (such as the
+arguments of a large list) are converted in bulk into a vector of doubles
+before being appended, bypassing the stream based Atom conversion.
+ */
+Expression parseFast(const std::string & text) noexcept;
+
+#endif
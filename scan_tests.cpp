@@ -0,0 +1,119 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scan.hpp"
+#include "parse.hpp"
+
+// programs exercising the corner cases of the reference tokenizer
+const std::vector<std::string> SCAN_CORPUS = {
+  "",
+  "   \n\t ",
+  "(begin (define r 10) (* pi (* r r)))",
+  "( A a aa )aal ; a comment\n\n(aalii)) 3\n",
+  "(define a 1.2abc)",
+  "((begin (+ 1))))))",
+  "+ 1 2",
+  "()",
+  "(a (",
+  "(list 1 -2 +3 .5 -.25 6. 1e3 1E-3 2.5e+2 1e400 1e-400 1e 0x10 inf nan -)",
+  "(set-property \"name\" \"a string with ( parens ) and ; semi\" (list 1 2))",
+  "(list ab\"cd ef\"gh 1)",
+  "(list \"unterminated",
+  "(list ab;comment glues tokens\ncd ef)",
+  "(list ab;comment then space\n   cd)",
+  "(list 1;\n\n\n 2)",
+  "; only a comment",
+  "(+ 1 2) ; trailing comment without newline",
+  "(+ 1 2) (+ 3 4)",
+  "(\v+\f1\r2\t)",
+};
+
+void requireSameTokens(const std::string & text){
+  std::istringstream iss(text);
+  TokenSequenceType expected = tokenize(iss);
+  TokenSequenceType actual = tokenizeFast(text);
+
+  INFO(text);
+  REQUIRE(actual.size() == expected.size());
+  for(std::size_t i = 0; i < expected.size(); ++i){
+    REQUIRE(actual[i].type() == expected[i].type());
+    REQUIRE(actual[i].asString() == expected[i].asString());
+  }
+}
+
+void requireSameParse(const std::string & text){
+  std::istringstream iss(text);
+  Expression expected = parse(tokenize(iss));
+
+  INFO(text);
+  REQUIRE(parseFast(text) == expected);
+}
+
+// a long program whose tokens straddle the 64 byte block boundaries
+std::string longProgram(){
+  std::ostringstream oss;
+  oss << "(begin\n  (define data (list";
+  for(int i = 0; i < 500; ++i){
+    oss << (i % 7 == 0 ? "\n    " : " ") << (i * 0.37 - 40);
+    if(i % 50 == 0) oss << " ; block comment " << i << "\n  ";
+    if(i % 83 == 0) oss << " \"a string " << i << "\"";
+  }
+  oss << "))\n  (length data))";
+  return oss.str();
+}
+
+TEST_CASE( "Test structural index positions", "[scan]" ) {
+
+  std::string text = "(+  1\t\t(a))";
+
+  StructuralIndex index = scan(text);
+
+  // parens plus the start of each white-space run
+  std::vector<std::size_t> expected = {0, 2, 5, 7, 9, 10};
+  REQUIRE(index == expected);
+}
+
+TEST_CASE( "Test white-space run crossing a block boundary", "[scan]" ) {
+
+  std::string text(60, 'a');
+  text += std::string(10, ' ');
+  text += "b";
+
+  StructuralIndex index = scan(text);
+
+  REQUIRE(index.size() == 1);
+  REQUIRE(index[0] == 60);
+}
+
+TEST_CASE( "Test fast tokenizer matches reference tokenizer", "[scan]" ) {
+
+  for(auto & text : SCAN_CORPUS){
+    requireSameTokens(text);
+  }
+  requireSameTokens(longProgram());
+}
+
+TEST_CASE( "Test fast parser matches reference parser", "[scan]" ) {
+
+  for(auto & text : SCAN_CORPUS){
+    requireSameParse(text);
+  }
+
+  std::string program = longProgram();
+  requireSameParse(program);
+  REQUIRE(parseFast(program) != Expression());
+}
+
+TEST_CASE( "Test fast parser converts numeric runs", "[scan]" ) {
+
+  Expression exp = parseFast("(list 1 2.5 -3e2 x 4)");
+
+  std::vector<Expression> expected = {Expression(1.0), Expression(2.5),
+				      Expression(-300.0), Expression(Atom("x")),
+				      Expression(4.0)};
+
+  REQUIRE(exp == Expression(expected, Atom("list")));
+}
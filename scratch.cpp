@@ -0,0 +1,47 @@
+#include "scratch.hpp"
+
+#include <utility>
+
+// the outermost scope of this thread, which owns the pool
+thread_local ScratchScope * current = nullptr;
+
+ScratchScope::ScratchScope(){
+  if(current == nullptr){
+    m_free.reserve(MAX_SCRATCH_BUFFERS);
+    current = this;
+  }
+}
+
+ScratchScope::~ScratchScope(){
+  if(current == this){
+    current = nullptr;
+  }
+}
+
+std::size_t ScratchScope::pooled() noexcept{
+  return (current == nullptr) ? 0 : current->m_free.size();
+}
+
+std::vector<Expression> acquireScratch() noexcept{
+  std::vector<Expression> buffer;
+  if((current != nullptr) && !current->m_free.empty()){
+    buffer.swap(current->m_free.back());
+    current->m_free.pop_back();
+  }
+  return buffer;
+}
+
+void recycleScratch(std::vector<Expression> & buffer) noexcept{
+
+  // the elements are destroyed here either way
+  buffer.clear();
+  if((current == nullptr) || (buffer.capacity() == 0) ||
+     (buffer.capacity() > MAX_SCRATCH_CAPACITY) ||
+     (current->m_free.size() >= MAX_SCRATCH_BUFFERS)){
+    std::vector<Expression>().swap(buffer);
+    return;
+  }
+
+  // m_free is reserved, so this does not allocate
+  current->m_free.push_back(std::move(buffer));
+}
@@ -0,0 +1,60 @@
+/*! \file scratch.hpp
+Defines a pool of scratch buffers for the temporary Expression vectors of
+evaluation (operand values, the pending work of copies and destruction).
+
+While a ScratchScope is active on a thread, buffers handed back with
+recycleScratch are kept, emptied but with their capacity, and handed out
+again by acquireScratch instead of allocating. Values that escape an
+evaluation take their buffers with them by move, so nothing needs copying
+out of the pool. The kept buffers are freed when the outermost scope ends.
+ */
+#ifndef SCRATCH_HPP
+#define SCRATCH_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "expression.hpp"
+
+/// the most buffers a pool keeps
+const std::size_t MAX_SCRATCH_BUFFERS = 64;
+
+/// buffers with a larger capacity are freed rather than kept
+const std::size_t MAX_SCRATCH_CAPACITY = 4096;
+
+/*! \class ScratchScope
+\brief The lifetime of the scratch pool of the current thread
+
+The outermost scope on a thread owns the pool, nested scopes share it.
+*/
+class ScratchScope {
+public:
+
+  /// start a scope, creating the pool if no scope is active on this thread
+  ScratchScope();
+
+  /// end a scope, freeing the pool if this is the outermost scope
+  ~ScratchScope();
+
+  ScratchScope(const ScratchScope &) = delete;
+  ScratchScope & operator=(const ScratchScope &) = delete;
+
+  /// return the number of buffers kept by the pool of this thread
+  static std::size_t pooled() noexcept;
+
+private:
+
+  friend std::vector<Expression> acquireScratch() noexcept;
+  friend void recycleScratch(std::vector<Expression> & buffer) noexcept;
+
+  // the buffers available for reuse, in the outermost scope only
+  std::vector<std::vector<Expression>> m_free;
+};
+
+/// return an empty buffer, reusing a kept one if a scope is active
+std::vector<Expression> acquireScratch() noexcept;
+
+/// empty buffer, keeping its storage for reuse if a scope is active
+void recycleScratch(std::vector<Expression> & buffer) noexcept;
+
+#endif
@@ -0,0 +1,76 @@
+#include "catch.hpp"
+
+#include <sstream>
+
+#include "scratch.hpp"
+#include "interpreter.hpp"
+
+TEST_CASE( "Test scratch buffers without a scope", "[scratch]" ) {
+
+  REQUIRE(ScratchScope::pooled() == 0);
+
+  std::vector<Expression> buffer = acquireScratch();
+  buffer.push_back(Expression(1.));
+  recycleScratch(buffer);
+
+  REQUIRE(buffer.empty());
+  REQUIRE(buffer.capacity() == 0);
+  REQUIRE(ScratchScope::pooled() == 0);
+}
+
+TEST_CASE( "Test scratch buffers are reused within a scope", "[scratch]" ) {
+
+  const Expression * storage;
+  {
+    ScratchScope scope;
+
+    std::vector<Expression> buffer = acquireScratch();
+    buffer.assign(10, Expression(2.));
+    storage = buffer.data();
+    recycleScratch(buffer);
+    REQUIRE(ScratchScope::pooled() == 1);
+
+    {
+      // nested scopes share the pool
+      ScratchScope nested;
+      std::vector<Expression> again = acquireScratch();
+      REQUIRE(again.empty());
+      REQUIRE(again.capacity() >= 10);
+      REQUIRE(again.data() == storage);
+      REQUIRE(ScratchScope::pooled() == 0);
+      recycleScratch(again);
+    }
+    REQUIRE(ScratchScope::pooled() == 1);
+
+    // oversized buffers are not kept
+    std::vector<Expression> large(MAX_SCRATCH_CAPACITY + 1);
+    recycleScratch(large);
+    REQUIRE(large.capacity() == 0);
+    REQUIRE(ScratchScope::pooled() == 1);
+
+    // nor more than the pool holds
+    for(std::size_t i = 0; i < MAX_SCRATCH_BUFFERS + 1; ++i){
+      std::vector<Expression> small(1);
+      recycleScratch(small);
+    }
+    REQUIRE(ScratchScope::pooled() == MAX_SCRATCH_BUFFERS);
+  }
+  REQUIRE(ScratchScope::pooled() == 0);
+}
+
+TEST_CASE( "Test scratch pool during evaluation", "[scratch]" ) {
+
+  // values escaping the evaluation keep their buffers
+  Interpreter interp;
+  std::istringstream iss("(begin (define f (lambda (x) (list x (* x 2)))) (define a (map f (list 1 2 3))) (map first a))");
+  REQUIRE(interp.parseStream(iss));
+
+  Expression result = interp.evaluate();
+  REQUIRE(ScratchScope::pooled() == 0);
+  REQUIRE(result.isHeadList());
+  REQUIRE(result == Expression(std::vector<Expression>{Expression(1.), Expression(2.), Expression(3.)}));
+
+  std::istringstream again("(+ (first (rest (first (rest a)))) 1)");
+  REQUIRE(interp.parseStream(again));
+  REQUIRE(interp.evaluate() == Expression(5.));
+}
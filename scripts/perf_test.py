@@ -0,0 +1,158 @@
+"""Time the scripts of the performance corpus and compare them with a baseline.
+
+Each workload (a .pls file of the corpus) is run under plotscript several
+times and its fastest wall time is compared with the time recorded in the
+baseline JSON. A workload fails if it errors, or if it is slower than its
+baseline by more than its tolerance (a fraction of the baseline) plus a
+fixed slack that absorbs start-up noise. Workloads in the corpus without a
+baseline, and baselines without a workload, fail too.
+
+The baseline also records the time of a fixed pure-Python loop on the
+machine it was made on. Baseline times are scaled by the ratio of that loop's
+time here to its time there, so the comparison survives moving to a faster
+or slower machine; it does not survive changing the build type, so the
+baseline is only compared with builds of the type it records.
+
+usage: perf_test.py --plotscript PATH [--corpus DIR] [--baseline FILE]
+                    [--runs N] [--update]
+
+--update records the times of this run as the new baseline, keeping the
+tolerances of workloads already there.
+"""
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import time
+
+DEFAULT_TOLERANCE = 0.30
+SLACK_SECONDS = 0.05
+
+
+def calibrate():
+        """Return the fastest of three timings of a fixed CPU-bound loop."""
+        best = None
+        for _ in range(3):
+                start = time.perf_counter()
+                total = 0
+                for i in range(2000000):
+                        total += i * i % 7
+                elapsed = time.perf_counter() - start
+                best = elapsed if best is None else min(best, elapsed)
+        return best
+
+
+def run_workload(plotscript, path, runs):
+        """Return the fastest wall time of runs runs of path, or an error."""
+        best = None
+        for _ in range(runs):
+                start = time.perf_counter()
+                result = subprocess.run([plotscript, path], stdout=subprocess.PIPE,
+                                        stderr=subprocess.STDOUT)
+                elapsed = time.perf_counter() - start
+                output = result.stdout.decode(errors='replace').strip()
+                if result.returncode != 0 or output.startswith('Error'):
+                        return None, output.splitlines()[0] if output else 'exit status %d' % result.returncode
+                best = elapsed if best is None else min(best, elapsed)
+        return best, None
+
+
+def main():
+        parser = argparse.ArgumentParser(description='Plotscript performance regression test')
+        here = os.path.dirname(os.path.abspath(__file__))
+        corpus = os.path.join(here, '..', 'tests', 'perf')
+        parser.add_argument('--plotscript', required=True, help='the plotscript executable')
+        parser.add_argument('--corpus', default=corpus, help='the directory of .pls workloads')
+        parser.add_argument('--baseline', help='the baseline JSON (default: baseline.json in the corpus)')
+        parser.add_argument('--build-type', default='Release', help='the build type of plotscript')
+        parser.add_argument('--runs', type=int, default=5, help='the runs of each workload')
+        parser.add_argument('--update', action='store_true', help='record this run as the baseline')
+        args = parser.parse_args()
+
+        baseline_path = args.baseline or os.path.join(args.corpus, 'baseline.json')
+        workloads = sorted(glob.glob(os.path.join(args.corpus, '*.pls')))
+        if not workloads:
+                print('No workloads in ' + args.corpus)
+                return 1
+
+        baseline = {'workloads': {}}
+        if os.path.exists(baseline_path):
+                with open(baseline_path) as f:
+                        baseline = json.load(f)
+        elif not args.update:
+                print('No baseline ' + baseline_path + ', run with --update to record one')
+                return 1
+
+        if not args.update and baseline.get('build_type') != args.build_type:
+                print('The baseline is of a %s build, not %s' % (baseline.get('build_type'), args.build_type))
+                return 1
+
+        calibration = calibrate()
+        scale = 1.0
+        if not args.update:
+                scale = calibration / baseline['calibration_seconds']
+        print('Baseline times scaled by %.2f for the speed of this machine' % scale)
+
+        failed = False
+        times = {}
+        print('%-28s %10s %10s %10s  %s' % ('workload', 'seconds', 'expected', 'limit', 'result'))
+        for path in workloads:
+                name = os.path.splitext(os.path.basename(path))[0]
+                seconds, error = run_workload(args.plotscript, path, args.runs)
+                if error is not None:
+                        print('%-28s %10s %10s %10s  FAIL: %s' % (name, '-', '-', '-', error))
+                        failed = True
+                        continue
+                times[name] = seconds
+                if args.update:
+                        print('%-28s %10.3f %10s %10s  recorded' % (name, seconds, '-', '-'))
+                        continue
+
+                entry = baseline['workloads'].get(name)
+                if entry is None:
+                        print('%-28s %10.3f %10s %10s  FAIL: no baseline' % (name, seconds, '-', '-'))
+                        failed = True
+                        continue
+                expected = entry['seconds'] * scale
+                tolerance = entry.get('tolerance', baseline.get('default_tolerance', DEFAULT_TOLERANCE))
+                limit = expected * (1 + tolerance) + baseline.get('slack_seconds', SLACK_SECONDS)
+                if seconds > limit:
+                        result = 'FAIL: %.0f%% slower' % (100 * (seconds / expected - 1))
+                        failed = True
+                elif seconds < expected * (1 - tolerance):
+                        result = 'ok, %.0f%% faster, consider --update' % (100 * (1 - seconds / expected))
+                else:
+                        result = 'ok'
+                print('%-28s %10.3f %10.3f %10.3f  %s' % (name, seconds, expected, limit, result))
+
+        if not args.update:
+                for name in sorted(set(baseline['workloads']) - set(
+                                os.path.splitext(os.path.basename(p))[0] for p in workloads)):
+                        print('%-28s %10s %10s %10s  FAIL: workload missing' % (name, '-', '-', '-'))
+                        failed = True
+        elif not failed:
+                old = baseline.get('workloads', {})
+                baseline = {
+                        'build_type': args.build_type,
+                        'calibration_seconds': round(calibration, 4),
+                        'default_tolerance': baseline.get('default_tolerance', DEFAULT_TOLERANCE),
+                        'slack_seconds': baseline.get('slack_seconds', SLACK_SECONDS),
+                        'workloads': {},
+                }
+                for name in sorted(times):
+                        entry = {'seconds': round(times[name], 4)}
+                        if 'tolerance' in old.get(name, {}):
+                                entry['tolerance'] = old[name]['tolerance']
+                        baseline['workloads'][name] = entry
+                with open(baseline_path, 'w') as f:
+                        json.dump(baseline, f, indent=2, sort_keys=True)
+                        f.write('\n')
+                print('Baseline written to ' + baseline_path)
+
+        return 1 if failed else 0
+
+
+if __name__ == '__main__':
+        sys.exit(main())
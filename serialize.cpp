@@ -0,0 +1,370 @@
+#include "serialize.hpp"
+
+// system includes
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+const char IMAGE_MAGIC[4] = {'P', 'L', 'S', 'I'};
+
+// the kinds of node, these values are part of the format
+enum NodeKind : uint32_t { NoneNode, NumberNode, SymbolNode, ComplexNode,
+			   ListNode, LambdaNode, StringNode, DiscreteNode,
+			   ContinuousNode, PropertyNode };
+
+// a node as stored in the image
+struct Node {
+  uint32_t kind;
+  uint32_t payload; // string or number table index, or property key
+  uint32_t ntail;
+  uint32_t nprops;
+};
+
+/***********************************************************************
+Encoding
+**********************************************************************/
+
+class ImageWriter {
+public:
+
+  uint32_t intern(const std::string & str){
+    auto it = stringIds.find(str);
+    if(it != stringIds.end()) return it->second;
+
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.push_back(str);
+    stringIds.emplace(str, id);
+    return id;
+  }
+
+  uint32_t number(double value){
+    numbers.push_back(value);
+    return static_cast<uint32_t>(numbers.size() - 1);
+  }
+
+  // append the nodes of exp in pre-order, returning the index of its root
+  uint32_t add(const Expression & exp){
+
+    uint32_t root = static_cast<uint32_t>(nodes.size());
+
+    // pending work: an expression, or a property key (>= 0) to emit ahead of
+    // the expression holding its value
+    struct Item {
+      const Expression * exp;
+      long key;
+    };
+    std::vector<Item> stack = {{&exp, -1}};
+
+    // the property values, which properties() returns by value
+    std::deque<Expression> values;
+
+    while(!stack.empty()){
+      Item item = stack.back();
+      stack.pop_back();
+
+      if(item.key >= 0){
+	nodes.push_back({PropertyNode, static_cast<uint32_t>(item.key), 1, 0});
+	stack.push_back({item.exp, -1});
+	continue;
+      }
+
+      const Expression & e = *item.exp;
+      Node node = head(e.head());
+
+      std::vector<Item> children;
+      for(auto & p : e.properties()){
+	values.push_back(std::move(p.second));
+	children.push_back({&values.back(), static_cast<long>(intern(propertyKeyName(p.first)))});
+	++node.nprops;
+      }
+      for(auto t = e.tailConstBegin(); t != e.tailConstEnd(); ++t){
+	children.push_back({&*t, -1});
+	++node.ntail;
+      }
+      nodes.push_back(node);
+
+      stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+
+    return root;
+  }
+
+  std::string str(const std::vector<std::pair<uint32_t, uint32_t>> & bindings) const{
+    std::string out(IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    put(out, IMAGE_VERSION);
+
+    put(out, static_cast<uint32_t>(strings.size()));
+    for(auto & s : strings){
+      put(out, static_cast<uint32_t>(s.size()));
+      out.append(s);
+    }
+
+    put(out, static_cast<uint32_t>(numbers.size()));
+    out.append(reinterpret_cast<const char *>(numbers.data()),
+	       numbers.size()*sizeof(double));
+
+    put(out, static_cast<uint32_t>(nodes.size()));
+    out.append(reinterpret_cast<const char *>(nodes.data()),
+	       nodes.size()*sizeof(Node));
+
+    put(out, static_cast<uint32_t>(bindings.size()));
+    for(auto & b : bindings){
+      put(out, b.first);
+      put(out, b.second);
+    }
+
+    return out;
+  }
+
+private:
+
+  Node head(const Atom & a){
+    Node node = {NoneNode, 0, 0, 0};
+    if(a.isNumber()){
+      node.kind = NumberNode;
+      node.payload = number(a.asNumber());
+    }
+    else if(a.isComplex()){
+      node.kind = ComplexNode;
+      node.payload = number(a.asComplex().real());
+      number(a.asComplex().imag());
+    }
+    else if(a.isSymbol()){
+      node.kind = SymbolNode;
+      node.payload = intern(a.asSymbol());
+    }
+    else if(a.isString()){
+      node.kind = StringNode;
+      node.payload = intern(a.asString());
+    }
+    else if(a.isList()){
+      node.kind = ListNode;
+    }
+    else if(a.isLambda()){
+      node.kind = LambdaNode;
+    }
+    else if(a.isDiscrete()){
+      node.kind = DiscreteNode;
+    }
+    else if(a.isContinuous()){
+      node.kind = ContinuousNode;
+    }
+    return node;
+  }
+
+  static void put(std::string & out, uint32_t value){
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  std::vector<std::string> strings;
+  std::map<std::string, uint32_t> stringIds;
+  std::vector<double> numbers;
+  std::vector<Node> nodes;
+};
+
+std::string encodeBindings(const BindingList & bindings){
+
+  ImageWriter writer;
+  std::vector<std::pair<uint32_t, uint32_t>> roots;
+
+  for(auto & b : bindings){
+    uint32_t name = writer.intern(b.first);
+    roots.emplace_back(name, writer.add(b.second));
+  }
+
+  return writer.str(roots);
+}
+
+/***********************************************************************
+Decoding
+**********************************************************************/
+
+class ImageReader {
+public:
+
+  ImageReader(const char * data, std::size_t size): m_data(data), m_size(size), m_pos(0) {}
+
+  bool read(BindingList & bindings){
+
+    char magic[sizeof(IMAGE_MAGIC)];
+    uint32_t version;
+    if(!get(magic, sizeof(magic)) || (std::memcmp(magic, IMAGE_MAGIC, sizeof(magic)) != 0) ||
+       !get(version) || (version != IMAGE_VERSION)){
+      return false;
+    }
+
+    uint32_t count;
+    if(!get(count)) return false;
+    for(uint32_t i = 0; i < count; ++i){
+      uint32_t length;
+      if(!get(length) || (length > m_size - m_pos)) return false;
+      strings.emplace_back(m_data + m_pos, length);
+      m_pos += length;
+    }
+
+    if(!get(count) || (count > (m_size - m_pos)/sizeof(double))) return false;
+    numbers.resize(count);
+    get(numbers.data(), count*sizeof(double));
+
+    if(!get(count) || (count > (m_size - m_pos)/sizeof(Node))) return false;
+    nodes.resize(count);
+    get(nodes.data(), count*sizeof(Node));
+
+    if(!get(count)) return false;
+    bindings.clear();
+    for(uint32_t i = 0; i < count; ++i){
+      uint32_t name, root;
+      if(!get(name) || !get(root) || (name >= strings.size())) return false;
+
+      Expression exp;
+      if(!build(root, exp)) return false;
+      bindings.emplace_back(strings[name], exp);
+    }
+
+    return m_pos == m_size;
+  }
+
+private:
+
+  // rebuild the expression rooted at node index root, without recursion
+  bool build(uint32_t root, Expression & result){
+
+    // a node whose properties and tail are being rebuilt
+    struct Frame {
+      Node node;
+      Atom head;
+      std::string key; // set when the frame is a property node
+      std::vector<Expression> tail;
+      std::vector<std::pair<std::string, Expression>> props;
+      uint32_t remaining;
+    };
+    std::vector<Frame> stack;
+
+    uint32_t next = root;
+    while(true){
+      if(next >= nodes.size()) return false;
+
+      // open a frame for the next node in pre-order
+      Frame frame;
+      frame.node = nodes[next++];
+      frame.remaining = frame.node.ntail + frame.node.nprops;
+      if(frame.node.kind == PropertyNode){
+	if((frame.node.payload >= strings.size()) || (frame.node.ntail != 1) ||
+	   (frame.node.nprops != 0) || stack.empty()){
+	  return false;
+	}
+	frame.key = strings[frame.node.payload];
+      }
+      else if(!head(frame.node, frame.head)){
+	return false;
+      }
+      stack.push_back(std::move(frame));
+
+      // close every frame that is now complete, handing it to its parent
+      while(stack.back().remaining == 0){
+	Frame done = std::move(stack.back());
+	stack.pop_back();
+
+	// the children are moved, not copied, so decoding is linear in the
+	// number of nodes however deep the tree
+	Expression exp;
+	if(done.node.kind == PropertyNode){
+	  exp = std::move(done.tail[0]);
+	}
+	else{
+	  exp = Expression(done.head);
+	  for(auto & t : done.tail){
+	    exp.append(std::move(t));
+	  }
+	  for(auto & p : done.props){
+	    exp.setProperty(p.first, std::move(p.second));
+	  }
+	}
+
+	if(stack.empty()){
+	  result = std::move(exp);
+	  return true;
+	}
+
+	Frame & parent = stack.back();
+	if(done.node.kind == PropertyNode){
+	  if(parent.props.size() >= parent.node.nprops) return false;
+	  parent.props.emplace_back(done.key, std::move(exp));
+	}
+	else{
+	  // properties precede the tail
+	  if((parent.node.kind != PropertyNode) && (parent.props.size() < parent.node.nprops)){
+	    return false;
+	  }
+	  parent.tail.push_back(std::move(exp));
+	}
+	--parent.remaining;
+      }
+    }
+  }
+
+  bool head(const Node & node, Atom & a){
+    switch(node.kind){
+    case NoneNode:
+      break;
+    case NumberNode:
+      if(node.payload >= numbers.size()) return false;
+      a = Atom(numbers[node.payload]);
+      break;
+    case ComplexNode:
+      if(static_cast<std::size_t>(node.payload) + 1 >= numbers.size()) return false;
+      a = Atom(std::complex<double>(numbers[node.payload], numbers[node.payload + 1]));
+      break;
+    case SymbolNode:
+      if(node.payload >= strings.size()) return false;
+      a = Atom(strings[node.payload]);
+      if(!a.isSymbol()) return false;
+      break;
+    case StringNode:
+      if(node.payload >= strings.size()) return false;
+      a.setString(strings[node.payload]);
+      break;
+    case ListNode:
+      a.setList();
+      break;
+    case LambdaNode:
+      a.setLambda();
+      break;
+    case DiscreteNode:
+      a.setDiscretePlot();
+      break;
+    case ContinuousNode:
+      a.setContinuousPlot();
+      break;
+    default:
+      return false;
+    }
+    return true;
+  }
+
+  bool get(void * out, std::size_t n){
+    if(n == 0) return true;
+    if(n > m_size - m_pos) return false;
+    std::memcpy(out, m_data + m_pos, n);
+    m_pos += n;
+    return true;
+  }
+
+  bool get(uint32_t & value){
+    return get(&value, sizeof(value));
+  }
+
+  const char * m_data;
+  std::size_t m_size;
+  std::size_t m_pos;
+
+  std::vector<std::string> strings;
+  std::vector<double> numbers;
+  std::vector<Node> nodes;
+};
+
+bool decodeBindings(const char * data, std::size_t size, BindingList & bindings){
+  ImageReader reader(data, size);
+  return reader.read(bindings);
+}
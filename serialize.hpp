@@ -0,0 +1,49 @@
+/*! \file serialize.hpp
+Defines a compact binary encoding of Expressions.
+
+An encoded image holds a list of named Expressions (Bindings). Its layout is
+
+- a header: the magic bytes "PLSI" and a format version
+- a table of the distinct strings used (symbol names, string literals,
+  property keys and binding names), each stored once
+- a table of the numeric constants, packed as doubles (a complex number
+  takes two consecutive entries)
+- an array of fixed size nodes, in pre-order; each node holds its kind,
+  an index into the string or number table, and its property and tail
+  counts. A node's properties follow it as property nodes, each followed by
+  its value, then its tail Expressions
+- the bindings, as (string index, root node index) pairs
+
+All integers and doubles are stored in host byte order.
+ */
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "expression.hpp"
+#include "environment.hpp"
+
+/// the version of the encoding, bumped on any change to the layout
+const uint32_t IMAGE_VERSION = 1;
+
+/*! \fn std::string encodeBindings(const BindingList & bindings)
+\brief Encode a list of named Expressions, including their properties
+
+\param bindings the (name, expression) pairs to encode
+\return the encoded image
+ */
+std::string encodeBindings(const BindingList & bindings);
+
+/*! \fn bool decodeBindings(const char * data, std::size_t size, BindingList & bindings)
+\brief Rebuild the named Expressions from an encoded image
+
+\param data pointer to the first byte of the image
+\param size the number of bytes in the image
+\param bindings set to the decoded (name, expression) pairs
+\return false if the image is truncated, of another version, or malformed
+ */
+bool decodeBindings(const char * data, std::size_t size, BindingList & bindings);
+
+#endif
@@ -0,0 +1,178 @@
+#include "catch.hpp"
+
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "startup_config.hpp"
+#include "startup_image.hpp"
+#include "serialize.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+Expression evaluated(const std::string & program){
+  Interpreter interp;
+  std::ifstream ifs(STARTUP_FILE);
+  REQUIRE(interp.parseStream(ifs));
+  REQUIRE_NOTHROW(interp.evaluate());
+
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+// equality including properties, which Expression::operator== ignores
+bool identical(const Expression & a, const Expression & b){
+  if(!(a == b)) return false;
+
+  auto pa = a.properties();
+  auto pb = b.properties();
+  if(pa.size() != pb.size()) return false;
+  for(std::size_t i = 0; i < pa.size(); ++i){
+    if((pa[i].first != pb[i].first) || !identical(pa[i].second, pb[i].second)) return false;
+  }
+
+  for(auto ta = a.tailConstBegin(), tb = b.tailConstBegin(); ta != a.tailConstEnd(); ++ta, ++tb){
+    if(!identical(*ta, *tb)) return false;
+  }
+  return true;
+}
+
+Expression roundTrip(const Expression & exp){
+  std::string image = encodeBindings({{"x", exp}});
+
+  BindingList bindings;
+  REQUIRE(decodeBindings(image.data(), image.size(), bindings));
+  REQUIRE(bindings.size() == 1);
+  REQUIRE(bindings[0].first == "x");
+  return bindings[0].second;
+}
+
+TEST_CASE( "Test encoding atoms", "[serialize]" ) {
+
+  std::vector<Expression> atoms = {
+    Expression(),
+    Expression(3.25),
+    Expression(std::complex<double>(1, -2)),
+    Expression(Atom("symbol")),
+    Expression(Atom("\"a string\"")),
+    Expression(std::vector<Expression>()),
+  };
+
+  for(auto & a : atoms){
+    REQUIRE(identical(roundTrip(a), a));
+  }
+}
+
+TEST_CASE( "Test encoding expressions with properties", "[serialize]" ) {
+
+  std::vector<Expression> values = {
+    evaluated("(list 1 (list I \"two\") (list))"),
+    evaluated("(lambda (x y) (+ x (* y 2)))"),
+    evaluated("(make-line (make-point 0 1) (make-point 2 3))"),
+    evaluated("(make-text \"label\")"),
+    evaluated("(discrete-plot (list (list -1 -1) (list 1 1)) (list (list \"title\" \"The Title\")))"),
+  };
+
+  for(auto & v : values){
+    Expression decoded = roundTrip(v);
+    REQUIRE(identical(decoded, v));
+    REQUIRE(decoded.head().isLambda() == v.head().isLambda());
+  }
+
+  Expression text = roundTrip(values[3]);
+  REQUIRE(text.isText());
+  REQUIRE(text.getTextScale() == 1);
+  REQUIRE(text.getPosition().isPoint());
+}
+
+TEST_CASE( "Test encoding deeply nested expressions", "[serialize]" ) {
+
+  // decoding moves each finished node into its parent, so this is linear
+  // in the depth rather than quadratic
+  Expression deep(1.);
+  for(int i = 0; i < 20000; ++i){
+    Expression list{std::vector<Expression>()};
+    list.append(std::move(deep));
+    deep = std::move(list);
+  }
+  deep.setProperty("\"note\"", Expression(2.));
+
+  Expression decoded = roundTrip(deep);
+  REQUIRE(decoded == deep);
+  REQUIRE(decoded.getProperty(internPropertyKey("\"note\"")) == Expression(2.));
+}
+
+TEST_CASE( "Test encoding shares repeated strings", "[serialize]" ) {
+
+  std::string once = encodeBindings({{"a", Expression(Atom("a-long-symbol-name"))}});
+  std::string twice = encodeBindings({{"a", Expression(Atom("a-long-symbol-name"))},
+				      {"b", Expression(Atom("a-long-symbol-name"))}});
+
+  std::string name("a-long-symbol-name");
+  REQUIRE(twice.find(name) == once.find(name));
+  REQUIRE(twice.find(name, twice.find(name) + 1) == std::string::npos);
+}
+
+TEST_CASE( "Test decoding rejects malformed images", "[serialize]" ) {
+
+  std::string image = encodeBindings({{"x", evaluated("(make-point 1 2)")}});
+  BindingList bindings;
+
+  REQUIRE(decodeBindings(image.data(), image.size(), bindings));
+
+  // truncated at every length
+  for(std::size_t n = 0; n < image.size(); ++n){
+    REQUIRE(!decodeBindings(image.data(), n, bindings));
+  }
+
+  // trailing garbage
+  std::string longer = image + "x";
+  REQUIRE(!decodeBindings(longer.data(), longer.size(), bindings));
+
+  // wrong version
+  std::string other = image;
+  other[4] ^= 0x7f;
+  REQUIRE(!decodeBindings(other.data(), other.size(), bindings));
+
+  // a complex whose number index wraps past the end of the table
+  std::string complex = encodeBindings({{"c", Expression(Atom(std::complex<double>(1, 2)))}});
+  const uint32_t node[4] = {3, 0, 0, 0}; // ComplexNode with the first number
+  std::size_t at = complex.find(std::string(reinterpret_cast<const char *>(node), sizeof(node)));
+  REQUIRE(at != std::string::npos);
+  const uint32_t wrapping = 0xFFFFFFFF;
+  complex.replace(at + sizeof(uint32_t), sizeof(uint32_t), reinterpret_cast<const char *>(&wrapping), sizeof(wrapping));
+  REQUIRE(!decodeBindings(complex.data(), complex.size(), bindings));
+}
+
+TEST_CASE( "Test startup image matches the startup file", "[serialize]" ) {
+
+  Interpreter fromFile;
+  std::ifstream ifs(STARTUP_FILE);
+  REQUIRE(fromFile.parseStream(ifs));
+  REQUIRE_NOTHROW(fromFile.evaluate());
+
+  Interpreter fromImage;
+  REQUIRE(loadStartupImage(fromImage));
+
+  BindingList expected = fromFile.definitions();
+  BindingList actual = fromImage.definitions();
+
+  REQUIRE(actual.size() == expected.size());
+  for(std::size_t i = 0; i < expected.size(); ++i){
+    REQUIRE(actual[i].first == expected[i].first);
+    REQUIRE(identical(actual[i].second, expected[i].second));
+  }
+
+  std::istringstream iss("(make-point 1 2)");
+  REQUIRE(fromImage.parseStream(iss));
+  REQUIRE(fromImage.evaluate().isPoint());
+}
+
+TEST_CASE( "Test binding rejects non-symbols", "[serialize]" ) {
+
+  Interpreter interp;
+  REQUIRE_THROWS_AS(interp.bind({{"\"str\"", Expression(1.)}}), SemanticError);
+}
@@ -0,0 +1,520 @@
+#include "server.hpp"
+
+// system includes
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <sstream>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// module includes
+#include "directive.hpp"
+#include "expression.hpp"
+#include "pool.hpp"
+#include "semantic_error.hpp"
+
+// the deadlines of the running requests, earliest first
+typedef std::multimap<std::chrono::steady_clock::time_point, Session *> DeadlineMap;
+
+// a connection and its interpreter
+struct Session {
+  Session(int socket, const Interpreter & prototype):
+    fd(socket), interp(prototype), cancel(false), events(EPOLLIN), ending(false),
+    timed(false), scheduled(false), closed(false) {}
+
+  int fd;
+  Interpreter interp; // used by one worker at a time
+  std::string in; // bytes read and not yet framed, epoll loop only
+  std::string out; // bytes not yet written, epoll loop only
+  std::atomic<bool> cancel; // the cancel flag of the running request
+  std::uint32_t events; // the events the socket is watched for, epoll loop only
+  bool ending; // the client has shut down its side, epoll loop only
+
+  // the running request's entry in the server's deadlines, guarded by its mutex
+  DeadlineMap::iterator deadline;
+  bool timed;
+
+  std::mutex mutex; // guards the members below
+  std::deque<std::string> requests;
+  std::deque<std::string> responses;
+  bool scheduled; // queued for or held by a worker
+  bool closed; // the connection is gone
+};
+
+std::string encodeFrame(const std::string & payload){
+  std::uint32_t n = static_cast<std::uint32_t>(payload.size());
+  std::string frame;
+  frame.reserve(4 + payload.size());
+  frame.push_back(static_cast<char>((n >> 24) & 0xff));
+  frame.push_back(static_cast<char>((n >> 16) & 0xff));
+  frame.push_back(static_cast<char>((n >> 8) & 0xff));
+  frame.push_back(static_cast<char>(n & 0xff));
+  frame += payload;
+  return frame;
+}
+
+std::size_t frameLength(const std::string & buffer){
+  std::size_t n = 0;
+  for(int i = 0; i < 4; ++i){
+    n = (n << 8) | static_cast<unsigned char>(buffer[i]);
+  }
+  return n;
+}
+
+bool decodeFrame(std::string & buffer, std::string & payload){
+  if(buffer.size() < 4) return false;
+
+  std::size_t n = frameLength(buffer);
+  if(buffer.size() < 4 + n) return false;
+
+  payload.assign(buffer, 4, n);
+  buffer.erase(0, 4 + n);
+  return true;
+}
+
+Server::Server(const Interpreter & prototype, const ServerOptions & options):
+  m_prototype(prototype), m_options(options), m_listener(-1), m_epoll(-1),
+  m_wake(-1), m_stopping(false) {}
+
+#if defined(__linux__)
+
+Server::~Server(){
+  for(auto & s : m_sessions){
+    ::close(s.first);
+  }
+  if(m_listener >= 0){
+    ::close(m_listener);
+    unlink(m_path.c_str());
+  }
+  if(m_epoll >= 0) ::close(m_epoll);
+  if(m_wake >= 0) ::close(m_wake);
+}
+
+// return a socket bound to address, or -1 with errno set
+int bindSocket(const sockaddr_un & address){
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(fd < 0) return -1;
+  if(bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0){
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+// return true if a server accepts connections at address
+bool socketInUse(const sockaddr_un & address){
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd < 0) return false;
+  bool used = (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0);
+  ::close(fd);
+  return used;
+}
+
+bool Server::listen(const std::string & path, std::string & message){
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(path.empty() || (path.size() >= sizeof(address.sun_path))){
+    message = "invalid socket path " + path;
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+
+  int fd = bindSocket(address);
+  if((fd < 0) && (errno == EADDRINUSE) && !socketInUse(address)){
+    // left by a server that did not stop cleanly
+    unlink(path.c_str());
+    fd = bindSocket(address);
+  }
+  if(fd < 0){
+    message = "cannot listen on " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  if(::listen(fd, SOMAXCONN) != 0){
+    message = "cannot listen on " + path + ": " + std::strerror(errno);
+    ::close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if((m_epoll < 0) || (m_wake < 0)){
+    message = std::string("cannot start the server: ") + std::strerror(errno);
+    ::close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+
+  m_listener = fd;
+  m_path = path;
+
+  epoll_event event;
+  std::memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = m_listener;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listener, &event);
+  event.data.fd = m_wake;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &event);
+  return true;
+}
+
+void Server::stop() noexcept{
+  m_stopping.store(true);
+  wake();
+}
+
+void Server::wake() noexcept{
+  if(m_wake >= 0){
+    std::uint64_t one = 1;
+    ssize_t written = write(m_wake, &one, sizeof(one));
+    (void)written;
+  }
+}
+
+void Server::run(){
+  if(m_listener < 0) return;
+
+  std::size_t workers = m_options.workers;
+  if(workers == 0){
+    workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for(std::size_t i = 0; i < workers; ++i){
+    m_workers.emplace_back(&Server::work, this);
+  }
+
+  const int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  while(!m_stopping.load()){
+    int n = epoll_wait(m_epoll, events, MAX_EVENTS, cancelExpired());
+    for(int i = 0; i < n; ++i){
+      int fd = events[i].data.fd;
+      if(fd == m_listener){
+	accept();
+      }
+      else if(fd == m_wake){
+	std::uint64_t count;
+	while(read(m_wake, &count, sizeof(count)) > 0){}
+	deliverResponses();
+      }
+      else{
+	auto found = m_sessions.find(fd);
+	if(found == m_sessions.end()) continue;
+	std::shared_ptr<Session> session = found->second;
+	if(session->ending && (events[i].events & (EPOLLHUP | EPOLLERR))){
+	  // gone in both directions, so the responses cannot be delivered
+	  close(session);
+	  continue;
+	}
+	if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+	  readFrom(session);
+	}
+	if((events[i].events & EPOLLOUT) && !session->closed){
+	  writeTo(session);
+	}
+      }
+    }
+  }
+
+  // cancel what is running and stop the workers once they finish
+  std::vector<std::shared_ptr<Session>> sessions;
+  for(auto & s : m_sessions){
+    sessions.push_back(s.second);
+  }
+  for(auto & s : sessions){
+    close(s);
+  }
+  for(std::size_t i = 0; i < m_workers.size(); ++i){
+    m_ready.push(nullptr);
+  }
+  for(auto & t : m_workers){
+    t.join();
+  }
+  m_workers.clear();
+}
+
+void Server::accept(){
+  for(;;){
+    int fd = accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd < 0) return;
+
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0){
+      ::close(fd);
+      continue;
+    }
+    m_sessions[fd] = std::make_shared<Session>(fd, m_prototype);
+  }
+}
+
+void Server::readFrom(const std::shared_ptr<Session> & session){
+  char buffer[65536];
+  for(;;){
+    ssize_t n = read(session->fd, buffer, sizeof(buffer));
+    if(n > 0){
+      session->in.append(buffer, n);
+      continue;
+    }
+    if((n < 0) && (errno == EINTR)) continue;
+    if((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) break;
+    if(n < 0){
+      close(session);
+      return;
+    }
+    // the client has shut down its side: answer the requests read, then close
+    session->ending = true;
+    break;
+  }
+
+  std::string request;
+  bool schedule = false;
+  while(decodeFrame(session->in, request)){
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->requests.push_back(std::move(request));
+    if(!session->scheduled){
+      session->scheduled = true;
+      schedule = true;
+    }
+  }
+  if((session->in.size() >= 4) && (frameLength(session->in) > MAX_REQUEST_BYTES)){
+    close(session);
+    return;
+  }
+  if(schedule){
+    m_ready.push(session);
+  }
+  if(session->ending){
+    writeTo(session);
+  }
+}
+
+void Server::writeTo(const std::shared_ptr<Session> & session){
+  while(!session->out.empty()){
+    ssize_t n = send(session->fd, session->out.data(), session->out.size(), MSG_NOSIGNAL);
+    if(n > 0){
+      session->out.erase(0, n);
+      continue;
+    }
+    if((n < 0) && (errno == EINTR)) continue;
+    if((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) break;
+    close(session);
+    return;
+  }
+
+  // an ended session closes once everything read is answered and written
+  if(session->ending && session->out.empty()){
+    bool answered;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      answered = !session->scheduled && session->requests.empty() && session->responses.empty();
+    }
+    if(answered){
+      close(session);
+      return;
+    }
+  }
+
+  // watch for readability until the client ends, and for writability only
+  // while there is something to write
+  std::uint32_t events = 0;
+  if(!session->ending) events |= EPOLLIN;
+  if(!session->out.empty()) events |= EPOLLOUT;
+  if(events != session->events){
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = session->fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, session->fd, &event);
+    session->events = events;
+  }
+}
+
+void Server::close(const std::shared_ptr<Session> & session){
+  {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if(session->closed) return;
+    session->closed = true;
+    session->requests.clear();
+    session->cancel.store(true);
+  }
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, session->fd, nullptr);
+  ::close(session->fd);
+  m_sessions.erase(session->fd);
+}
+
+void Server::deliverResponses(){
+  std::vector<std::shared_ptr<Session>> done;
+  {
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    done.swap(m_done);
+  }
+
+  for(auto & session : done){
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      if(session->closed) continue;
+      for(auto & response : session->responses){
+	session->out += encodeFrame(response);
+      }
+      session->responses.clear();
+    }
+    writeTo(session);
+  }
+}
+
+// cancel the requests past their deadline, returning the milliseconds to
+// the next deadline, or -1 if there is none
+int Server::cancelExpired(){
+  std::lock_guard<std::mutex> lock(m_deadlineMutex);
+  auto now = std::chrono::steady_clock::now();
+  while(!m_deadlines.empty() && (m_deadlines.begin()->first <= now)){
+    Session * session = m_deadlines.begin()->second;
+    session->cancel.store(true);
+    session->timed = false;
+    m_deadlines.erase(m_deadlines.begin());
+  }
+  if(m_deadlines.empty()) return -1;
+  return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+    m_deadlines.begin()->first - now).count() + 1);
+}
+
+void Server::work(){
+  for(;;){
+    std::shared_ptr<Session> session;
+    m_ready.wait_and_pop(session);
+    if(!session) return;
+
+    std::string request;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      if(session->closed || session->requests.empty()){
+	session->scheduled = false;
+	continue;
+      }
+      request = std::move(session->requests.front());
+      session->requests.pop_front();
+      session->cancel.store(false);
+    }
+    if(m_options.timeout.count() > 0){
+      // the epoll loop waits for the new deadline
+      {
+	std::lock_guard<std::mutex> lock(m_deadlineMutex);
+	session->deadline = m_deadlines.emplace(std::chrono::steady_clock::now() + m_options.timeout,
+						 session.get());
+	session->timed = true;
+      }
+      wake();
+    }
+
+    std::string response = execute(*session, request);
+
+    {
+      std::lock_guard<std::mutex> lock(m_deadlineMutex);
+      if(session->timed){
+	m_deadlines.erase(session->deadline);
+	session->timed = false;
+      }
+    }
+
+    bool more = false;
+    {
+      std::lock_guard<std::mutex> lock(session->mutex);
+      if(!session->closed){
+	session->responses.push_back(std::move(response));
+	more = !session->requests.empty();
+      }
+      session->scheduled = more;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_doneMutex);
+      m_done.push_back(session);
+    }
+    wake();
+
+    if(more){
+      m_ready.push(session);
+    }
+  }
+}
+
+#else
+
+Server::~Server(){}
+
+bool Server::listen(const std::string &, std::string & message){
+  message = "the server needs Linux";
+  return false;
+}
+
+void Server::stop() noexcept{
+  m_stopping.store(true);
+}
+
+void Server::wake() noexcept{}
+
+void Server::run(){}
+
+#endif
+
+std::string Server::execute(Session & session, const std::string & request){
+
+  std::string reply;
+  char status = RESPONSE_VALUE;
+  if(m_options.pool != nullptr){
+    // the pool times requests out itself
+    if(!request.empty() && (request[0] == DIRECTIVE_CHAR)){
+      return std::string(1, RESPONSE_ERROR) + "Error: directives are not available with worker processes.";
+    }
+    PoolResult result = m_options.pool->evaluate(request);
+    if(!result.ok){
+      return std::string(1, RESPONSE_ERROR) + result.error;
+    }
+    std::ostringstream out;
+    out << result.value;
+    return std::string(1, RESPONSE_VALUE) + out.str();
+  }
+
+  setEvalCancelFlag(&session.cancel);
+  try{
+    std::istringstream program(request);
+    if(handleDirective(session.interp, request, reply)){
+      if(reply.compare(0, 6, "Error:") == 0) status = RESPONSE_ERROR;
+    }
+    else if(!session.interp.parseStream(program)){
+      reply = "Error: Invalid Program. Could not parse.";
+      status = RESPONSE_ERROR;
+    }
+    else{
+      std::ostringstream out;
+      out << session.interp.evaluate();
+      reply = out.str();
+    }
+  }
+  catch(const SemanticError & ex){
+    reply = session.cancel.load() ? "Error: request timed out." : ex.what();
+    status = RESPONSE_ERROR;
+  }
+  catch(const std::exception & ex){
+    reply = std::string("Error: ") + ex.what();
+    status = RESPONSE_ERROR;
+  }
+  setEvalCancelFlag(nullptr);
+
+  return std::string(1, status) + reply;
+}
@@ -0,0 +1,153 @@
+/*! \file server.hpp
+Defines the socket server run by plotscript --serve.
+
+A Server listens on a Unix-domain socket. Each connection is a session with
+an Interpreter of its own, a copy of a prototype that already has the
+startup definitions, so a request pays neither process start-up nor startup
+evaluation, definitions persist across the requests of a connection, and
+sessions do not see each other's definitions.
+
+Requests and responses are frames: a 4-byte big-endian length followed by
+that many bytes. A request is a program or a kernel directive (see
+directive.hpp). A response is a status byte, RESPONSE_VALUE or
+RESPONSE_ERROR, followed by the value as the REPL prints it or the error
+message. Each request gets one response, in order. A request longer than
+MAX_REQUEST_BYTES closes its connection. A client that shuts down its side
+of the connection still gets the responses to the requests it sent, after
+which the server closes the connection.
+
+One thread runs an epoll loop, accepting connections, reading requests and
+writing responses without blocking; a pool of worker threads evaluates them.
+A session runs at most one request at a time, on any worker, so sessions run
+in parallel across cores. A request still running after the timeout is
+cancelled (see setEvalCancelFlag) and answered with an error; the session
+remains usable.
+
+Given a ProcessPool (see pool.hpp), the server instead evaluates each
+request in a worker process, independently of the requests before it, and
+the pool kills a request running past its own timeout.
+
+The server needs Linux (epoll and eventfd); elsewhere listen fails.
+ */
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "message_queue.hpp"
+
+class ProcessPool;
+
+/// the longest request accepted
+const std::size_t MAX_REQUEST_BYTES = 16 << 20;
+
+/// the status byte of a response holding a value
+const char RESPONSE_VALUE = 0;
+
+/// the status byte of a response holding an error message
+const char RESPONSE_ERROR = 1;
+
+/// the options of a Server
+struct ServerOptions {
+  /// the worker threads, 0 for one per core
+  std::size_t workers = 0;
+
+  /// the longest a request may run, 0 for no limit
+  std::chrono::milliseconds timeout = std::chrono::milliseconds(10000);
+
+  /// the started pool evaluating requests, or nullptr to evaluate them in the sessions
+  ProcessPool * pool = nullptr;
+};
+
+/// return payload as a frame
+std::string encodeFrame(const std::string & payload);
+
+/*! Take the first frame from a buffer
+  \param buffer the bytes received so far, the frame is removed from its front
+  \param payload set to the payload of the frame
+  \return true if buffer began with a whole frame
+ */
+bool decodeFrame(std::string & buffer, std::string & payload);
+
+/// return the length of the frame at the front of buffer, which must hold at least 4 bytes
+std::size_t frameLength(const std::string & buffer);
+
+struct Session;
+
+/*! \class Server
+\brief Serves sessions of plotscript evaluation on a Unix-domain socket
+*/
+class Server {
+public:
+
+  /*! Construct a server whose sessions start as copies of prototype
+    \param prototype the interpreter each session copies
+    \param options the worker threads and request timeout
+   */
+  Server(const Interpreter & prototype, const ServerOptions & options);
+
+  /// close the socket and any connections left
+  ~Server();
+
+  Server(const Server &) = delete;
+  Server & operator=(const Server &) = delete;
+
+  /*! Listen on a socket, replacing a stale socket file
+    \param path the path of the socket
+    \param message set to the error on failure
+    \return true on success
+   */
+  bool listen(const std::string & path, std::string & message);
+
+  /// serve connections until stop is called, then cancel running requests and wait for them
+  void run();
+
+  /// make run return, safe to call from a signal handler or another thread
+  void stop() noexcept;
+
+private:
+
+  void accept();
+  void readFrom(const std::shared_ptr<Session> & session);
+  void writeTo(const std::shared_ptr<Session> & session);
+  void close(const std::shared_ptr<Session> & session);
+  void deliverResponses();
+  void wake() noexcept;
+  int cancelExpired();
+  void work();
+  std::string execute(Session & session, const std::string & request);
+
+  Interpreter m_prototype;
+  ServerOptions m_options;
+  std::string m_path;
+  int m_listener;
+  int m_epoll;
+  int m_wake; // an eventfd, written to wake the epoll loop
+  std::atomic<bool> m_stopping;
+
+  // the sessions by socket, used by the epoll loop only
+  std::map<int, std::shared_ptr<Session>> m_sessions;
+
+  // the sessions with requests waiting for a worker, nullptr to stop one
+  MessageQueue<std::shared_ptr<Session>> m_ready;
+  std::vector<std::thread> m_workers;
+
+  // the sessions with responses for the epoll loop to write
+  std::mutex m_doneMutex;
+  std::vector<std::shared_ptr<Session>> m_done;
+
+  // the deadlines of the running requests, earliest first
+  std::mutex m_deadlineMutex;
+  std::multimap<std::chrono::steady_clock::time_point, Session *> m_deadlines;
+};
+
+#endif
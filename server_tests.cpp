@@ -0,0 +1,227 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.hpp"
+#include "pool.hpp"
+#include "interpreter.hpp"
+#include "test_helpers.hpp"
+
+const std::string SERVER_SOCKET = "server_test.sock";
+
+// a server on SERVER_SOCKET run by a thread of its own
+class ServerThread {
+public:
+  ServerThread(const Interpreter & prototype, const ServerOptions & options):
+    server(prototype, options){
+    std::string message;
+    REQUIRE(server.listen(SERVER_SOCKET, message));
+    thread = std::thread([this]{ server.run(); });
+  }
+
+  ~ServerThread(){
+    server.stop();
+    thread.join();
+  }
+
+  Server server;
+  std::thread thread;
+};
+
+// a blocking connection to SERVER_SOCKET
+class ServerClient {
+public:
+  ServerClient(){
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, SERVER_SOCKET.c_str());
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+  }
+
+  ~ServerClient(){
+    ::close(fd);
+  }
+
+  void sendBytes(const std::string & bytes){
+    REQUIRE(::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size()));
+  }
+
+  void send(const std::string & request){
+    sendBytes(encodeFrame(request));
+  }
+
+  // return the next response, or "closed" if the server closed the connection
+  std::string receive(){
+    std::string payload;
+    char bytes[4096];
+    while(!decodeFrame(buffer, payload)){
+      ssize_t n = read(fd, bytes, sizeof(bytes));
+      if(n <= 0) return "closed";
+      buffer.append(bytes, n);
+    }
+    return payload;
+  }
+
+  std::string request(const std::string & program){
+    send(program);
+    return receive();
+  }
+
+  int fd;
+  std::string buffer; // bytes received and not yet framed
+};
+
+std::string serverValue(const std::string & text){
+  return std::string(1, RESPONSE_VALUE) + text;
+}
+
+std::string serverError(const std::string & text){
+  return std::string(1, RESPONSE_ERROR) + text;
+}
+
+Interpreter serverPrototype(){
+  Interpreter interp;
+  runProgram(interp, "(define base 10)");
+  return interp;
+}
+
+TEST_CASE( "Test server frames", "[server]" ) {
+
+  std::string frame = encodeFrame("(+ 1 2)");
+  REQUIRE(frame.size() == 11);
+  REQUIRE(frame.compare(0, 4, std::string("\0\0\0\7", 4)) == 0);
+  REQUIRE(frameLength(frame) == 7);
+
+  std::string buffer = frame.substr(0, 6);
+  std::string payload;
+  REQUIRE(!decodeFrame(buffer, payload));
+  buffer += frame.substr(6) + encodeFrame("");
+  REQUIRE(decodeFrame(buffer, payload));
+  REQUIRE(payload == "(+ 1 2)");
+  REQUIRE(decodeFrame(buffer, payload));
+  REQUIRE(payload == "");
+  REQUIRE(buffer.empty());
+  REQUIRE(!decodeFrame(buffer, payload));
+
+  std::string big(300, 'a');
+  REQUIRE(frameLength(encodeFrame(big)) == 300);
+}
+
+TEST_CASE( "Test server sessions", "[server]" ) {
+
+  ServerOptions options;
+  options.workers = 2;
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient first, second;
+  REQUIRE(first.request("(+ base 1)") == serverValue("(11)"));
+  REQUIRE(first.request("(define a 5)") == serverValue("(5)"));
+  REQUIRE(first.request("(* a 2)") == serverValue("(10)"));
+
+  // definitions do not leak between sessions
+  REQUIRE(second.request("(define base 1)") == serverValue("(1)"));
+  REQUIRE(second.request("(* a 2)") == serverError("Error during evaluation: unknown symbol"));
+  REQUIRE(first.request("(+ base a)") == serverValue("(15)"));
+
+  REQUIRE(first.request("(+ 1") == serverError("Error: Invalid Program. Could not parse."));
+  REQUIRE(first.request("%memo capacity x") == serverError("Error: %memo capacity requires a number of entries."));
+  REQUIRE(first.request("%memo clear") == serverValue("Memo cache cleared."));
+}
+
+TEST_CASE( "Test server answers pipelined requests in order", "[server]" ) {
+
+  ServerOptions options;
+  options.workers = 4;
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient client;
+  std::string requests;
+  for(int i = 0; i < 50; ++i){
+    requests += encodeFrame("(define n" + std::to_string(i) + " " + std::to_string(i) + ")");
+  }
+  client.sendBytes(requests);
+  for(int i = 0; i < 50; ++i){
+    REQUIRE(client.receive() == serverValue("(" + std::to_string(i) + ")"));
+  }
+}
+
+TEST_CASE( "Test server answers a client that shut down its side", "[server]" ) {
+
+  ServerOptions options;
+  options.workers = 2;
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient client;
+  client.sendBytes(encodeFrame("(define a 4)") + encodeFrame("(* a base)"));
+  REQUIRE(shutdown(client.fd, SHUT_WR) == 0);
+  REQUIRE(client.receive() == serverValue("(4)"));
+  REQUIRE(client.receive() == serverValue("(40)"));
+  REQUIRE(client.receive() == "closed");
+}
+
+TEST_CASE( "Test server cancels requests past the timeout", "[server]" ) {
+
+  ServerOptions options;
+  options.workers = 2;
+  options.timeout = std::chrono::milliseconds(300);
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient slow, fast;
+  REQUIRE(slow.request("(define f (lambda (x) (+ x 1)))")[0] == RESPONSE_VALUE);
+  REQUIRE(slow.request("(define g (lambda (x) (length (map f (range 0 1000 1)))))")[0] == RESPONSE_VALUE);
+  slow.send("(map g (range 0 100000 1))");
+
+  // another session is served while the slow request runs
+  REQUIRE(fast.request("(+ base 2)") == serverValue("(12)"));
+
+  REQUIRE(slow.receive() == serverError("Error: request timed out."));
+  REQUIRE(slow.request("(f base)") == serverValue("(11)"));
+}
+
+TEST_CASE( "Test server closes connections sending oversize requests", "[server]" ) {
+
+  ServerOptions options;
+  options.workers = 1;
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient bad, good;
+  std::string header = encodeFrame(std::string(4, 'a')).substr(0, 4);
+  std::size_t n = MAX_REQUEST_BYTES + 1;
+  header[0] = static_cast<char>((n >> 24) & 0xff);
+  header[1] = static_cast<char>((n >> 16) & 0xff);
+  header[2] = static_cast<char>((n >> 8) & 0xff);
+  header[3] = static_cast<char>(n & 0xff);
+  bad.sendBytes(header);
+  REQUIRE(bad.receive() == "closed");
+
+  REQUIRE(good.request("(+ base 3)") == serverValue("(13)"));
+}
+
+TEST_CASE( "Test server evaluates in a process pool", "[server]" ) {
+
+  PoolOptions poolOptions;
+  poolOptions.processes = 2;
+  ProcessPool pool(serverPrototype(), poolOptions);
+  std::string message;
+  REQUIRE(pool.start(message));
+
+  ServerOptions options;
+  options.workers = 2;
+  options.pool = &pool;
+  ServerThread server(serverPrototype(), options);
+
+  ServerClient client;
+  REQUIRE(client.request("(define a (+ base 1))") == serverValue("(11)"));
+  REQUIRE(client.request("(+ a 1)") == serverError("Error during evaluation: unknown symbol"));
+  REQUIRE(client.request("%memo") == serverError("Error: directives are not available with worker processes."));
+}
@@ -0,0 +1,70 @@
+#include "session.hpp"
+
+// system includes
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// module includes
+#include "semantic_error.hpp"
+#include "serialize.hpp"
+
+const char SESSION_MAGIC[4] = {'P', 'L', 'S', 'S'};
+
+bool saveSession(const Interpreter & interp, const std::string & filename,
+		 std::string & message){
+
+  std::string out(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+  out.append(reinterpret_cast<const char *>(&SESSION_VERSION), sizeof(SESSION_VERSION));
+  out.append(encodeBindings(interp.definitions()));
+
+  std::ofstream ofs(filename, std::ios::binary);
+  ofs.write(out.data(), out.size());
+  if(!ofs){
+    message = "Could not open file for writing.";
+    return false;
+  }
+  return true;
+}
+
+bool loadSession(Interpreter & interp, const std::string & filename,
+		 std::string & message){
+
+  std::ifstream ifs(filename, std::ios::binary);
+  if(!ifs){
+    message = "Could not open file for reading.";
+    return false;
+  }
+  std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+  const std::size_t header = sizeof(SESSION_MAGIC) + sizeof(SESSION_VERSION);
+  uint32_t version;
+  if((data.size() < header) ||
+     (std::memcmp(data.data(), SESSION_MAGIC, sizeof(SESSION_MAGIC)) != 0)){
+    message = "Not a session snapshot.";
+    return false;
+  }
+  std::memcpy(&version, data.data() + sizeof(SESSION_MAGIC), sizeof(version));
+  if(version != SESSION_VERSION){
+    message = "Session snapshot has an unsupported version.";
+    return false;
+  }
+
+  BindingList bindings;
+  if(!decodeBindings(data.data() + header, data.size() - header, bindings)){
+    message = "Session snapshot is corrupt.";
+    return false;
+  }
+
+  // bind into a copy so a bad symbol leaves the interpreter untouched
+  Interpreter restored = interp;
+  try{
+    restored.bind(bindings);
+  }
+  catch(const SemanticError &){
+    message = "Session snapshot is corrupt.";
+    return false;
+  }
+  interp = restored;
+  return true;
+}
@@ -0,0 +1,39 @@
+/*! \file session.hpp
+Defines session snapshots, saving and restoring the definitions of an
+Interpreter.
+
+A snapshot holds every definition beyond the built-in ones (user and startup
+definitions, lambdas, properties and lists of numbers) in the encoding of
+serialize.hpp, preceded by the magic bytes "PLSS" and the snapshot version.
+ */
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "interpreter.hpp"
+
+/// the version of the snapshot header, bumped on any change
+const uint32_t SESSION_VERSION = 1;
+
+/*! Write the definitions of an interpreter to a snapshot file
+  \param interp the interpreter to save
+  \param filename the path of the snapshot to write
+  \param message set to the reason on failure
+  \return true on success
+ */
+bool saveSession(const Interpreter & interp, const std::string & filename,
+		 std::string & message);
+
+/*! Restore the definitions of a snapshot file into an interpreter
+  \param interp the interpreter to restore into, definitions of the same
+         symbols are replaced and others are kept
+  \param filename the path of the snapshot to read
+  \param message set to the reason on failure
+  \return true on success, on failure interp is unchanged
+ */
+bool loadSession(Interpreter & interp, const std::string & filename,
+		 std::string & message);
+
+#endif
@@ -0,0 +1,104 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "directive.hpp"
+#include "session.hpp"
+#include "startup_image.hpp"
+#include "interpreter.hpp"
+#include "test_helpers.hpp"
+
+const std::string SESSION_FILE = "session_test.plss";
+
+TEST_CASE( "Test saving and restoring a session", "[session]" ) {
+
+  Interpreter warm;
+  REQUIRE(loadStartupImage(warm));
+  runProgram(warm, "(begin (define data (list 1 2 3.5)) (define scale (lambda (x) (* x 2))))");
+  runProgram(warm, "(define label (set-property \"note\" \"kept\" (make-point 1 2)))");
+
+  std::string message;
+  REQUIRE(saveSession(warm, SESSION_FILE, message));
+
+  Interpreter fresh;
+  REQUIRE(loadSession(fresh, SESSION_FILE, message));
+
+  REQUIRE(runProgram(fresh, "(map scale data)") == runProgram(warm, "(map scale data)"));
+  REQUIRE(runProgram(fresh, "(get-property \"note\" label)") == Expression(Atom("\"kept\"")));
+  REQUIRE(runProgram(fresh, "(make-point 3 4)").isPoint());
+
+  std::remove(SESSION_FILE.c_str());
+}
+
+TEST_CASE( "Test loading a session keeps other definitions", "[session]" ) {
+
+  Interpreter saved;
+  runProgram(saved, "(define a 1)");
+
+  std::string message;
+  REQUIRE(saveSession(saved, SESSION_FILE, message));
+
+  Interpreter interp;
+  runProgram(interp, "(begin (define a 10) (define b 20))");
+  REQUIRE(loadSession(interp, SESSION_FILE, message));
+
+  REQUIRE(runProgram(interp, "(+ a b)") == Expression(21.));
+
+  std::remove(SESSION_FILE.c_str());
+}
+
+TEST_CASE( "Test loading invalid sessions", "[session]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(define a 1)");
+  std::string message;
+
+  REQUIRE(!loadSession(interp, "does-not-exist.plss", message));
+  REQUIRE(!message.empty());
+
+  {
+    std::ofstream ofs(SESSION_FILE, std::ios::binary);
+    ofs << "(define a 2)";
+  }
+  REQUIRE(!loadSession(interp, SESSION_FILE, message));
+
+  // a truncated snapshot
+  {
+    std::ofstream ofs(SESSION_FILE, std::ios::binary | std::ios::trunc);
+    ofs << "PLSS";
+  }
+  REQUIRE(!loadSession(interp, SESSION_FILE, message));
+
+  // the interpreter is unchanged by a failed load
+  REQUIRE(runProgram(interp, "(+ a)") == Expression(1.));
+
+  std::remove(SESSION_FILE.c_str());
+}
+
+TEST_CASE( "Test session directives", "[session]" ) {
+
+  Interpreter interp;
+  std::string reply;
+
+  REQUIRE(!handleDirective(interp, "(+ 1 2)", reply));
+  REQUIRE(!handleDirective(interp, "%unknown", reply));
+
+  REQUIRE(handleDirective(interp, "%save", reply));
+  REQUIRE(reply.find("Error") == 0);
+
+  runProgram(interp, "(define a 5)");
+  REQUIRE(handleDirective(interp, "%save   " + SESSION_FILE + "  ", reply));
+  REQUIRE(reply.find("Error") == std::string::npos);
+
+  Interpreter other;
+  REQUIRE(handleDirective(other, "%load " + SESSION_FILE, reply));
+  REQUIRE(reply.find("Error") == std::string::npos);
+  REQUIRE(runProgram(other, "(+ a)") == Expression(5.));
+
+  REQUIRE(handleDirective(other, "%load does-not-exist.plss", reply));
+  REQUIRE(reply.find("Error") == 0);
+
+  std::remove(SESSION_FILE.c_str());
+}
@@ -0,0 +1,88 @@
+#include "small_block.hpp"
+
+#include <new>
+
+const std::size_t CLASS_COUNT = SMALL_BLOCK_LIMIT/SMALL_BLOCK_GRANULE;
+
+// a free block holds the link to the next
+struct FreeBlock {
+  FreeBlock * next;
+};
+
+// the free blocks of one thread, by size class
+struct FreeLists {
+  FreeBlock * heads[CLASS_COUNT];
+  std::size_t counts[CLASS_COUNT];
+
+  FreeLists(): heads(), counts() {}
+  ~FreeLists();
+};
+
+thread_local FreeLists freeLists;
+
+// set once freeLists is destroyed at thread exit, blocks released after
+// that (by thread-local or static destructors) go straight to the heap
+thread_local bool freeListsDestroyed = false;
+
+FreeLists::~FreeLists(){
+  freeListsDestroyed = true;
+  for(std::size_t c = 0; c < CLASS_COUNT; ++c){
+    while(heads[c] != nullptr){
+      FreeBlock * block = heads[c];
+      heads[c] = block->next;
+      ::operator delete(block);
+    }
+    counts[c] = 0;
+  }
+}
+
+// the size class of a pooled size, which is at least one byte
+inline std::size_t sizeClass(std::size_t size){
+  return (size - 1)/SMALL_BLOCK_GRANULE;
+}
+
+void * allocateSmallBlock(std::size_t size){
+  if((size == 0) || (size > SMALL_BLOCK_LIMIT) || freeListsDestroyed){
+    return ::operator new(size);
+  }
+
+  std::size_t c = sizeClass(size);
+  FreeBlock * block = freeLists.heads[c];
+  if(block != nullptr){
+    freeLists.heads[c] = block->next;
+    --freeLists.counts[c];
+    return block;
+  }
+  return ::operator new((c + 1)*SMALL_BLOCK_GRANULE);
+}
+
+void deallocateSmallBlock(void * block, std::size_t size) noexcept{
+  if(block == nullptr){
+    return;
+  }
+  if((size == 0) || (size > SMALL_BLOCK_LIMIT) || freeListsDestroyed){
+    ::operator delete(block);
+    return;
+  }
+
+  std::size_t c = sizeClass(size);
+  if(freeLists.counts[c] >= SMALL_BLOCKS_KEPT){
+    ::operator delete(block);
+    return;
+  }
+  FreeBlock * free = static_cast<FreeBlock *>(block);
+  free->next = freeLists.heads[c];
+  freeLists.heads[c] = free;
+  ++freeLists.counts[c];
+}
+
+std::size_t pooledSmallBlocks() noexcept{
+  if(freeListsDestroyed){
+    return 0;
+  }
+  std::size_t total = 0;
+  for(std::size_t c = 0; c < CLASS_COUNT; ++c){
+    total += freeLists.counts[c];
+  }
+  return total;
+}
@@ -0,0 +1,82 @@
+/*! \file small_block.hpp
+Defines a per-thread pool of small memory blocks, and an allocator drawing
+on it for the tails of Expressions.
+
+Most Expressions have a tail of at most a few children, so each would
+otherwise take a separate heap allocation of a few dozen bytes. Blocks of up
+to SMALL_BLOCK_LIMIT bytes are instead kept on free lists by size class
+when released and handed out again, on the thread that released them.
+Larger blocks come straight from the heap. A block may be released on a
+different thread from the one that allocated it.
+ */
+#ifndef SMALL_BLOCK_HPP
+#define SMALL_BLOCK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "memstats.hpp"
+
+/// blocks of up to this many bytes are pooled
+const std::size_t SMALL_BLOCK_LIMIT = 256;
+
+/// the size classes of the pool are multiples of this many bytes
+const std::size_t SMALL_BLOCK_GRANULE = 16;
+
+/// the most free blocks kept per size class and thread
+const std::size_t SMALL_BLOCKS_KEPT = 4096;
+
+/*! Allocate a block, reusing a free one of the same size class if any
+  \param size the number of bytes needed
+  \return the block, aligned as ::operator new
+  \throws std::bad_alloc if the heap is exhausted
+ */
+void * allocateSmallBlock(std::size_t size);
+
+/*! Release a block from allocateSmallBlock
+  \param block the block
+  \param size the size it was allocated with
+ */
+void deallocateSmallBlock(void * block, std::size_t size) noexcept;
+
+/// return the number of free blocks kept by the pool of this thread
+std::size_t pooledSmallBlocks() noexcept;
+
+/*! \class SmallBlockAllocator
+\brief A standard allocator using the small block pool, the bytes it holds
+counted in TailBytes (see memstats.hpp)
+*/
+template<typename T>
+class SmallBlockAllocator {
+public:
+
+  typedef T value_type;
+
+  SmallBlockAllocator() noexcept {}
+
+  template<typename U>
+  SmallBlockAllocator(const SmallBlockAllocator<U> &) noexcept {}
+
+  T * allocate(std::size_t n){
+    T * p = static_cast<T *>(allocateSmallBlock(n*sizeof(T)));
+    countMemory(TailBytes, n*sizeof(T));
+    return p;
+  }
+
+  void deallocate(T * p, std::size_t n) noexcept{
+    countMemory(TailBytes, -static_cast<std::int64_t>(n*sizeof(T)));
+    deallocateSmallBlock(p, n*sizeof(T));
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const SmallBlockAllocator<T> &, const SmallBlockAllocator<U> &) noexcept{
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const SmallBlockAllocator<T> &, const SmallBlockAllocator<U> &) noexcept{
+  return false;
+}
+
+#endif
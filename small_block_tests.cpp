@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "small_block.hpp"
+#include "expression.hpp"
+
+TEST_CASE( "Test small blocks are reused by size class", "[small_block]" ) {
+
+  std::size_t before = pooledSmallBlocks();
+
+  void * a = allocateSmallBlock(40);
+  deallocateSmallBlock(a, 40);
+  REQUIRE(pooledSmallBlocks() == before + 1);
+
+  // any size of the same class gets the freed block
+  void * b = allocateSmallBlock(33);
+  REQUIRE(b == a);
+  REQUIRE(pooledSmallBlocks() == before);
+
+  // but not another class
+  void * c = allocateSmallBlock(64);
+  REQUIRE(c != a);
+
+  deallocateSmallBlock(b, 33);
+  deallocateSmallBlock(c, 64);
+  REQUIRE(pooledSmallBlocks() == before + 2);
+
+  // large blocks are not pooled
+  void * large = allocateSmallBlock(SMALL_BLOCK_LIMIT + 1);
+  deallocateSmallBlock(large, SMALL_BLOCK_LIMIT + 1);
+  REQUIRE(pooledSmallBlocks() == before + 2);
+
+  deallocateSmallBlock(nullptr, 8);
+}
+
+TEST_CASE( "Test small blocks released on another thread", "[small_block]" ) {
+
+  void * block = allocateSmallBlock(24);
+  std::size_t before = pooledSmallBlocks();
+
+  std::size_t pooled = 0;
+  std::thread t([block, &pooled](){
+      deallocateSmallBlock(block, 24);
+      pooled = pooledSmallBlocks();
+    });
+  t.join();
+
+  // kept by the releasing thread, until it exits
+  REQUIRE(pooled == 1);
+  REQUIRE(pooledSmallBlocks() == before);
+}
+
+TEST_CASE( "Test expression tails use the small block pool", "[small_block]" ) {
+
+  {
+    Expression exp(Atom("f"));
+    exp.append(Atom(1.));
+    exp.append(Atom(2.));
+  }
+  std::size_t before = pooledSmallBlocks();
+
+  Expression exp(Atom("f"));
+  exp.append(Atom(1.));
+  exp.append(Atom(2.));
+  REQUIRE(pooledSmallBlocks() < before);
+
+  Expression copy(exp);
+  REQUIRE(copy == exp);
+  REQUIRE(*(copy.tailConstBegin() + 1) == Expression(2.));
+}
@@ -0,0 +1,15 @@
+#include "startup_image.hpp"
+
+#include "serialize.hpp"
+
+bool loadStartupImage(Interpreter & interp){
+
+  BindingList bindings;
+  if(!decodeBindings(reinterpret_cast<const char *>(STARTUP_IMAGE),
+		     STARTUP_IMAGE_SIZE, bindings)){
+    return false;
+  }
+
+  interp.bind(bindings);
+  return true;
+}
@@ -0,0 +1,27 @@
+/*! \file startup_image.hpp
+Defines access to the startup environment compiled into the executables.
+
+At build time the startup_image_gen tool evaluates the startup file once and
+encodes the resulting definitions (see serialize.hpp) into a generated
+source file. Interpreters then start from that image with no file I/O.
+ */
+#ifndef STARTUP_IMAGE_HPP
+#define STARTUP_IMAGE_HPP
+
+#include <cstddef>
+
+#include "interpreter.hpp"
+
+/// the encoded definitions of the startup file (generated)
+extern const unsigned char STARTUP_IMAGE[];
+
+/// the number of bytes in STARTUP_IMAGE (generated)
+extern const std::size_t STARTUP_IMAGE_SIZE;
+
+/*! Bind the definitions of the startup file in an interpreter
+  \param interp the interpreter to initialize
+  \return false if the image could not be decoded
+ */
+bool loadStartupImage(Interpreter & interp);
+
+#endif
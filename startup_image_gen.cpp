@@ -0,0 +1,60 @@
+// Build tool: evaluate the startup file and write its definitions as a C++
+// source file defining STARTUP_IMAGE (see startup_image.hpp).
+//
+// usage: startup_image_gen <startup file> <output file>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "serialize.hpp"
+
+int main(int argc, char *argv[])
+{
+  if(argc != 3){
+    std::cerr << "Usage: " << argv[0] << " <startup file> <output file>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Interpreter interp;
+  std::ifstream ifs(argv[1]);
+  if(!ifs){
+    std::cerr << "Error: Could not open file for reading." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(!interp.parseStream(ifs)){
+    std::cerr << "Error: Invalid Program. Could not parse." << std::endl;
+    return EXIT_FAILURE;
+  }
+  try{
+    interp.evaluate();
+  }
+  catch(const SemanticError & ex){
+    std::cerr << ex.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string image = encodeBindings(interp.definitions());
+
+  std::ofstream out(argv[2]);
+  out << "// generated by startup_image_gen from " << argv[1] << ", do not edit\n"
+      << "#include \"startup_image.hpp\"\n\n"
+      << "const unsigned char STARTUP_IMAGE[] = {";
+  for(std::size_t i = 0; i < image.size(); ++i){
+    out << ((i % 12 == 0) ? "\n  " : " ")
+	<< "0x" << std::hex << std::setw(2) << std::setfill('0')
+	<< static_cast<unsigned>(static_cast<unsigned char>(image[i])) << ",";
+  }
+  out << "\n};\n\n"
+      << "const std::size_t STARTUP_IMAGE_SIZE = sizeof(STARTUP_IMAGE);\n";
+
+  if(!out){
+    std::cerr << "Error: Could not write image." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
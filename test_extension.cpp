@@ -0,0 +1,82 @@
+// A native extension used by extension_tests.cpp, built as a module
+#include <atomic>
+#include <cmath>
+
+#include "plotscript_extension.h"
+
+// the context of scale, ext-vector-calls returns the calls of its
+// vectorized variant
+struct Scale {
+  double factor;
+  std::atomic<unsigned> vectorCalls;
+};
+
+Scale triple = {3.0, {0}};
+
+const char * scale(void * context, const double * args, size_t, double * result){
+  *result = static_cast<Scale *>(context)->factor * args[0];
+  return nullptr;
+}
+
+const char * scaleVector(void * context, const double * in, double * out, size_t n){
+  Scale * s = static_cast<Scale *>(context);
+  ++s->vectorCalls;
+  for(size_t i = 0; i < n; ++i){
+    out[i] = s->factor * in[i];
+  }
+  return nullptr;
+}
+
+const char * vectorCalls(void *, const double *, size_t, double * result){
+  *result = triple.vectorCalls;
+  return nullptr;
+}
+
+const char * norm(void *, const double * args, size_t nargs, double * result){
+  double sum = 0;
+  for(size_t i = 0; i < nargs; ++i){
+    sum += args[i] * args[i];
+  }
+  *result = std::sqrt(sum);
+  return nullptr;
+}
+
+const char * checkedLog(void *, const double * args, size_t, double * result){
+  if(args[0] <= 0){
+    return "argument must be positive.";
+  }
+  *result = std::log(args[0]);
+  return nullptr;
+}
+
+extern "C" int plotscript_extension_init(plotscript_host * host){
+  if(host->abi_version != PLOTSCRIPT_EXTENSION_ABI_VERSION){
+    return 1;
+  }
+
+  const plotscript_procedure procedures[] = {
+    {"ext-scale", scale, scaleVector, &triple, 1, 1},
+    {"ext-vector-calls", vectorCalls, nullptr, nullptr, 1, 1},
+    {"ext-hypot", norm, nullptr, nullptr, 1, PLOTSCRIPT_ANY_ARITY},
+    {"ext-log", checkedLog, nullptr, nullptr, 1, 1},
+  };
+  for(auto & p : procedures){
+    if(host->register_procedure(host, &p) != 0){
+      return 1;
+    }
+  }
+
+  // invalid descriptions are refused
+  const plotscript_procedure invalid[] = {
+    {"begin", norm, nullptr, nullptr, 1, 1},
+    {"ext-scale", norm, nullptr, nullptr, 1, 1},
+    {"ext-none", nullptr, nullptr, nullptr, 1, 1},
+    {"ext-arity", norm, nullptr, nullptr, 2, 1},
+  };
+  for(auto & p : invalid){
+    if(host->register_procedure(host, &p) == 0){
+      return 1;
+    }
+  }
+  return 0;
+}
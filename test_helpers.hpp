@@ -0,0 +1,20 @@
+/*! \file test_helpers.hpp
+Defines helpers shared by the unit tests.
+ */
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+#include "interpreter.hpp"
+
+/// parse program, requiring it to parse, and evaluate it in interp
+inline Expression runProgram(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+#endif
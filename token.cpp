@@ -81,3 +81,56 @@ TokenSequenceType tokenize(std::istream & seq){
 
   return tokens;
 }
+
+bool readForm(std::istream & seq, std::string & form){
+  form.clear();
+  int depth = 0;
+
+  while(true){
+    int next = seq.peek();
+    if(next == std::char_traits<char>::eof()) break;
+    char c = static_cast<char>(next);
+
+    // a bare top-level token ends where a new form begins
+    if((depth == 0) && !form.empty() &&
+       ((c == OPENCHAR) || (c == CLOSECHAR) || isspace(c))){
+      break;
+    }
+    seq.get();
+
+    if(c == COMMENTCHAR){
+      // chomp until the end of the line, keeping the text as tokenize()
+      // treats a comment as part of the surrounding token
+      form.push_back(c);
+      while(seq.get(c)){
+        form.push_back(c);
+        if(c == '\n') break;
+      }
+      // a comment before the form begins is not part of it
+      if((depth == 0) && (form[0] == COMMENTCHAR)) form.clear();
+    }
+    else if(c == QUOTECHAR){
+      form.push_back(c);
+      while(seq.get(c)){
+        form.push_back(c);
+        if(c == QUOTECHAR) break;
+      }
+    }
+    else if(c == OPENCHAR){
+      form.push_back(c);
+      ++depth;
+    }
+    else if(c == CLOSECHAR){
+      form.push_back(c);
+      if(--depth <= 0) break;
+    }
+    else if(isspace(c)){
+      if(!form.empty()) form.push_back(c);
+    }
+    else{
+      form.push_back(c);
+    }
+  }
+
+  return !form.empty();
+}
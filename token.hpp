@@ -59,4 +59,17 @@ Ignores any whitespace and comments (from any ";" to end-of-line).
 */
 TokenSequenceType tokenize(std::istream & seq);
 
+/*! \fn bool readForm(std::istream & seq, std::string & form)
+\brief Read the text of the next top-level form from a stream
+
+\param seq the input character stream
+\param form set to the characters of the form, comments included
+\return false if the stream holds nothing but white-space and comments
+
+Reads only as far as the closing parenthesis of the form, so a stream with
+many forms can be consumed one form at a time. A top-level token outside of
+parentheses is returned as a form of its own.
+*/
+bool readForm(std::istream & seq, std::string & form);
+
 #endif
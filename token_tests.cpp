@@ -73,3 +73,32 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test readForm", "[token]" ) {
+  std::string input = R"(
+; leading comment
+(define a 1) (+ a ; inner comment
+  "a ) string") b(c)
+)";
+
+  std::istringstream iss(input);
+  std::string form;
+
+  REQUIRE(readForm(iss, form));
+  REQUIRE(form == "(define a 1)");
+
+  // nothing past the end of the form has been consumed
+  REQUIRE(iss.peek() == ' ');
+
+  REQUIRE(readForm(iss, form));
+  REQUIRE(form == "(+ a ; inner comment\n  \"a ) string\")");
+
+  REQUIRE(readForm(iss, form));
+  REQUIRE(form == "b");
+
+  REQUIRE(readForm(iss, form));
+  REQUIRE(form == "(c)");
+
+  REQUIRE(!readForm(iss, form));
+  REQUIRE(form.empty());
+}
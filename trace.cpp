@@ -0,0 +1,264 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+
+// the words holding a span name and its terminator
+const std::size_t NAME_WORDS = (TRACE_NAME_LENGTH + 1 + 7)/8;
+
+// a span in a ring, its fields atomic so writeTrace may read a record being
+// refilled and detect it by the sequence number rather than race on it
+struct TraceRecord {
+  // 2i + 1 while span i is written, 2i + 2 once it is, 0 before any
+  std::atomic<std::uint64_t> seq;
+  std::atomic<std::uint64_t> name[NAME_WORDS];
+  std::atomic<const char *> category;
+  std::atomic<std::uint64_t> start;
+  std::atomic<std::uint64_t> end;
+};
+
+// the spans of one thread, only it writes the records and count
+struct TraceRing {
+  std::atomic<std::uint64_t> count; // the spans ever recorded
+  std::atomic<std::uint64_t> first; // the first span not cleared
+  std::size_t tid;
+  std::string threadName; // guarded by ringsMutex
+  TraceRecord records[TRACE_RING_SPANS];
+};
+
+// the rings of every thread, kept after a thread exits so its spans are
+// written at the end, and never destroyed as spans are written at exit
+std::mutex ringsMutex;
+std::vector<TraceRing *> & allRings = *new std::vector<TraceRing *>;
+
+thread_local TraceRing * threadRing = nullptr;
+
+// a span entered and not yet exited on this thread
+struct OpenSpan {
+  std::string name;
+  const char * category;
+  std::uint64_t start;
+};
+
+thread_local std::vector<OpenSpan> openSpans;
+
+TraceRing * registerRing(){
+  TraceRing * ring = new TraceRing;
+  ring->count.store(0, std::memory_order_relaxed);
+  ring->first.store(0, std::memory_order_relaxed);
+  for(auto & record : ring->records){
+    record.seq.store(0, std::memory_order_relaxed);
+  }
+
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  allRings.push_back(ring);
+  ring->tid = allRings.size();
+  ring->threadName = "thread " + std::to_string(ring->tid);
+  threadRing = ring;
+  return ring;
+}
+
+void startTrace() noexcept{
+  traceClock();
+  setInstrument(TRACE_INSTRUMENT, true);
+}
+
+void stopTrace() noexcept{
+  setInstrument(TRACE_INSTRUMENT, false);
+}
+
+void clearTrace() noexcept{
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  for(auto ring : allRings){
+    ring->first.store(ring->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+}
+
+std::uint64_t traceClock() noexcept{
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count();
+}
+
+void recordSpan(const char * name, const char * category,
+		std::uint64_t start, std::uint64_t end) noexcept{
+  TraceRing * ring = threadRing;
+  if(ring == nullptr){
+    try{
+      ring = registerRing();
+    }
+    catch(...){
+      return;
+    }
+  }
+
+  std::uint64_t n = ring->count.load(std::memory_order_relaxed);
+  TraceRecord & record = ring->records[n % TRACE_RING_SPANS];
+
+  char words[NAME_WORDS*8] = {};
+  std::strncpy(words, name, TRACE_NAME_LENGTH);
+
+  // mark the record as being written; the fields are stored with release,
+  // so a reader seeing any new field also sees the mark
+  record.seq.store(2*n + 1, std::memory_order_relaxed);
+  for(std::size_t w = 0; w < NAME_WORDS; ++w){
+    std::uint64_t word;
+    std::memcpy(&word, words + 8*w, sizeof(word));
+    record.name[w].store(word, std::memory_order_release);
+  }
+  record.category.store(category, std::memory_order_release);
+  record.start.store(start, std::memory_order_release);
+  record.end.store(end, std::memory_order_release);
+  // publish the record to writeTrace
+  record.seq.store(2*n + 2, std::memory_order_release);
+  ring->count.store(n + 1, std::memory_order_release);
+}
+
+void setTraceThreadName(const std::string & name){
+  TraceRing * ring = (threadRing != nullptr) ? threadRing : registerRing();
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  ring->threadName = name;
+}
+
+void enterTrace(const std::string & name, const char * category){
+  openSpans.push_back(OpenSpan{name, category, traceClock()});
+}
+
+void exitTrace() noexcept{
+  if(openSpans.empty()) return;
+
+  OpenSpan & span = openSpans.back();
+  recordSpan(span.name.c_str(), span.category, span.start, traceClock());
+  openSpans.pop_back();
+}
+
+// write s as a JSON string
+void writeJsonString(std::ostream & out, const char * s){
+  out << '"';
+  for(; *s != '\0'; ++s){
+    unsigned char c = static_cast<unsigned char>(*s);
+    if((c == '"') || (c == '\\')){
+      out << '\\' << *s;
+    }
+    else if(c < 0x20){
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    }
+    else{
+      out << *s;
+    }
+  }
+  out << '"';
+}
+
+// write ns as microseconds, the unit of trace_event times
+void writeMicroseconds(std::ostream & out, std::uint64_t ns){
+  char us[32];
+  std::snprintf(us, sizeof(us), "%llu.%03llu",
+		static_cast<unsigned long long>(ns / 1000), static_cast<unsigned long long>(ns % 1000));
+  out << us;
+}
+
+// a span copied out of a ring
+struct SpanCopy {
+  char name[NAME_WORDS*8];
+  const char * category;
+  std::uint64_t start;
+  std::uint64_t end;
+};
+
+// copy span i out of its record, returning false if the record was being
+// refilled with a later span: a field of the later span, read with acquire,
+// makes the mark written before it visible to the second read of seq
+bool copySpan(const TraceRecord & record, std::uint64_t i, SpanCopy & span){
+  if(record.seq.load(std::memory_order_acquire) != 2*i + 2) return false;
+  for(std::size_t w = 0; w < NAME_WORDS; ++w){
+    std::uint64_t word = record.name[w].load(std::memory_order_acquire);
+    std::memcpy(span.name + 8*w, &word, sizeof(word));
+  }
+  span.category = record.category.load(std::memory_order_acquire);
+  span.start = record.start.load(std::memory_order_acquire);
+  span.end = record.end.load(std::memory_order_acquire);
+  return record.seq.load(std::memory_order_relaxed) == 2*i + 2;
+}
+
+void writeTrace(std::ostream & out){
+  stopTrace();
+
+  // the rings and their names, not locked while written so a thread
+  // registering or naming itself does not wait on the output
+  std::vector<std::pair<TraceRing *, std::string>> rings;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for(auto ring : allRings){
+      rings.emplace_back(ring, ring->threadName);
+    }
+  }
+  const long pid = static_cast<long>(getpid());
+
+  out << "{\"traceEvents\":[";
+  bool firstEvent = true;
+  for(auto & entry : rings){
+    const TraceRing * ring = entry.first;
+    if(!firstEvent) out << ",";
+    firstEvent = false;
+    out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << ring->tid
+	<< ",\"args\":{\"name\":";
+    writeJsonString(out, entry.second.c_str());
+    out << "}}";
+
+    // a thread still ending spans entered while tracing was on may refill
+    // the oldest records meanwhile; those are skipped
+    std::uint64_t n = ring->count.load(std::memory_order_acquire);
+    std::uint64_t begin = ring->first.load(std::memory_order_relaxed);
+    if(n > TRACE_RING_SPANS){
+      begin = std::max(begin, n - TRACE_RING_SPANS);
+    }
+    SpanCopy span;
+    for(std::uint64_t i = begin; i < n; ++i){
+      if(!copySpan(ring->records[i % TRACE_RING_SPANS], i, span)) continue;
+      span.name[TRACE_NAME_LENGTH] = '\0';
+      out << ",\n{\"name\":";
+      writeJsonString(out, span.name);
+      out << ",\"cat\":";
+      writeJsonString(out, span.category);
+      out << ",\"ph\":\"X\",\"ts\":";
+      writeMicroseconds(out, span.start);
+      out << ",\"dur\":";
+      writeMicroseconds(out, (span.end > span.start) ? (span.end - span.start) : 0);
+      out << ",\"pid\":" << pid << ",\"tid\":" << ring->tid << "}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+std::string tracePath;
+
+void writeTraceFile(){
+  std::ofstream out(tracePath);
+  if(out){
+    writeTrace(out);
+  }
+  if(!out){
+    std::cerr << "Error: could not write trace to " << tracePath << std::endl;
+  }
+}
+
+void traceToFile(const std::string & path){
+  if(tracePath.empty()){
+    std::atexit(writeTraceFile);
+  }
+  tracePath = path;
+  startTrace();
+}
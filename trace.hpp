@@ -0,0 +1,104 @@
+/*! \file trace.hpp
+Defines the recording of evaluation spans in Chrome trace-event form.
+
+While tracing is on, spans are recorded for tokenizing, parsing and
+optimizing a program, each top-level evaluation, each lambda application,
+each plot and the hand-offs between a REPL or notebook and its interpreter
+kernel. Each thread records into a fixed-size ring of its own, which only it
+writes and which takes no lock; when a ring is full its oldest spans are
+overwritten. Each record carries a sequence number written before and after
+its fields, so a reader detects a record being refilled. writeTrace writes
+the rings of all threads as a JSON object in the trace_event format that
+chrome://tracing and Perfetto read.
+
+While tracing is off, a span tests a single flag.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "instrument.hpp"
+
+/// the spans each thread's ring holds
+const std::size_t TRACE_RING_SPANS = 1 << 15;
+
+/// the longest name a span keeps, longer names are cut
+const std::size_t TRACE_NAME_LENGTH = 39;
+
+/// return true if tracing is on
+inline bool tracing() noexcept{
+  return instrumentOn(TRACE_INSTRUMENT);
+}
+
+/// turn tracing on, keeping spans already recorded
+void startTrace() noexcept;
+
+/// turn tracing off
+void stopTrace() noexcept;
+
+/// drop the spans recorded by all threads
+void clearTrace() noexcept;
+
+/// return the time in ns since the first trace clock reading
+std::uint64_t traceClock() noexcept;
+
+/*! Record a span on the current thread
+  \param name the name of the span
+  \param category the category of the span, a string that outlives the trace
+  \param start the traceClock() at its start
+  \param end the traceClock() at its end
+ */
+void recordSpan(const char * name, const char * category,
+		std::uint64_t start, std::uint64_t end) noexcept;
+
+/// name the current thread in the trace, e.g. "kernel"
+void setTraceThreadName(const std::string & name);
+
+/*! Start a span on the current thread that a later exitTrace ends, for
+  spans that do not follow a C++ scope
+  \param name the name of the span
+  \param category the category of the span, a string that outlives the trace
+ */
+void enterTrace(const std::string & name, const char * category);
+
+/// end the span most recently entered on the current thread
+void exitTrace() noexcept;
+
+/*! Write the spans of all threads as trace_event JSON, oldest first
+  Tracing is turned off first, so threads still running stop starting
+  spans. A thread ending a span started before does not wait; a record it
+  refills while its ring is written is left out.
+ */
+void writeTrace(std::ostream & out);
+
+/*! Turn tracing on and write the trace to a file when the program exits
+  \param path the file to write
+ */
+void traceToFile(const std::string & path);
+
+/*! \class TraceSpan
+\brief Records a span for its lifetime, if tracing was on at its start
+*/
+class TraceSpan {
+public:
+  TraceSpan(const char * name, const char * category):
+    m_name(name), m_category(category), m_on(tracing()),
+    m_start(m_on ? traceClock() : 0) {}
+  ~TraceSpan(){
+    if(m_on) recordSpan(m_name, m_category, m_start, traceClock());
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan & operator=(const TraceSpan &) = delete;
+
+private:
+  const char * m_name;
+  const char * m_category;
+  bool m_on;
+  std::uint64_t m_start;
+};
+
+#endif
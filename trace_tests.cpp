@@ -0,0 +1,152 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "trace.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+std::string traceText(){
+  std::ostringstream out;
+  writeTrace(out);
+  return out.str();
+}
+
+std::size_t countOf(const std::string & text, const std::string & part){
+  std::size_t n = 0;
+  for(auto at = text.find(part); at != std::string::npos; at = text.find(part, at + 1)){
+    ++n;
+  }
+  return n;
+}
+
+TEST_CASE( "Test trace records spans while on", "[trace]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(define sq (lambda (x) (* x x)))");
+
+  clearTrace();
+  runProgram(interp, "(sq 2)");
+  std::string off = traceText();
+  REQUIRE(countOf(off, "\"ph\":\"X\"") == 0);
+
+  clearTrace();
+  startTrace();
+  runProgram(interp, "(+ (sq 2) (sq 3))");
+  runProgram(interp, "(map sq (list 1 2 3))");
+  REQUIRE(tracing());
+  std::string text = traceText();
+  REQUIRE(!tracing());
+
+  REQUIRE(text.find("{\"traceEvents\":[") == 0);
+  REQUIRE(text.find("],\"displayTimeUnit\":\"ns\"}") != std::string::npos);
+  REQUIRE(countOf(text, "\"name\":\"tokenize\",\"cat\":\"front end\"") == 2);
+  REQUIRE(countOf(text, "\"name\":\"parse\",\"cat\":\"front end\"") == 2);
+  REQUIRE(countOf(text, "\"name\":\"optimize\",\"cat\":\"front end\"") == 2);
+  REQUIRE(countOf(text, "\"name\":\"eval\",\"cat\":\"eval\"") == 2);
+  REQUIRE(countOf(text, "\"name\":\"sq\",\"cat\":\"lambda\"") == 5);
+  REQUIRE(countOf(text, "\"name\":\"thread_name\",\"ph\":\"M\"") >= 1);
+
+  // cleared spans are not written again
+  clearTrace();
+  REQUIRE(countOf(traceText(), "\"ph\":\"X\"") == 0);
+}
+
+TEST_CASE( "Test trace ends lambda spans left by an error", "[trace]" ) {
+
+  Interpreter interp;
+  runProgram(interp, "(define bad (lambda (x) (+ x (list 1))))");
+  runProgram(interp, "(define outer (lambda (x) (bad x)))");
+
+  clearTrace();
+  startTrace();
+  REQUIRE_THROWS_AS(runProgram(interp, "(outer 1)"), SemanticError);
+  std::string text = traceText();
+
+  REQUIRE(countOf(text, "\"name\":\"outer\",\"cat\":\"lambda\"") == 1);
+  REQUIRE(countOf(text, "\"name\":\"bad\",\"cat\":\"lambda\"") == 1);
+}
+
+TEST_CASE( "Test trace records plots", "[trace]" ) {
+
+  Interpreter interp;
+  clearTrace();
+  startTrace();
+  runProgram(interp, "(discrete-plot (list (list 0 0) (list 1 1)) (list))");
+  std::string text = traceText();
+
+  REQUIRE(countOf(text, "\"name\":\"discrete-plot\",\"cat\":\"plot\"") == 1);
+}
+
+TEST_CASE( "Test trace keeps a track per thread", "[trace]" ) {
+
+  clearTrace();
+  startTrace();
+  std::thread worker([](){
+      setTraceThreadName("trace \"worker\"");
+      TraceSpan span("work", "test");
+    });
+  worker.join();
+  {
+    TraceSpan span("main-work", "test");
+  }
+  std::string text = traceText();
+
+  REQUIRE(countOf(text, "\"args\":{\"name\":\"trace \\\"worker\\\"\"}") == 1);
+  REQUIRE(countOf(text, "\"name\":\"work\",\"cat\":\"test\"") == 1);
+  REQUIRE(countOf(text, "\"name\":\"main-work\",\"cat\":\"test\"") == 1);
+
+  // the spans of each thread are on its own track
+  std::size_t work = text.find("\"name\":\"work\"");
+  std::size_t mainWork = text.find("\"name\":\"main-work\"");
+  std::size_t workTid = text.find("\"tid\":", work);
+  std::size_t mainTid = text.find("\"tid\":", mainWork);
+  REQUIRE(text.substr(workTid, text.find('}', workTid) - workTid) !=
+	  text.substr(mainTid, text.find('}', mainTid) - mainTid));
+  REQUIRE(workTid != mainTid);
+}
+
+TEST_CASE( "Test trace is written while threads end spans", "[trace]" ) {
+
+  clearTrace();
+  startTrace();
+  std::atomic<bool> done(false);
+  std::thread worker([&done](){
+      for(std::size_t i = 0; !done || (i < 2*TRACE_RING_SPANS); ++i){
+	recordSpan((i % 2 == 0) ? "even" : "odd", "test", i, i + 1);
+      }
+    });
+  for(int i = 0; i < 20; ++i){
+    std::string text = traceText();
+    REQUIRE(countOf(text, "\"ph\":\"X\"") ==
+	    countOf(text, "\"name\":\"even\"") + countOf(text, "\"name\":\"odd\""));
+  }
+  done = true;
+  worker.join();
+}
+
+TEST_CASE( "Test trace ring keeps the latest spans", "[trace]" ) {
+
+  clearTrace();
+  startTrace();
+  std::thread worker([](){
+      for(int i = 0; i < 5; ++i){
+	TraceSpan span("oldest", "test");
+      }
+      for(std::size_t i = 0; i < TRACE_RING_SPANS; ++i){
+	TraceSpan span("latest", "test");
+      }
+      recordSpan("a name longer than the longest name a span keeps", "test", 2000, 1000);
+    });
+  worker.join();
+  std::string text = traceText();
+
+  REQUIRE(countOf(text, "\"name\":\"oldest\"") == 0);
+  REQUIRE(countOf(text, "\"name\":\"latest\"") == TRACE_RING_SPANS - 1);
+  std::string cut = std::string("a name longer than the longest name a span keeps").substr(0, TRACE_NAME_LENGTH);
+  REQUIRE(countOf(text, "\"name\":\"" + cut + "\",\"cat\":\"test\",\"ph\":\"X\",\"ts\":2.000,\"dur\":0.000") == 1);
+}